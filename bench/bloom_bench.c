@@ -0,0 +1,58 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_KEYS 300000
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char bufs[NUM_KEYS][24];
+  static char misses[NUM_KEYS][24];
+
+  hash_set *hs = hs_init(0);
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "word-%u", i);
+    snprintf(misses[i], sizeof(misses[i]), "miss-%u", i);
+    hs_insert(hs, bufs[i]);
+  }
+
+  double start = now_sec();
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    found += hs_contains(hs, misses[i]);
+  }
+  printf("%-14s %-10s %-10s %-12s\n", "method", "target", "fpr",
+         "miss ns");
+  printf("%-14s %-10s %-10.5f %-12.1f\n", "hs_contains", "-",
+         (double)found / NUM_KEYS, (now_sec() - start) * 1e9 / NUM_KEYS);
+
+  const double targets[] = {0.05, 0.01, 0.001};
+  for (unsigned int t = 0; t < sizeof(targets) / sizeof(targets[0]); t++) {
+    bloom_filter *bf = bf_from_set(hs, targets[t]);
+
+    start = now_sec();
+    found = 0;
+    for (unsigned int i = 0; i < NUM_KEYS; i++) {
+      found += bf_contains(bf, misses[i]);
+    }
+    printf("%-14s %-10.3f %-10.5f %-12.1f (%.1f bits/key)\n", "bf_contains",
+           targets[t], (double)found / NUM_KEYS,
+           (now_sec() - start) * 1e9 / NUM_KEYS,
+           bf_size(bf) * 8.0 / NUM_KEYS);
+
+    bf_delete_filter(bf);
+  }
+
+  hs_delete_set(hs);
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_KEYS 300000
+#define MAX_THREADS 8
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char bufs[NUM_KEYS][24];
+  static const char *keys[NUM_KEYS];
+
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "word-%u", i);
+    keys[i] = bufs[i];
+  }
+
+  printf("%-16s %-10s %-12s\n", "method", "threads", "ms");
+
+  double start = now_sec();
+  hash_set *hs = hs_init(0);
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    hs_insert(hs, keys[i]);
+  }
+  printf("%-16s %-10u %-12.3f\n", "hs_insert", 1, (now_sec() - start) * 1e3);
+  hs_delete_set(hs);
+
+  for (unsigned int num_threads = 1; num_threads <= MAX_THREADS;
+       num_threads *= 2) {
+    start = now_sec();
+    hs = hs_build(keys, NUM_KEYS, num_threads);
+    printf("%-16s %-10u %-12.3f\n", "hs_build", num_threads,
+           (now_sec() - start) * 1e3);
+    hs_delete_set(hs);
+  }
+
+  for (unsigned int num_threads = 1; num_threads <= MAX_THREADS;
+       num_threads *= 2) {
+    start = now_sec();
+    hash_table *ht = ht_build(keys, NULL, NUM_KEYS, NULL, num_threads);
+    printf("%-16s %-10u %-12.3f\n", "ht_build", num_threads,
+           (now_sec() - start) * 1e3);
+    ht_delete_table(ht);
+  }
+
+  return 0;
+}
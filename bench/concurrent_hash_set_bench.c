@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_KEYS 400000
+#define DISTINCT_KEYS 100000
+#define MAX_THREADS 8
+
+typedef struct {
+  concurrent_hash_set *chs;
+  char (*keys)[24];
+  unsigned int start;
+  unsigned int end;
+} producer_ctx;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *producer(void *arg) {
+  producer_ctx *ctx = arg;
+
+  for (unsigned int i = ctx->start; i < ctx->end; i++) {
+    chs_insert(ctx->chs, ctx->keys[i]);
+  }
+
+  return NULL;
+}
+
+int main(void) {
+  static char keys[NUM_KEYS][24];
+
+  // Every distinct key appears several times, as in an event stream with
+  // redelivered messages
+  srand(42);
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "event-%d", rand() % DISTINCT_KEYS);
+  }
+
+  printf("%-10s %-14s %-10s\n", "threads", "Mops/s", "distinct");
+
+  for (unsigned int num_threads = 1; num_threads <= MAX_THREADS;
+       num_threads *= 2) {
+    concurrent_hash_set *chs = chs_init(0);
+    pthread_t threads[MAX_THREADS];
+    producer_ctx ctxs[MAX_THREADS];
+
+    const double start = now_sec();
+    for (unsigned int t = 0; t < num_threads; t++) {
+      ctxs[t] = (producer_ctx){.chs = chs,
+                               .keys = keys,
+                               .start = NUM_KEYS / num_threads * t,
+                               .end = NUM_KEYS / num_threads * (t + 1)};
+      pthread_create(&threads[t], NULL, producer, &ctxs[t]);
+    }
+
+    for (unsigned int t = 0; t < num_threads; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    const double elapsed = now_sec() - start;
+
+    printf("%-10u %-14.3f %-10zu\n", num_threads, NUM_KEYS / elapsed / 1e6,
+           chs_count(chs));
+
+    chs_delete_set(chs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,74 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_WORDS 1000000
+#define NUM_DISTINCT 50000
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char words[NUM_DISTINCT][24];
+  for (unsigned int i = 0; i < NUM_DISTINCT; i++) {
+    snprintf(words[i], sizeof(words[i]), "word-%u", i);
+  }
+
+  // A skewed stream, in which low-numbered words are the most frequent
+  unsigned int *stream = malloc(sizeof(unsigned int) * NUM_WORDS);
+  for (unsigned int i = 0; i < NUM_WORDS; i++) {
+    stream[i] = (unsigned int)((i * 2654435761ULL) % NUM_DISTINCT) %
+                ((i % 64 + 1) * (NUM_DISTINCT / 64));
+  }
+
+  printf("%-24s %-12s\n", "method", "ns/word");
+
+  double start = now_sec();
+  hash_table *ht = ht_init(0, free);
+  for (unsigned int i = 0; i < NUM_WORDS; i++) {
+    unsigned int *count = ht_get(ht, words[stream[i]]);
+    if (count == NULL) {
+      count = malloc(sizeof(unsigned int));
+      *count = 0;
+      ht_insert(ht, words[stream[i]], count);
+    }
+    (*count)++;
+  }
+  printf("%-24s %-12.1f\n", "ht + boxed counts",
+         (now_sec() - start) * 1e9 / NUM_WORDS);
+  ht_delete_table(ht);
+
+  start = now_sec();
+  hash_counter *hcnt = hcnt_init(0);
+  for (unsigned int i = 0; i < NUM_WORDS; i++) {
+    hcnt_add(hcnt, words[stream[i]], 1);
+  }
+  printf("%-24s %-12.1f\n", "hcnt_add", (now_sec() - start) * 1e9 / NUM_WORDS);
+
+  hcnt_item top[10];
+  start = now_sec();
+  hcnt_top_k(hcnt, 10, top);
+  printf("%-24s %-12.1f (total us)\n", "hcnt_top_k(10)",
+         (now_sec() - start) * 1e6);
+  hcnt_delete_counter(hcnt);
+
+  start = now_sec();
+  count_min_sketch *cms = cms_init(0.0001, 0.01, 10);
+  for (unsigned int i = 0; i < NUM_WORDS; i++) {
+    cms_add(cms, words[stream[i]], 1);
+  }
+  printf("%-24s %-12.1f\n", "cms_add (k = 10)",
+         (now_sec() - start) * 1e9 / NUM_WORDS);
+  cms_delete_sketch(cms);
+
+  free(stream);
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "perfect_hash.h"
+
+#define NUM_KEYS 300000
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char bufs[NUM_KEYS][24];
+  static uint64_t hashes[NUM_KEYS];
+
+  hash_table *ht = ht_init(0, NULL);
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "word-%u", i);
+    hashes[i] = h_hash_64(bufs[i]);
+    ht_insert(ht, bufs[i], bufs[i]);
+  }
+
+  printf("%-16s %-12s %-12s %-12s\n", "table", "build ms", "bits/key",
+         "lookup ns");
+
+  // Slot array plus one bucket list node per entry
+  const double ht_bits = (ht->capacity * sizeof(ht_entry *) +
+                          ht->count * sizeof(node_t)) *
+                         8.0 / NUM_KEYS;
+
+  double start = now_sec();
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    found += ht_search(ht, bufs[i]) != NULL;
+  }
+  printf("%-16s %-12s %-12.1f %-12.1f\n", "hash_table", "-", ht_bits,
+         (now_sec() - start) * 1e9 / NUM_KEYS);
+
+  // The perfect hash function on its own, i.e. its pilots
+  perfect_hash ph;
+  start = now_sec();
+  ph_build(&ph, hashes, NUM_KEYS);
+  const double ph_ms = (now_sec() - start) * 1e3;
+  const double ph_bits = ph.num_buckets * sizeof(uint32_t) * 8.0 / NUM_KEYS;
+  ph_free(&ph);
+
+  start = now_sec();
+  frozen_hash_table *fht = ht_freeze(ht);
+  const double freeze_ms = (now_sec() - start) * 1e3;
+
+  start = now_sec();
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    found += fht_search(fht, bufs[i]) != NULL;
+  }
+  printf("%-16s %-12.3f %-12.1f %-12.1f\n", "frozen_table", freeze_ms,
+         ph_bits + sizeof(ht_entry *) * 8.0,
+         (now_sec() - start) * 1e9 / NUM_KEYS);
+  printf("%-16s %-12.3f %-12.1f %-12s\n", "perfect_hash", ph_ms, ph_bits,
+         "-");
+
+  fht_delete_table(fht);
+
+  return found == 2 * NUM_KEYS ? 0 : 1;
+}
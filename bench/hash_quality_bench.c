@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "prime.h"
+
+/**
+ * Capacity at which the probe hashes are tested for avalanche; the largest
+ * prime which fits, so as many output bits as possible are in play
+ */
+#define WIDE_CAPACITY 2147483647
+
+/**
+ * Max number of keys whose bits are flipped by the avalanche tests
+ */
+#define MAX_AVALANCHE_KEYS 2000
+
+/**
+ * Number of leading key bytes whose bits are flipped
+ */
+#define AVALANCHE_BYTES 16
+
+#define OUT_BITS 64
+
+/**
+ * Table load at which the bucket distribution is measured
+ */
+#define BUCKET_LOAD 0.5
+
+typedef uint64_t hash_fn(const char *key, unsigned int capacity);
+
+typedef struct {
+  const char *name;
+  hash_fn *fn;
+
+  /**
+   * Output bits which carry hash information
+   */
+  uint64_t mask;
+
+  /**
+   * Number of bits of distinct hash values, or 0 for a probe pair, which
+   * takes one of capacity^2 values
+   */
+  unsigned int space_bits;
+} hash_under_test;
+
+typedef struct {
+  const char *name;
+  char **keys;
+  unsigned int n;
+} corpus;
+
+typedef struct {
+  double avalanche_worst;
+  double avalanche_mean;
+  double bic_worst;
+  uint64_t collisions;
+  double expected_collisions;
+  double chi2_z;
+  unsigned int max_load;
+  double mkeys_per_sec;
+  double mb_per_sec;
+} quality;
+
+/**
+ * Both probe hashes, with `hash_a` - the home slot - in the low half
+ */
+static uint64_t probe_hash(const char *key, unsigned int capacity) {
+  const h_probe probe = h_probe_init(key, capacity);
+  return (uint64_t)probe.hash_b << 32 | probe.hash_a;
+}
+
+static uint64_t hash_64(const char *key, unsigned int capacity) {
+  (void)capacity;
+  return h_hash_64(key);
+}
+
+/**
+ * The CRC32C as tables in HT_HASH_CRC32C mode consume it, mixed over 64 bits
+ */
+static uint64_t crc32c(const char *key, unsigned int capacity) {
+  (void)capacity;
+  return h_mix_64(h_crc32c(key));
+}
+
+static const hash_under_test HASHES[] = {
+    {"h_probe_init", probe_hash, 0x7fffffff7fffffffULL, 0},
+    {"h_hash_64", hash_64, UINT64_MAX, 64},
+    {"h_crc32c", crc32c, UINT64_MAX, 32},
+};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static corpus numeric_corpus(unsigned int n) {
+  corpus c = {"numeric", malloc(sizeof(char *) * n), n};
+
+  for (unsigned int i = 0; i < n; i++) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u", i);
+    c.keys[i] = strdup(buf);
+  }
+
+  return c;
+}
+
+static corpus uuid_corpus(unsigned int n) {
+  corpus c = {"uuid", malloc(sizeof(char *) * n), n};
+
+  for (unsigned int i = 0; i < n; i++) {
+    const uint64_t hi = rng_next();
+    const uint64_t lo = rng_next();
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%08x-%04x-4%03x-%04x-%012llx",
+             (unsigned int)(hi >> 32), (unsigned int)(hi >> 16) & 0xffff,
+             (unsigned int)hi & 0xfff,
+             0x8000 | ((unsigned int)(lo >> 48) & 0x3fff),
+             (unsigned long long)(lo & 0xffffffffffffULL));
+    c.keys[i] = strdup(buf);
+  }
+
+  return c;
+}
+
+static corpus url_corpus(unsigned int n) {
+  static const char *hosts[] = {"example.com", "api.example.org",
+                                "cdn.example.net", "static.example.io"};
+  static const char *segments[] = {"users",  "items",   "search", "v1",
+                                   "v2",     "orders",  "images", "assets",
+                                   "profile", "settings"};
+  corpus c = {"url", malloc(sizeof(char *) * n), n};
+
+  for (unsigned int i = 0; i < n; i++) {
+    const uint64_t r = rng_next();
+    char buf[128];
+    snprintf(buf, sizeof(buf), "https://%s/%s/%s?id=%u", hosts[r % 4],
+             segments[(r >> 8) % 10], segments[(r >> 16) % 10], i);
+    c.keys[i] = strdup(buf);
+  }
+
+  return c;
+}
+
+/**
+ * Read a corpus of one key per line; blank lines are skipped
+ */
+static int file_corpus(const char *path, corpus *c) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return 0;
+  }
+
+  unsigned int capacity = 1024;
+  c->name = path;
+  c->keys = malloc(sizeof(char *) * capacity);
+  c->n = 0;
+
+  char *line = NULL;
+  size_t line_size = 0;
+  ssize_t len;
+  while ((len = getline(&line, &line_size, f)) != -1) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len == 0) {
+      continue;
+    }
+
+    if (c->n == capacity) {
+      capacity *= 2;
+      c->keys = realloc(c->keys, sizeof(char *) * capacity);
+    }
+    c->keys[c->n++] = strdup(line);
+  }
+
+  free(line);
+  fclose(f);
+
+  return c->n > 0;
+}
+
+static void free_corpus(corpus *c) {
+  for (unsigned int i = 0; i < c->n; i++) {
+    free(c->keys[i]);
+  }
+  free(c->keys);
+}
+
+/**
+ * Flip each of the leading bits of each key, and measure how often each
+ * output bit changes (avalanche: ideally half the time) and how the changes
+ * of each pair of output bits correlate (bit independence: ideally not at
+ * all). Flips which would produce a NUL byte are skipped.
+ */
+static void test_avalanche(const hash_under_test *h, const corpus *c,
+                           quality *q) {
+  static uint64_t flips[AVALANCHE_BYTES * 8][OUT_BITS];
+  static uint64_t trials[AVALANCHE_BYTES * 8];
+  static uint64_t changed[OUT_BITS];
+  static uint64_t both_changed[OUT_BITS][OUT_BITS];
+  memset(flips, 0, sizeof(flips));
+  memset(trials, 0, sizeof(trials));
+  memset(changed, 0, sizeof(changed));
+  memset(both_changed, 0, sizeof(both_changed));
+  uint64_t total = 0;
+
+  const unsigned int n = c->n < MAX_AVALANCHE_KEYS ? c->n : MAX_AVALANCHE_KEYS;
+  for (unsigned int k = 0; k < n; k++) {
+    char *key = strdup(c->keys[k]);
+    const size_t len = strlen(key);
+    const uint64_t original = h->fn(key, WIDE_CAPACITY) & h->mask;
+
+    for (size_t byte = 0; byte < len && byte < AVALANCHE_BYTES; byte++) {
+      for (unsigned int bit = 0; bit < 8; bit++) {
+        key[byte] ^= (char)(1 << bit);
+        if (key[byte] != '\0') {
+          const uint64_t delta =
+              (h->fn(key, WIDE_CAPACITY) & h->mask) ^ original;
+          const unsigned int in = (unsigned int)byte * 8 + bit;
+
+          trials[in]++;
+          total++;
+          for (unsigned int j = 0; j < OUT_BITS; j++) {
+            if (delta >> j & 1) {
+              flips[in][j]++;
+              changed[j]++;
+              for (unsigned int l = j + 1; l < OUT_BITS; l++) {
+                both_changed[j][l] += delta >> l & 1;
+              }
+            }
+          }
+        }
+        key[byte] ^= (char)(1 << bit);
+      }
+    }
+
+    free(key);
+  }
+
+  double worst = 0;
+  double sum = 0;
+  unsigned int cells = 0;
+  for (unsigned int in = 0; in < AVALANCHE_BYTES * 8; in++) {
+    if (trials[in] == 0) {
+      continue;
+    }
+
+    for (unsigned int j = 0; j < OUT_BITS; j++) {
+      if (!(h->mask >> j & 1)) {
+        continue;
+      }
+
+      const double bias = fabs(2.0 * flips[in][j] / trials[in] - 1);
+      worst = bias > worst ? bias : worst;
+      sum += bias;
+      cells++;
+    }
+  }
+  q->avalanche_worst = worst;
+  q->avalanche_mean = cells ? sum / cells : 0;
+
+  // Phi coefficient of each pair of output bits changing together
+  double bic_worst = 0;
+  for (unsigned int j = 0; j < OUT_BITS; j++) {
+    for (unsigned int l = j + 1; l < OUT_BITS; l++) {
+      if (!(h->mask >> j & 1) || !(h->mask >> l & 1)) {
+        continue;
+      }
+
+      const double n11 = both_changed[j][l];
+      const double n10 = changed[j] - n11;
+      const double n01 = changed[l] - n11;
+      const double n00 = (double)total - changed[j] - changed[l] + n11;
+      const double denom = sqrt((n11 + n10) * (n01 + n00) * (n11 + n01) *
+                                (n10 + n00));
+      if (denom > 0) {
+        const double phi = fabs(n11 * n00 - n10 * n01) / denom;
+        bic_worst = phi > bic_worst ? phi : bic_worst;
+      }
+    }
+  }
+  q->bic_worst = bic_worst;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Count pairs of distinct keys with identical hashes, and measure how evenly
+ * the keys spread over the slots of a table of typical load
+ */
+static void test_distribution(const hash_under_test *h, const corpus *c,
+                              quality *q) {
+  const unsigned int capacity = next_prime(c->n / BUCKET_LOAD);
+  uint64_t *hashes = malloc(sizeof(uint64_t) * c->n);
+  unsigned int *loads = calloc(capacity, sizeof(unsigned int));
+
+  for (unsigned int i = 0; i < c->n; i++) {
+    hashes[i] = h->fn(c->keys[i], capacity);
+    loads[(hashes[i] & 0xffffffff) % capacity]++;
+  }
+
+  // Keys are assumed distinct, so equal hashes are true collisions
+  qsort(hashes, c->n, sizeof(uint64_t), compare_u64);
+  uint64_t collisions = 0;
+  uint64_t run = 1;
+  for (unsigned int i = 1; i <= c->n; i++) {
+    if (i < c->n && hashes[i] == hashes[i - 1]) {
+      run++;
+    } else {
+      collisions += run * (run - 1) / 2;
+      run = 1;
+    }
+  }
+  q->collisions = collisions;
+
+  const double space = h->space_bits ? pow(2, h->space_bits)
+                                     : (double)capacity * capacity;
+  q->expected_collisions = (double)c->n * (c->n - 1) / 2 / space;
+
+  const double expected = (double)c->n / capacity;
+  double chi2 = 0;
+  unsigned int max_load = 0;
+  for (unsigned int i = 0; i < capacity; i++) {
+    chi2 += (loads[i] - expected) * (loads[i] - expected) / expected;
+    max_load = loads[i] > max_load ? loads[i] : max_load;
+  }
+  q->chi2_z = (chi2 - (capacity - 1)) / sqrt(2.0 * (capacity - 1));
+  q->max_load = max_load;
+
+  free(loads);
+  free(hashes);
+}
+
+static void test_throughput(const hash_under_test *h, const corpus *c,
+                            quality *q) {
+  size_t bytes = 0;
+  for (unsigned int i = 0; i < c->n; i++) {
+    bytes += strlen(c->keys[i]);
+  }
+
+  const unsigned int capacity = next_prime(c->n / BUCKET_LOAD);
+  volatile uint64_t sink = 0;
+  unsigned int rounds = 0;
+  const double start = now_sec();
+  double elapsed;
+  do {
+    for (unsigned int i = 0; i < c->n; i++) {
+      sink += h->fn(c->keys[i], capacity);
+    }
+    rounds++;
+    elapsed = now_sec() - start;
+  } while (elapsed < 0.2);
+  (void)sink;
+
+  q->mkeys_per_sec = (double)c->n * rounds / elapsed / 1e6;
+  q->mb_per_sec = (double)bytes * rounds / elapsed / 1e6;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: hash_quality_bench [--format=text|csv] [--keys=N]\n"
+          "                          [--corpus=FILE]...\n");
+}
+
+int main(int argc, char **argv) {
+  int csv = 0;
+  unsigned int n = 100000;
+  corpus corpora[16];
+  unsigned int num_corpora = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--format=csv") == 0) {
+      csv = 1;
+    } else if (strcmp(argv[i], "--format=text") == 0) {
+      csv = 0;
+    } else if (strncmp(argv[i], "--keys=", 7) == 0) {
+      n = (unsigned int)strtoul(argv[i] + 7, NULL, 10);
+    } else if (strncmp(argv[i], "--corpus=", 9) == 0 && num_corpora < 13) {
+      if (!file_corpus(argv[i] + 9, &corpora[num_corpora])) {
+        return 1;
+      }
+      num_corpora++;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (n < 2) {
+    n = 2;
+  }
+  corpora[num_corpora++] = numeric_corpus(n);
+  corpora[num_corpora++] = uuid_corpus(n);
+  corpora[num_corpora++] = url_corpus(n);
+
+  if (csv) {
+    printf("corpus,hash,keys,avalanche_worst,avalanche_mean,bic_worst,"
+           "collisions,expected_collisions,chi2_z,max_load,mkeys_per_sec,"
+           "mb_per_sec\n");
+  } else {
+    printf("%-12s %-13s %-8s %-9s %-9s %-9s %-11s %-9s %-8s %-8s %-8s\n",
+           "corpus", "hash", "keys", "aval_max", "aval_avg", "bic_max",
+           "collisions", "expected", "chi2_z", "max_load", "Mkeys/s");
+  }
+
+  for (unsigned int c = 0; c < num_corpora; c++) {
+    for (unsigned int h = 0; h < sizeof(HASHES) / sizeof(HASHES[0]); h++) {
+      quality q;
+      test_avalanche(&HASHES[h], &corpora[c], &q);
+      test_distribution(&HASHES[h], &corpora[c], &q);
+      test_throughput(&HASHES[h], &corpora[c], &q);
+
+      if (csv) {
+        printf("%s,%s,%u,%.4f,%.4f,%.4f,%llu,%.4f,%.2f,%u,%.2f,%.1f\n",
+               corpora[c].name, HASHES[h].name, corpora[c].n,
+               q.avalanche_worst, q.avalanche_mean, q.bic_worst,
+               (unsigned long long)q.collisions, q.expected_collisions,
+               q.chi2_z, q.max_load, q.mkeys_per_sec, q.mb_per_sec);
+      } else {
+        printf("%-12s %-13s %-8u %-9.4f %-9.4f %-9.4f %-11llu %-9.3g "
+               "%-8.2f %-8u %-8.2f\n",
+               corpora[c].name, HASHES[h].name, corpora[c].n,
+               q.avalanche_worst, q.avalanche_mean, q.bic_worst,
+               (unsigned long long)q.collisions, q.expected_collisions,
+               q.chi2_z, q.max_load, q.mkeys_per_sec);
+      }
+    }
+  }
+
+  for (unsigned int c = 0; c < num_corpora; c++) {
+    free_corpus(&corpora[c]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Size of each pre-formatted lookup key, so that reading the keys themselves
+ * walks memory sequentially and adds no TLB misses of its own
+ */
+#define KEY_SIZE 16
+
+typedef struct {
+  const char *name;
+  unsigned int flags;
+} policy;
+
+static const policy POLICIES[] = {
+    {"default", HT_MEM_DEFAULT},
+    {"hugepages", HT_MEM_HUGEPAGES},
+    {"hugetlb", HT_MEM_HUGETLB},
+    {"hugepages+interleave", HT_MEM_HUGEPAGES | HT_MEM_INTERLEAVE},
+};
+
+typedef struct {
+  double ns_per_op;
+
+  /**
+   * dTLB read misses per lookup, or negative if they cannot be counted
+   */
+  double dtlb_misses_per_op;
+} result;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Open a counter of this thread's user-space dTLB read misses
+ *
+ * @return int The counter's file descriptor, or -1 if the kernel or CPU does
+ * not offer one, e.g. under a restrictive perf_event_paranoid
+ */
+static int dtlb_open(void) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+  return -1;
+#endif
+}
+
+static void dtlb_start(int fd) {
+#ifdef __linux__
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+static long long dtlb_stop(int fd) {
+#ifdef __linux__
+  long long count;
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+      return count;
+    }
+  }
+#endif
+  return -1;
+}
+
+/**
+ * Read how much of the process is backed by transparent huge pages
+ *
+ * @return long The size in kB, or -1 if unknown
+ */
+static long anon_huge_kb(void) {
+  FILE *f = fopen("/proc/self/smaps_rollup", "r");
+  if (f == NULL) {
+    return -1;
+  }
+
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+      break;
+    }
+  }
+
+  fclose(f);
+  return kb;
+}
+
+static void lookup(hash_table *ht, const char *keys, unsigned int num_ops,
+                   int dtlb_fd, result *r) {
+  unsigned int found = 0;
+
+  dtlb_start(dtlb_fd);
+  const double started = now_sec();
+  for (unsigned int i = 0; i < num_ops; i++) {
+    found += ht_get(ht, keys + (size_t)i * KEY_SIZE) != NULL;
+  }
+  const double elapsed = now_sec() - started;
+  const long long misses = dtlb_stop(dtlb_fd);
+
+  r->ns_per_op = elapsed * 1e9 / num_ops;
+  r->dtlb_misses_per_op = misses < 0 ? -1 : (double)misses / num_ops;
+
+  // Keep the lookups from being optimized away
+  if (found == UINT32_MAX) {
+    printf("\n");
+  }
+}
+
+static void print_result(const char *op, const result *r) {
+  if (r->dtlb_misses_per_op < 0) {
+    printf("  %-5s %8.1f ns/op  dTLB misses/op: n/a\n", op, r->ns_per_op);
+  } else {
+    printf("  %-5s %8.1f ns/op  dTLB misses/op: %.3f\n", op, r->ns_per_op,
+           r->dtlb_misses_per_op);
+  }
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: hugepage_bench [--entries=N] [--ops=N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned int n = 2000000;
+  unsigned int num_ops = 2000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--entries=", 10) == 0) {
+      n = (unsigned int)strtoul(argv[i] + 10, NULL, 10);
+    } else if (strncmp(argv[i], "--ops=", 6) == 0) {
+      num_ops = (unsigned int)strtoul(argv[i] + 6, NULL, 10);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (n < 1 || num_ops < 1) {
+    usage();
+    return 1;
+  }
+
+  char *hits = malloc((size_t)num_ops * KEY_SIZE);
+  char *misses = malloc((size_t)num_ops * KEY_SIZE);
+  for (unsigned int i = 0; i < num_ops; i++) {
+    snprintf(hits + (size_t)i * KEY_SIZE, KEY_SIZE, "%u",
+             (unsigned int)(rng_next() % n));
+    snprintf(misses + (size_t)i * KEY_SIZE, KEY_SIZE, "-%u",
+             (unsigned int)(rng_next() % n));
+  }
+
+  const int dtlb_fd = dtlb_open();
+  if (dtlb_fd < 0) {
+    fprintf(stderr, "dTLB misses cannot be counted; reporting times only\n");
+  }
+
+  for (unsigned int p = 0; p < sizeof(POLICIES) / sizeof(POLICIES[0]); p++) {
+    hash_table *ht = ht_init(n, NULL);
+    ht_set_hash_mode(ht, HT_HASH_CRC32C);
+    ht_set_memory_policy(ht, POLICIES[p].flags, -1);
+
+    char buf[KEY_SIZE];
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(buf, sizeof(buf), "%u", i);
+      ht_insert(ht, buf, "v");
+    }
+
+    result hit, miss;
+    lookup(ht, hits, num_ops, dtlb_fd, &hit);
+    lookup(ht, misses, num_ops, dtlb_fd, &miss);
+
+    const size_t slots_bytes = sizeof(ht_entry *) * ht->capacity;
+    printf("%s: %u entries, %.1f MB of slots (%s), AnonHugePages %ld kB\n",
+           POLICIES[p].name, n, slots_bytes / 1e6,
+           ht->entries_mapped ? "mapped" : "heap", anon_huge_kb());
+    print_result("hit", &hit);
+    print_result("miss", &miss);
+
+    ht_delete_table(ht);
+  }
+
+#ifdef __linux__
+  if (dtlb_fd >= 0) {
+    close(dtlb_fd);
+  }
+#endif
+  free(hits);
+  free(misses);
+
+  return 0;
+}
@@ -0,0 +1,169 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "libhash.h"
+
+static const char *LAYOUTS[] = {"boxed", "inline"};
+
+static const unsigned int SIZES[] = {1000, 10000, 100000, 1000000};
+
+/**
+ * A 16-byte value, as a session store might keep per key
+ */
+typedef struct {
+  uint64_t user_id;
+  uint64_t last_seen;
+} session;
+
+/**
+ * Where lookup results are written, so the lookups cannot be optimized away
+ */
+static volatile uint64_t sink;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Insert a session for each key: boxed in its own allocation, which the table
+ * frees once replaced, or copied into the entry
+ */
+static void insert_all(hash_table *ht, bool inline_values, char (*keys)[20],
+                       unsigned int n) {
+  for (unsigned int i = 0; i < n; i++) {
+    const session s = {.user_id = i, .last_seen = rng_next()};
+    if (inline_values) {
+      ht_insert(ht, keys[i], (void *)&s);
+    } else {
+      session *boxed = malloc(sizeof(session));
+      *boxed = s;
+      ht_insert(ht, keys[i], boxed);
+    }
+  }
+}
+
+/**
+ * Time inserting a session for each key, looking up random keys, and then
+ * replacing every session, and print a row of results
+ */
+static void measure(bool inline_values, char (*keys)[20], unsigned int n,
+                    const uint32_t *draws, unsigned int num_lookups) {
+  const size_t heap_before = heap_in_use();
+  double started = now_sec();
+  hash_table *ht =
+      inline_values ? ht_init_inline(0, sizeof(session)) : ht_init(0, free);
+  insert_all(ht, inline_values, keys, n);
+  const double insert_ns = (now_sec() - started) * 1e9 / n;
+  const double bytes = (double)(heap_in_use() - heap_before) / n;
+
+  uint64_t checksum = 0;
+  started = now_sec();
+  for (unsigned int i = 0; i < num_lookups; i++) {
+    const session *v = ht_get(ht, keys[draws[i]]);
+    checksum += v->last_seen;
+  }
+  const double get_ns = (now_sec() - started) * 1e9 / num_lookups;
+  sink = checksum;
+
+  // Every key again, so each entry's value is replaced
+  started = now_sec();
+  insert_all(ht, inline_values, keys, n);
+  const double replace_ns = (now_sec() - started) * 1e9 / n;
+
+  printf("%-9u %-8s %-10.1f %-13.1f %-10.1f %-14.1f\n", n,
+         inline_values ? "inline" : "boxed", bytes, insert_ns, get_ns,
+         replace_ns);
+
+  ht_delete_table(ht);
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: inline_bench [--lookups=N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned int num_lookups = 1000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lookups=", 10) == 0) {
+      num_lookups = strtoul(argv[i] + 10, NULL, 10);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (num_lookups < 1) {
+    usage();
+    return 1;
+  }
+
+  printf("%-9s %-8s %-10s %-13s %-10s %-14s\n", "entries", "values",
+         "B/entry", "insert ns/ent", "get ns", "replace ns/ent");
+
+  for (unsigned int s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+    const unsigned int n = SIZES[s];
+
+    char(*keys)[20] = malloc(sizeof(*keys) * n);
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(keys[i], sizeof(keys[i]), "session%u", i);
+    }
+
+    uint32_t *draws = malloc(sizeof(uint32_t) * num_lookups);
+    for (unsigned int i = 0; i < num_lookups; i++) {
+      draws[i] = rng_next() % n;
+    }
+
+    for (unsigned int l = 0; l < sizeof(LAYOUTS) / sizeof(LAYOUTS[0]); l++) {
+      // Each layout is measured in a child of its own, so that neither
+      // allocates from a heap the other has fragmented
+      fflush(stdout);
+      const pid_t pid = fork();
+      if (pid == 0) {
+        measure(strcmp(LAYOUTS[l], "inline") == 0, keys, n, draws,
+                num_lookups);
+        fflush(stdout);
+        _exit(0);
+      }
+      waitpid(pid, NULL, 0);
+    }
+
+    free(draws);
+    free(keys);
+  }
+
+  return 0;
+}
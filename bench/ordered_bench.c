@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "libhash.h"
+
+static const char *LAYOUTS[] = {"hashed", "ordered"};
+
+static const unsigned int SIZES[] = {1000, 10000, 100000, 1000000};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Sum a byte of each value over a full iteration, so it cannot be skipped
+ */
+static unsigned int iterate(hash_table *ht) {
+  unsigned int sum = 0;
+
+  HT_ITER_START(ht)
+  sum += *(const char *)entry->value;
+  HT_ITER_END
+
+  return sum;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: ordered_bench [--lookups=N] [--passes=N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned int num_lookups = 1000000;
+  unsigned int num_passes = 20;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--lookups=", 10) == 0) {
+      num_lookups = strtoul(argv[i] + 10, NULL, 10);
+    } else if (strncmp(argv[i], "--passes=", 9) == 0) {
+      num_passes = strtoul(argv[i] + 9, NULL, 10);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (num_lookups < 1 || num_passes < 1) {
+    usage();
+    return 1;
+  }
+
+  printf("%-9s %-8s %-10s %-12s %-12s %-10s\n", "entries", "layout",
+         "B/entry", "index B/ent", "iter ns/ent", "get ns");
+
+  unsigned int checksum = 0;
+  for (unsigned int s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+    const unsigned int n = SIZES[s];
+
+    char(*keys)[16] = malloc(sizeof(*keys) * n);
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(keys[i], sizeof(keys[i]), "key%u", i);
+    }
+
+    uint32_t *draws = malloc(sizeof(uint32_t) * num_lookups);
+    for (unsigned int i = 0; i < num_lookups; i++) {
+      draws[i] = rng_next() % n;
+    }
+
+    for (unsigned int l = 0; l < sizeof(LAYOUTS) / sizeof(LAYOUTS[0]); l++) {
+      const bool ordered = strcmp(LAYOUTS[l], "ordered") == 0;
+
+      const size_t heap_before = heap_in_use();
+      hash_table *ht = ordered ? ht_init_ordered(0, NULL) : ht_init(0, NULL);
+      for (unsigned int i = 0; i < n; i++) {
+        ht_insert(ht, keys[i], keys[i]);
+      }
+      const double bytes = (double)(heap_in_use() - heap_before) / n;
+
+      // The slots hashed into: pointers and a bucket list node per entry, or
+      // the narrow hash index
+      const double index_bytes =
+          ordered ? (double)ht->ordered_width * ht->capacity / n
+                  : (double)(sizeof(ht_entry *) * ht->capacity +
+                             sizeof(node_t) * ht->count) /
+                        n;
+
+      double started = now_sec();
+      for (unsigned int p = 0; p < num_passes; p++) {
+        checksum += iterate(ht);
+      }
+      const double iter_ns = (now_sec() - started) * 1e9 / num_passes / n;
+
+      started = now_sec();
+      for (unsigned int i = 0; i < num_lookups; i++) {
+        checksum += ht_get(ht, keys[draws[i]]) != NULL;
+      }
+      const double get_ns = (now_sec() - started) * 1e9 / num_lookups;
+
+      printf("%-9u %-8s %-10.1f %-12.1f %-12.2f %-10.1f\n", n, LAYOUTS[l],
+             bytes, index_bytes, iter_ns, get_ns);
+
+      ht_delete_table(ht);
+    }
+
+    free(draws);
+    free(keys);
+  }
+
+  // Printed so the work cannot be optimized away
+  printf("\nchecksum %u\n", checksum);
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_ENTRIES 400000
+#define MAX_THREADS 8
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Time the shrink of a table filled just down to its lower load threshold,
+ * which the next deletion triggers
+ *
+ * @return double The shrink time in ms
+ */
+static double time_shrink(unsigned int num_threads) {
+  hash_table *ht = ht_init(NUM_ENTRIES, NULL);
+  ht_set_resize_threads(ht, num_threads);
+
+  char buf[24];
+  unsigned int i = 0;
+  while (ht->count * 100 / ht->capacity < 30) {
+    snprintf(buf, sizeof(buf), "key-%u", i++);
+    ht_insert(ht, buf, NULL);
+  }
+
+  const unsigned int capacity = ht->capacity;
+  double elapsed = 0;
+  while (ht->capacity == capacity) {
+    snprintf(buf, sizeof(buf), "key-%u", --i);
+
+    const double start = now_sec();
+    ht_delete(ht, buf);
+    elapsed = now_sec() - start;
+  }
+
+  ht_delete_table(ht);
+  return elapsed * 1e3;
+}
+
+int main(void) {
+  printf("%-10s %-10s %-12s %-12s\n", "threads", "entries", "resize ms",
+         "shrink ms");
+
+  for (unsigned int num_threads = 1; num_threads <= MAX_THREADS;
+       num_threads *= 2) {
+    hash_table *ht = ht_init(NUM_ENTRIES, NULL);
+    ht_set_resize_threads(ht, num_threads);
+
+    // Fill the table right up to its load threshold so that the next insert
+    // triggers a resize
+    char buf[24];
+    unsigned int i = 0;
+    while (ht->count * 100 / ht->capacity <= 70) {
+      snprintf(buf, sizeof(buf), "key-%u", i++);
+      ht_insert(ht, buf, NULL);
+    }
+
+    const unsigned int entries = ht->count;
+    snprintf(buf, sizeof(buf), "key-%u", i);
+
+    const double start = now_sec();
+    ht_insert(ht, buf, NULL);
+    const double elapsed = now_sec() - start;
+
+    ht_delete_table(ht);
+
+    printf("%-10u %-10u %-12.3f %-12.3f\n", num_threads, entries,
+           elapsed * 1e3, time_shrink(num_threads));
+  }
+
+  return 0;
+}
@@ -0,0 +1,137 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libhash.h"
+
+/**
+ * Number of progress rows printed while the set grows
+ */
+#define NUM_REPORTS 10
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Read one of the process's memory counters from /proc/self/status
+ *
+ * @param field e.g. "VmRSS" or "VmHWM"
+ * @return long The size in kB, or -1 if unknown
+ */
+static long status_kb(const char *field) {
+  FILE *f = fopen("/proc/self/status", "r");
+  if (f == NULL) {
+    return -1;
+  }
+
+  const size_t len = strlen(field);
+  char line[256];
+  long kb = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, field, len) == 0 && line[len] == ':') {
+      kb = strtol(line + len + 1, NULL, 10);
+      break;
+    }
+  }
+
+  fclose(f);
+  return kb;
+}
+
+/**
+ * Format the i-th key. Hex keeps 500M keys within 8 characters, so they are
+ * as short as the keys of a set that size would realistically be.
+ */
+static void format_key(char *buf, size_t size, size_t i) {
+  snprintf(buf, size, "%zx", i);
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: scale_bench [--keys=N] [--lookups=N]\n");
+}
+
+int main(int argc, char **argv) {
+  // Small enough for `make bench` to run every benchmark. Pass
+  // --keys=500000000 to grow the set past the ~43M keys at which 32-bit load
+  // math used to overflow; that needs roughly 6 GB of slots and 16 GB of keys.
+  size_t n = 1000000;
+  size_t num_lookups = 1000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--keys=", 7) == 0) {
+      n = strtoull(argv[i] + 7, NULL, 10);
+    } else if (strncmp(argv[i], "--lookups=", 10) == 0) {
+      num_lookups = strtoull(argv[i] + 10, NULL, 10);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (n < NUM_REPORTS || num_lookups < 1) {
+    usage();
+    return 1;
+  }
+
+  printf("%-12s %-10s %-12s %-6s %-10s %-10s\n", "keys", "Mkeys/s",
+         "capacity", "load", "RSS MB", "B/key");
+
+  hash_set *hs = hs_init(0);
+  char buf[24];
+
+  const double started = now_sec();
+  double interval_started = started;
+  size_t interval_begin = 0;
+  for (size_t i = 0; i < n; i++) {
+    format_key(buf, sizeof(buf), i);
+    hs_insert(hs, buf);
+
+    if ((i + 1) % (n / NUM_REPORTS) == 0 || i + 1 == n) {
+      const double now = now_sec();
+      const long rss_kb = status_kb("VmRSS");
+      printf("%-12zu %-10.2f %-12zu %-6zu %-10.1f %-10.1f\n", hs->count,
+             (i + 1 - interval_begin) / (now - interval_started) / 1e6,
+             hs->capacity, hs->count * 100 / hs->capacity, rss_kb / 1024.0,
+             rss_kb * 1024.0 / hs->count);
+      fflush(stdout);
+
+      interval_started = now;
+      interval_begin = i + 1;
+    }
+  }
+  const double insert_sec = now_sec() - started;
+
+  // Hits land on random slots of the full array; misses probe to the end of
+  // their sequences
+  size_t found = 0;
+  double t = now_sec();
+  for (size_t i = 0; i < num_lookups; i++) {
+    format_key(buf, sizeof(buf), (i * 2654435761u) % n);
+    found += hs_contains(hs, buf);
+  }
+  const double hit_sec = now_sec() - t;
+
+  t = now_sec();
+  for (size_t i = 0; i < num_lookups; i++) {
+    format_key(buf, sizeof(buf), n + i);
+    found += hs_contains(hs, buf);
+  }
+  const double miss_sec = now_sec() - t;
+
+  printf("\n%zu keys in %.1f s: %.2f Mkeys/s inserted\n", hs->count,
+         insert_sec, n / insert_sec / 1e6);
+  printf("lookups: %.2f Mops/s hit, %.2f Mops/s miss (%zu of %zu found)\n",
+         num_lookups / hit_sec / 1e6, num_lookups / miss_sec / 1e6, found,
+         num_lookups);
+  printf("peak RSS: %.1f MB\n", status_kb("VmHWM") / 1024.0);
+
+  hs_delete_set(hs);
+
+  return 0;
+}
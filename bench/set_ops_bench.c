@@ -0,0 +1,75 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_LARGE 200000
+#define NUM_SMALL 20000
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char large_keys[NUM_LARGE][24];
+  static char small_keys[NUM_SMALL][24];
+
+  hash_set *large = hs_init(0);
+  hash_set *small = hs_init(0);
+  for (unsigned int i = 0; i < NUM_LARGE; i++) {
+    snprintf(large_keys[i], sizeof(large_keys[i]), "user-%u", i);
+    hs_insert(large, large_keys[i]);
+  }
+  for (unsigned int i = 0; i < NUM_SMALL; i++) {
+    // Half of the small set overlaps the large one
+    snprintf(small_keys[i], sizeof(small_keys[i]), "user-%u", i * 20);
+    hs_insert(small, small_keys[i]);
+  }
+
+  printf("%-32s %-12s %-10s\n", "method", "ms", "count");
+
+  // The baseline: walk one side's own key list and probe the other
+  double start = now_sec();
+  hash_set *naive = hs_init(0);
+  for (unsigned int i = 0; i < NUM_LARGE; i++) {
+    if (hs_contains(small, large_keys[i])) {
+      hs_insert(naive, large_keys[i]);
+    }
+  }
+  printf("%-32s %-12.1f %-10zu\n", "loop over large + hs_contains",
+         (now_sec() - start) * 1e3, naive->count);
+  hs_delete_set(naive);
+
+  const unsigned int threads[] = {1, 0};
+  for (unsigned int t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+    start = now_sec();
+    hash_set *hs = hs_intersect(large, small, threads[t]);
+    char label[32];
+    snprintf(label, sizeof(label), "hs_intersect (threads = %u)", threads[t]);
+    printf("%-32s %-12.1f %-10zu\n", label, (now_sec() - start) * 1e3,
+           hs->count);
+    hs_delete_set(hs);
+  }
+
+  start = now_sec();
+  hash_set *hs = hs_difference(large, small, 1);
+  printf("%-32s %-12.1f %-10zu\n", "hs_difference (large - small)",
+         (now_sec() - start) * 1e3, hs->count);
+  hs_delete_set(hs);
+
+  start = now_sec();
+  hs = hs_union(large, small, 1);
+  printf("%-32s %-12.1f %-10zu\n", "hs_union", (now_sec() - start) * 1e3,
+         hs->count);
+  hs_delete_set(hs);
+
+  hs_delete_set(small);
+  hs_delete_set(large);
+
+  return 0;
+}
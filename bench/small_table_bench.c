@@ -0,0 +1,166 @@
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "libhash.h"
+
+/**
+ * Largest number of entries per table measured
+ */
+#define MAX_ENTRIES 16
+
+static const char *LAYOUTS[] = {"small", "hashed"};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Create a table holding the first `n` keys, each its own value. Bulk builds
+ * skip the small layout, so the hashed table is laid out at the default
+ * capacity, as every table was before the small layout existed.
+ */
+static hash_table *make_table(const char *layout, const char **keys,
+                              unsigned int n) {
+  if (strcmp(layout, "hashed") == 0) {
+    return ht_build(keys, (void **)keys, n, NULL, 1);
+  }
+
+  hash_table *ht = ht_init(0, NULL);
+  for (unsigned int i = 0; i < n; i++) {
+    ht_insert(ht, keys[i], (void *)keys[i]);
+  }
+
+  return ht;
+}
+
+/**
+ * Time lookups of random keys in random tables
+ *
+ * @param tables
+ * @param num_tables
+ * @param keys Keys to look up, each in whichever table is drawn
+ * @param num_keys
+ * @param num_lookups
+ * @param found Incremented for each key found
+ * @return double Nanoseconds per lookup
+ */
+static double time_lookups(hash_table **tables, unsigned int num_tables,
+                           char (*keys)[8], unsigned int num_keys,
+                           unsigned int num_lookups, unsigned int *found) {
+  // Drawn up front, so that only the lookups themselves are timed
+  uint32_t *draws = malloc(sizeof(uint32_t) * num_lookups * 2);
+  for (unsigned int i = 0; i < num_lookups; i++) {
+    draws[i * 2] = rng_next() % num_tables;
+    draws[i * 2 + 1] = rng_next() % num_keys;
+  }
+
+  const double started = now_sec();
+  for (unsigned int i = 0; i < num_lookups; i++) {
+    *found += ht_search(tables[draws[i * 2]], keys[draws[i * 2 + 1]]) != NULL;
+  }
+  const double elapsed = now_sec() - started;
+
+  free(draws);
+  return elapsed * 1e9 / num_lookups;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: small_table_bench [--tables=N] [--lookups=N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned int num_tables = 10000;
+  unsigned int num_lookups = 2000000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--tables=", 9) == 0) {
+      num_tables = strtoul(argv[i] + 9, NULL, 10);
+    } else if (strncmp(argv[i], "--lookups=", 10) == 0) {
+      num_lookups = strtoul(argv[i] + 10, NULL, 10);
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  if (num_tables < 1 || num_lookups < 1) {
+    usage();
+    return 1;
+  }
+
+  // Short keys, like the field names of the records small tables often hold
+  char hits[MAX_ENTRIES][8];
+  char misses[MAX_ENTRIES][8];
+  const char *hit_keys[MAX_ENTRIES];
+  for (unsigned int i = 0; i < MAX_ENTRIES; i++) {
+    snprintf(hits[i], sizeof(hits[i]), "f%u", i);
+    snprintf(misses[i], sizeof(misses[i]), "g%u", i);
+    hit_keys[i] = hits[i];
+  }
+
+  hash_table **tables = malloc(sizeof(hash_table *) * num_tables);
+
+  printf("%-8s %-8s %-12s %-10s %-10s\n", "entries", "layout", "bytes/table",
+         "hit ns", "miss ns");
+
+  unsigned int found = 0;
+  for (unsigned int n = 1; n <= MAX_ENTRIES; n++) {
+    for (unsigned int l = 0; l < sizeof(LAYOUTS) / sizeof(LAYOUTS[0]); l++) {
+      const size_t heap_before = heap_in_use();
+      for (unsigned int t = 0; t < num_tables; t++) {
+        tables[t] = make_table(LAYOUTS[l], hit_keys, n);
+      }
+      const double bytes = (double)(heap_in_use() - heap_before) / num_tables;
+
+      const double hit_ns =
+          time_lookups(tables, num_tables, hits, n, num_lookups, &found);
+      const double miss_ns = time_lookups(tables, num_tables, misses,
+                                          MAX_ENTRIES, num_lookups, &found);
+
+      printf("%-8u %-8s %-12.0f %-10.1f %-10.1f\n", n, LAYOUTS[l], bytes,
+             hit_ns, miss_ns);
+
+      for (unsigned int t = 0; t < num_tables; t++) {
+        ht_delete_table(tables[t]);
+      }
+    }
+  }
+
+  // Printed so the lookups cannot be optimized away
+  printf("\n%u lookups found\n", found);
+
+  free(tables);
+
+  return 0;
+}
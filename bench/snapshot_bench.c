@@ -0,0 +1,52 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "libhash.h"
+
+#define NUM_KEYS 300000
+#define SNAPSHOT_PATH "snapshot_bench.bin"
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  static char bufs[NUM_KEYS][24];
+
+  printf("%-16s %-12s\n", "method", "ms");
+
+  double start = now_sec();
+  hash_table *ht = ht_init(0, NULL);
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "word-%u", i);
+    ht_insert(ht, bufs[i], bufs[i]);
+  }
+  printf("%-16s %-12.3f\n", "ht_insert", (now_sec() - start) * 1e3);
+
+  start = now_sec();
+  ht_save(ht, SNAPSHOT_PATH, NULL);
+  printf("%-16s %-12.3f\n", "ht_save", (now_sec() - start) * 1e3);
+  ht_delete_table(ht);
+
+  start = now_sec();
+  ht_mmap *htm = ht_open_mmap(SNAPSHOT_PATH);
+  printf("%-16s %-12.3f\n", "ht_open_mmap", (now_sec() - start) * 1e3);
+
+  start = now_sec();
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < NUM_KEYS; i++) {
+    found += ht_mmap_get(htm, bufs[i], NULL) != NULL;
+  }
+  printf("%-16s %-12.3f (%u found)\n", "ht_mmap_get", (now_sec() - start) * 1e3,
+         found);
+
+  ht_close_mmap(htm);
+  remove(SNAPSHOT_PATH);
+
+  return 0;
+}
@@ -0,0 +1,545 @@
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GLIBC__) && \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "libhash.h"
+
+/**
+ * Max number of operations timed per lookup, churn or delete scenario; larger
+ * tables are sampled
+ */
+#define MAX_SAMPLED_OPS 10000
+
+#define ZIPF_EXPONENT 0.99
+
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON } format;
+
+typedef struct {
+  format fmt;
+  FILE *out;
+  unsigned int num_rows;
+} reporter;
+
+typedef struct {
+  const char *structure;
+  const char *op;
+  const char *dist;
+  unsigned int key_len;
+  unsigned int size;
+  unsigned int ops;
+  double ns_per_op;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+  double bytes_per_entry;
+} result;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng_next(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static size_t heap_in_use(void) {
+#ifdef HAVE_MALLINFO2
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * Generate `n` distinct keys of exactly `len` characters. The index is
+ * written last, so keys differ in their final characters; the rest is filler
+ * derived from the index, so keys do not share one long common prefix.
+ */
+static char **make_keys(unsigned int n, unsigned int len, char tag) {
+  char **keys = malloc(sizeof(char *) * n);
+
+  for (unsigned int i = 0; i < n; i++) {
+    char *k = malloc(len + 1);
+    char digits[16];
+    const int num_digits = snprintf(digits, sizeof(digits), "%u", i);
+
+    uint64_t filler = (i + 1) * 0x9e3779b97f4a7c15ULL;
+    k[0] = tag;
+    for (unsigned int j = 1; j + num_digits < len; j++) {
+      k[j] = 'a' + (char)(filler % 26);
+      filler = filler / 26 ? filler / 26 : (i + j) * 0xff51afd7ed558ccdULL;
+    }
+    memcpy(k + len - num_digits, digits, (size_t)num_digits);
+    k[len] = '\0';
+
+    keys[i] = k;
+  }
+
+  return keys;
+}
+
+static void free_keys(char **keys, unsigned int n) {
+  for (unsigned int i = 0; i < n; i++) {
+    free(keys[i]);
+  }
+  free(keys);
+}
+
+/**
+ * Draw `n` indices into [0, size), either uniformly or following a Zipfian
+ * distribution in which index `i` has weight 1 / (i + 1)^s
+ */
+static unsigned int *make_indices(unsigned int n, unsigned int size,
+                                  int zipf) {
+  unsigned int *indices = malloc(sizeof(unsigned int) * n);
+
+  if (!zipf) {
+    for (unsigned int i = 0; i < n; i++) {
+      indices[i] = (unsigned int)(rng_next() % size);
+    }
+    return indices;
+  }
+
+  double *cdf = malloc(sizeof(double) * size);
+  double sum = 0;
+  for (unsigned int i = 0; i < size; i++) {
+    sum += 1 / pow(i + 1, ZIPF_EXPONENT);
+    cdf[i] = sum;
+  }
+
+  for (unsigned int i = 0; i < n; i++) {
+    const double u = (rng_next() >> 11) * 0x1.0p-53 * sum;
+
+    unsigned int lo = 0;
+    unsigned int hi = size - 1;
+    while (lo < hi) {
+      const unsigned int mid = lo + (hi - lo) / 2;
+      if (cdf[mid] < u) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    // Scatter the popular indices across the key space
+    indices[i] = (unsigned int)((lo * 2654435761ULL) % size);
+  }
+
+  free(cdf);
+
+  return indices;
+}
+
+static void shuffle(unsigned int *a, unsigned int n) {
+  for (unsigned int i = n; i > 1; i--) {
+    const unsigned int j = (unsigned int)(rng_next() % i);
+    const unsigned int tmp = a[i - 1];
+    a[i - 1] = a[j];
+    a[j] = tmp;
+  }
+}
+
+static int compare_u32(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Fill in a result's throughput and percentiles from per-operation latencies
+ */
+static void summarize(result *r, uint32_t *samples, unsigned int n,
+                      uint64_t total_ns) {
+  r->ops = n;
+  r->ns_per_op = n ? (double)total_ns / n : 0;
+
+  if (n == 0) {
+    r->p50 = r->p90 = r->p99 = r->max = 0;
+    return;
+  }
+
+  qsort(samples, n, sizeof(uint32_t), compare_u32);
+  r->p50 = samples[(size_t)n * 50 / 100];
+  r->p90 = samples[(size_t)n * 90 / 100];
+  r->p99 = samples[(size_t)n * 99 / 100];
+  r->max = samples[n - 1];
+}
+
+static void report_begin(reporter *rep) {
+  if (rep->fmt == FORMAT_CSV) {
+    fprintf(rep->out,
+            "structure,op,dist,key_len,size,ops,ns_per_op,p50_ns,p90_ns,"
+            "p99_ns,max_ns,bytes_per_entry\n");
+  } else if (rep->fmt == FORMAT_JSON) {
+    fprintf(rep->out, "[\n");
+  } else {
+    fprintf(rep->out, "%-10s %-8s %-8s %-8s %-9s %-10s %-10s %-10s %-10s\n",
+            "structure", "op", "dist", "key_len", "size", "ns/op", "p50",
+            "p99", "bytes/ent");
+  }
+}
+
+static void report(reporter *rep, const result *r) {
+  if (rep->fmt == FORMAT_CSV) {
+    fprintf(rep->out, "%s,%s,%s,%u,%u,%u,%.1f,%.0f,%.0f,%.0f,%.0f,%.1f\n",
+            r->structure, r->op, r->dist, r->key_len, r->size, r->ops,
+            r->ns_per_op, r->p50, r->p90, r->p99, r->max, r->bytes_per_entry);
+  } else if (rep->fmt == FORMAT_JSON) {
+    fprintf(rep->out,
+            "%s  {\"structure\": \"%s\", \"op\": \"%s\", \"dist\": \"%s\", "
+            "\"key_len\": %u, \"size\": %u, \"ops\": %u, \"ns_per_op\": %.1f, "
+            "\"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, "
+            "\"max_ns\": %.0f, \"bytes_per_entry\": %.1f}",
+            rep->num_rows ? ",\n" : "", r->structure, r->op, r->dist,
+            r->key_len, r->size, r->ops, r->ns_per_op, r->p50, r->p90, r->p99,
+            r->max, r->bytes_per_entry);
+  } else {
+    fprintf(rep->out,
+            "%-10s %-8s %-8s %-8u %-9u %-10.1f %-10.0f %-10.0f %-10.1f\n",
+            r->structure, r->op, r->dist, r->key_len, r->size, r->ns_per_op,
+            r->p50, r->p99, r->bytes_per_entry);
+  }
+
+  rep->num_rows++;
+}
+
+static void report_end(reporter *rep) {
+  if (rep->fmt == FORMAT_JSON) {
+    fprintf(rep->out, "\n]\n");
+  }
+}
+
+static void count_entry(ht_entry *entry, void *ctx) {
+  (*(unsigned int *)ctx) += entry->value != NULL;
+}
+
+/**
+ * Run every hash table scenario for one key length and table size
+ */
+static void bench_table(reporter *rep, unsigned int key_len,
+                        unsigned int size) {
+  char **keys = make_keys(size, key_len, 'k');
+  const unsigned int num_ops = size < MAX_SAMPLED_OPS ? size : MAX_SAMPLED_OPS;
+  char **misses = make_keys(num_ops, key_len, 'm');
+  uint32_t *samples = malloc(sizeof(uint32_t) * (size + 1));
+  result r = {.structure = "ht", .dist = "uniform", .key_len = key_len,
+              .size = size};
+
+  // insert: grows from the default capacity, so resizes are included
+  const size_t heap_before = heap_in_use();
+  hash_table *ht = ht_init(0, NULL);
+  uint64_t total = 0;
+  uint64_t resize_ns = 0;
+  uint32_t resize_max = 0;
+  unsigned int resizes = 0;
+  for (unsigned int i = 0; i < size; i++) {
+    const unsigned int capacity = ht->capacity;
+    const uint64_t start = now_ns();
+    ht_insert(ht, keys[i], keys[i]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+
+    if (ht->capacity != capacity) {
+      resize_ns += samples[i];
+      resize_max = samples[i] > resize_max ? samples[i] : resize_max;
+      resizes++;
+    }
+  }
+  const double bytes_per_entry =
+      heap_in_use() > heap_before
+          ? (double)(heap_in_use() - heap_before) / size
+          : 0;
+  r.op = "insert";
+  r.bytes_per_entry = bytes_per_entry;
+  summarize(&r, samples, size, total);
+  report(rep, &r);
+
+  // resize: the inserts which triggered a resize, in isolation
+  r.op = "resize";
+  r.ops = resizes;
+  r.ns_per_op = resizes ? (double)resize_ns / resizes : 0;
+  r.p50 = r.p90 = r.p99 = 0;
+  r.max = resize_max;
+  report(rep, &r);
+
+  // hit: looked up under both distributions
+  for (int zipf = 0; zipf <= 1; zipf++) {
+    unsigned int *indices = make_indices(num_ops, size, zipf);
+    total = 0;
+    for (unsigned int i = 0; i < num_ops; i++) {
+      const uint64_t start = now_ns();
+      void *v = ht_get(ht, keys[indices[i]]);
+      samples[i] = (uint32_t)(now_ns() - start);
+      total += samples[i];
+      if (v == NULL) {
+        fprintf(stderr, "missing key %s\n", keys[indices[i]]);
+        exit(1);
+      }
+    }
+    r.op = "hit";
+    r.dist = zipf ? "zipf" : "uniform";
+    summarize(&r, samples, num_ops, total);
+    report(rep, &r);
+    free(indices);
+  }
+  r.dist = "uniform";
+
+  // miss
+  total = 0;
+  for (unsigned int i = 0; i < num_ops; i++) {
+    const uint64_t start = now_ns();
+    ht_get(ht, misses[i]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+  }
+  r.op = "miss";
+  summarize(&r, samples, num_ops, total);
+  report(rep, &r);
+
+  // iterate: one timed pass over every entry
+  unsigned int seen = 0;
+  uint64_t start = now_ns();
+  ht_parallel_for_each(ht, count_entry, &seen, 1);
+  total = now_ns() - start;
+  r.op = "iterate";
+  r.ops = seen;
+  r.ns_per_op = seen ? (double)total / seen : 0;
+  r.p50 = r.p90 = r.p99 = r.max = 0;
+  report(rep, &r);
+
+  // churn: steady state of deleting a random key and inserting a new one
+  unsigned int *order = malloc(sizeof(unsigned int) * size);
+  for (unsigned int i = 0; i < size; i++) {
+    order[i] = i;
+  }
+  shuffle(order, size);
+  total = 0;
+  for (unsigned int i = 0; i < num_ops; i++) {
+    start = now_ns();
+    ht_delete(ht, keys[order[i]]);
+    ht_insert(ht, misses[i], misses[i]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+  }
+  r.op = "churn";
+  summarize(&r, samples, num_ops, total);
+  report(rep, &r);
+
+  // delete: keys still present, in random order
+  total = 0;
+  unsigned int deleted = 0;
+  for (unsigned int i = num_ops; i < size && deleted < num_ops; i++) {
+    start = now_ns();
+    ht_delete(ht, keys[order[i]]);
+    samples[deleted] = (uint32_t)(now_ns() - start);
+    total += samples[deleted++];
+  }
+  for (unsigned int i = 0; i < num_ops && deleted < num_ops; i++) {
+    start = now_ns();
+    ht_delete(ht, misses[i]);
+    samples[deleted] = (uint32_t)(now_ns() - start);
+    total += samples[deleted++];
+  }
+  r.op = "delete";
+  summarize(&r, samples, deleted, total);
+  report(rep, &r);
+
+  ht_delete_table(ht);
+  free(order);
+  free(samples);
+  free_keys(misses, num_ops);
+  free_keys(keys, size);
+}
+
+/**
+ * Run the hash set scenarios for one key length and set size
+ */
+static void bench_set(reporter *rep, unsigned int key_len, unsigned int size) {
+  char **keys = make_keys(size, key_len, 'k');
+  const unsigned int num_ops = size < MAX_SAMPLED_OPS ? size : MAX_SAMPLED_OPS;
+  char **misses = make_keys(num_ops, key_len, 'm');
+  uint32_t *samples = malloc(sizeof(uint32_t) * (size + 1));
+  result r = {.structure = "hs", .dist = "uniform", .key_len = key_len,
+              .size = size};
+
+  const size_t heap_before = heap_in_use();
+  hash_set *hs = hs_init(0);
+  uint64_t total = 0;
+  for (unsigned int i = 0; i < size; i++) {
+    const uint64_t start = now_ns();
+    hs_insert(hs, keys[i]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+  }
+  r.op = "insert";
+  r.bytes_per_entry = heap_in_use() > heap_before
+                          ? (double)(heap_in_use() - heap_before) / size
+                          : 0;
+  summarize(&r, samples, size, total);
+  report(rep, &r);
+
+  for (int zipf = 0; zipf <= 1; zipf++) {
+    unsigned int *indices = make_indices(num_ops, size, zipf);
+    total = 0;
+    for (unsigned int i = 0; i < num_ops; i++) {
+      const uint64_t start = now_ns();
+      hs_contains(hs, keys[indices[i]]);
+      samples[i] = (uint32_t)(now_ns() - start);
+      total += samples[i];
+    }
+    r.op = "hit";
+    r.dist = zipf ? "zipf" : "uniform";
+    summarize(&r, samples, num_ops, total);
+    report(rep, &r);
+    free(indices);
+  }
+  r.dist = "uniform";
+
+  total = 0;
+  for (unsigned int i = 0; i < num_ops; i++) {
+    const uint64_t start = now_ns();
+    hs_contains(hs, misses[i]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+  }
+  r.op = "miss";
+  summarize(&r, samples, num_ops, total);
+  report(rep, &r);
+
+  hs_cursor cursor;
+  hs_cursor_init(hs, &cursor);
+  unsigned int seen = 0;
+  uint64_t start = now_ns();
+  while (hs_cursor_next(hs, &cursor) != NULL) {
+    seen++;
+  }
+  total = now_ns() - start;
+  r.op = "iterate";
+  r.ops = seen;
+  r.ns_per_op = seen ? (double)total / seen : 0;
+  r.p50 = r.p90 = r.p99 = r.max = 0;
+  report(rep, &r);
+
+  unsigned int *order = malloc(sizeof(unsigned int) * size);
+  for (unsigned int i = 0; i < size; i++) {
+    order[i] = i;
+  }
+  shuffle(order, size);
+  total = 0;
+  for (unsigned int i = 0; i < num_ops; i++) {
+    start = now_ns();
+    hs_delete(hs, keys[order[i]]);
+    samples[i] = (uint32_t)(now_ns() - start);
+    total += samples[i];
+  }
+  r.op = "delete";
+  summarize(&r, samples, num_ops, total);
+  report(rep, &r);
+
+  hs_delete_set(hs);
+  free(order);
+  free(samples);
+  free_keys(misses, num_ops);
+  free_keys(keys, size);
+}
+
+/**
+ * Parse a comma-separated list of unsigned integers into `out`
+ */
+static unsigned int parse_list(const char *s, unsigned int *out,
+                               unsigned int max) {
+  unsigned int n = 0;
+  while (*s && n < max) {
+    char *end;
+    out[n++] = (unsigned int)strtoul(s, &end, 10);
+    s = *end == ',' ? end + 1 : end + strlen(end);
+  }
+
+  return n;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: table_bench [--format=text|csv|json] [--out=FILE]\n"
+          "                   [--sizes=N,...] [--key-lens=N,...] [--quick]\n");
+}
+
+int main(int argc, char **argv) {
+  reporter rep = {.fmt = FORMAT_TEXT, .out = stdout};
+
+  // Table sizes span from fitting in L1 to well beyond the last level cache
+  unsigned int sizes[16] = {1000, 30000, 300000};
+  unsigned int num_sizes = 3;
+  unsigned int key_lens[16] = {8, 32, 128};
+  unsigned int num_key_lens = 3;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--format=csv") == 0) {
+      rep.fmt = FORMAT_CSV;
+    } else if (strcmp(argv[i], "--format=json") == 0) {
+      rep.fmt = FORMAT_JSON;
+    } else if (strcmp(argv[i], "--format=text") == 0) {
+      rep.fmt = FORMAT_TEXT;
+    } else if (strncmp(argv[i], "--out=", 6) == 0) {
+      rep.out = fopen(argv[i] + 6, "w");
+      if (rep.out == NULL) {
+        perror(argv[i] + 6);
+        return 1;
+      }
+    } else if (strncmp(argv[i], "--sizes=", 8) == 0) {
+      num_sizes = parse_list(argv[i] + 8, sizes, 16);
+    } else if (strncmp(argv[i], "--key-lens=", 11) == 0) {
+      num_key_lens = parse_list(argv[i] + 11, key_lens, 16);
+    } else if (strcmp(argv[i], "--quick") == 0) {
+      num_sizes = 2;
+      num_key_lens = 1;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  for (unsigned int k = 0; k < num_key_lens; k++) {
+    // Leave room for the tag and the index
+    if (key_lens[k] < 8) {
+      key_lens[k] = 8;
+    }
+  }
+
+  report_begin(&rep);
+  for (unsigned int s = 0; s < num_sizes; s++) {
+    for (unsigned int k = 0; k < num_key_lens; k++) {
+      if (sizes[s] == 0) {
+        continue;
+      }
+      bench_table(&rep, key_lens[k], sizes[s]);
+      bench_set(&rep, key_lens[k], sizes[s]);
+    }
+  }
+  report_end(&rep);
+
+  if (rep.out != stdout) {
+    fclose(rep.out);
+  }
+
+  return 0;
+}
@@ -1,11 +1,23 @@
 #ifndef LIBHASH_H
 #define LIBHASH_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "list.h"
 
 #define HT_DEFAULT_CAPACITY 53
 #define HS_DEFAULT_CAPACITY 53
 
+/**
+ * Number of slots of a table or set in the small layout. A table initialized
+ * with at most the default capacity, or a set with at most this one, starts
+ * out holding its keys packed in this many slots, which are searched linearly
+ * by comparing a byte of each key's hash eight at a time; it moves to the
+ * hashed layout once it outgrows them.
+ */
+#define HT_SMALL_CAPACITY 8
+
 /**
  * A free function that will be invoked a hashmap value any time it is removed.
  *
@@ -22,6 +34,132 @@ typedef struct {
   void *value;
 } ht_entry;
 
+/**
+ * A clock function used to expire entries
+ *
+ * @return uint64_t The current time in milliseconds, measured from any fixed
+ * point
+ */
+typedef uint64_t ht_clock_fn(void);
+
+/**
+ * The expiry state of a table; see `ht_init_ttl`
+ */
+typedef struct ht_expiry ht_expiry;
+
+/**
+ * Number of buckets in a probe length histogram; the last bucket also counts
+ * every longer probe
+ */
+#define HT_STATS_PROBE_BUCKETS 16
+
+/**
+ * Running counters of a table or set. Only maintained when the library is
+ * built with LIBHASH_STATS (`make STATS=1`); otherwise they stay zero and
+ * cost nothing.
+ */
+typedef struct {
+  /**
+   * Number of times the slot array was grown or shrunk
+   */
+  unsigned int resizes;
+
+  /**
+   * Total time spent resizing, in nanoseconds
+   */
+  uint64_t resize_ns;
+
+  /**
+   * Number of allocations made for slots, entries and keys, and their total
+   * size in bytes; both only ever grow
+   */
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+} ht_counters;
+
+/**
+ * A snapshot of the shape of a table or set, for telling how well its keys
+ * are spread and tuning its capacity; see `ht_get_stats`
+ */
+typedef struct {
+  size_t capacity;
+  size_t count;
+
+  /**
+   * Number of slots left behind by deleted keys
+   */
+  size_t tombstones;
+
+  double load_factor;
+
+  /**
+   * Number of keys by displacement, i.e. how many probes it takes to reach
+   * them past their home slot; a bucket of 0 counts keys in their home slot
+   */
+  size_t probe_lengths[HT_STATS_PROBE_BUCKETS];
+
+  size_t max_displacement;
+  double mean_displacement;
+
+  ht_counters counters;
+} ht_stats;
+
+/**
+ * How a table hashes its keys
+ */
+typedef enum {
+  /**
+   * The default double hash. Unseeded, so keys can be crafted to collide.
+   */
+  HT_HASH_DEFAULT,
+
+  /**
+   * SipHash-1-3 keyed with a random per-table seed, for tables whose keys
+   * may be chosen by an adversary
+   */
+  HT_HASH_SEEDED,
+
+  /**
+   * CRC32C, computed in hardware where the CPU supports it (SSE4.2 on
+   * x86-64, detected at runtime). The fastest mode for short keys, but
+   * unseeded, like the default.
+   */
+  HT_HASH_CRC32C,
+} ht_hash_mode;
+
+/**
+ * How a table's slot array is backed; see `ht_set_memory_policy`. Flags may
+ * be combined, and are hints: any the system cannot honour are ignored.
+ */
+typedef enum {
+  /**
+   * Allocate the slot array from the heap
+   */
+  HT_MEM_DEFAULT = 0,
+
+  /**
+   * Back the slot array with transparent huge pages, cutting the TLB misses
+   * of random lookups into large tables
+   */
+  HT_MEM_HUGEPAGES = 1 << 0,
+
+  /**
+   * Back the slot array with explicit huge pages from the hugetlb pool,
+   * falling back to transparent huge pages when the pool runs dry
+   */
+  HT_MEM_HUGETLB = 1 << 1,
+
+  /**
+   * Interleave the slot array's pages across every NUMA node
+   */
+  HT_MEM_INTERLEAVE = 1 << 2,
+
+  /**
+   * Bind the slot array's pages to a single NUMA node
+   */
+  HT_MEM_BIND = 1 << 3,
+} ht_mem_flags;
+
 /**
  * A hash table
  */
@@ -30,20 +168,28 @@ typedef struct {
    * Max number of entries which may be stored in the hash table. Adjustable.
    * Calculated as the first prime subsequent to the base capacity.
    */
-  unsigned int capacity;
+  size_t capacity;
 
   /**
    * Base capacity (used to calculate load for resizing)
    */
-  unsigned int base_capacity;
+  size_t base_capacity;
 
   /**
    * Number of non-NULL entries in the hash table
    */
-  unsigned int count;
+  size_t count;
+
+  /**
+   * Number of slots (in the ordered layout, index slots) left deleted by
+   * removed entries. Probes pass over them as they do over entries, so they
+   * count toward the load.
+   */
+  size_t deleted;
 
   /**
-   * The hash table's entries
+   * The hash table's entries; in the ordered layout, packed in insertion
+   * order and found through `ordered_index`
    */
   ht_entry **entries;
 
@@ -55,8 +201,132 @@ typedef struct {
   free_fn *free_value;
 
   node_t *occupied_buckets;
+
+  /**
+   * Number of threads used to rehash the table when it is resized; 1 (the
+   * default) resizes on the calling thread, 0 uses one thread per online CPU.
+   * Small tables are always resized on the calling thread.
+   */
+  unsigned int resize_threads;
+
+  /**
+   * Incremented whenever the table changes capacity or hash; lets cursors
+   * detect that the slot array they were walking has been rehashed anew.
+   */
+  unsigned int generation;
+
+  /**
+   * Expiry state; NULL unless the table was initialized with `ht_init_ttl`
+   */
+  ht_expiry *expiry;
+
+  /**
+   * See `ht_counters`
+   */
+  ht_counters counters;
+
+  /**
+   * How keys are hashed; see `ht_set_hash_mode`
+   */
+  ht_hash_mode hash_mode;
+
+  /**
+   * Secret key of the keyed hash, used in HT_HASH_SEEDED mode
+   */
+  uint64_t seed[2];
+
+  /**
+   * Number of entries inserted since the table was last rehashed by its probe
+   * length watchdog; see `ht_set_hash_mode`
+   */
+  size_t inserts_since_rehash;
+
+  /**
+   * How the slot array is backed; see `ht_set_memory_policy`
+   */
+  unsigned int mem_flags;
+  int numa_node;
+
+  /**
+   * Length of the mapping backing `entries`, or 0 if it came from the heap
+   */
+  size_t entries_mapped;
+
+  /**
+   * A mapped slot array released by a resize and kept for the next one, its
+   * pages already returned to the system
+   */
+  void *spare_slots;
+  size_t spare_mapped;
+
+  /**
+   * In the small layout, a tag per slot derived from its key's hash, slot `i`
+   * in byte `i` and 0 for an empty slot; see HT_SMALL_CAPACITY
+   */
+  uint64_t small_tags;
+
+  /**
+   * In the small layout, the number of slots filled so far. Entries are
+   * appended, so the slots below it hold them in insertion order, with gaps
+   * where entries were deleted.
+   */
+  unsigned int small_used;
+
+  /**
+   * In the ordered layout, the hash index: for each of `capacity` slots, 0 if
+   * empty, 1 + the position in `entries` of the entry whose key it holds, or
+   * every bit set if that entry was deleted. NULL in the other layouts; see
+   * `ht_init_ordered`.
+   */
+  void *ordered_index;
+
+  /**
+   * Bytes per slot of `ordered_index`: 1, 2, 4 or 8, the fewest which can
+   * hold every position in `entries`
+   */
+  unsigned int ordered_width;
+
+  /**
+   * In the ordered layout, the number of positions in `entries` filled so
+   * far, with gaps where entries were deleted
+   */
+  size_t ordered_used;
+
+  /**
+   * Size in bytes of the values stored inline in each entry, or 0 if values
+   * are pointers held on the caller's behalf; see `ht_init_inline`
+   */
+  size_t value_size;
 } hash_table;
 
+/**
+ * An external iterator over a hash table's slots. A cursor is a plain value
+ * - it holds no reference into the table - so any number of cursors may be
+ * live at once, and a scan may be suspended and resumed at will.
+ *
+ * Every entry which is present for the whole duration of a scan is returned
+ * at least once, even if the table grows or shrinks mid-scan: a cursor which
+ * observes a resize restarts from the beginning of the new slot array, so
+ * entries may then be returned more than once. Entries inserted or deleted
+ * mid-scan may or may not be returned.
+ *
+ * Rehashes which keep the capacity - clearing deleted slots, or closing gaps
+ * in the small and ordered layouts - leave the cursor where it is, so that a
+ * scan of a table under steady churn still finishes. Entries such a rehash
+ * moves may then be missed or returned twice.
+ */
+typedef struct {
+  /**
+   * Index of the next slot to visit
+   */
+  size_t pos;
+
+  /**
+   * The table's generation when the cursor last moved
+   */
+  unsigned int generation;
+} ht_cursor;
+
 /**
  * Initialize a new hash table with a size of `max_size`
  *
@@ -64,16 +334,89 @@ typedef struct {
  * @param free_value See free_fn
  * @return hash_table*
  */
-hash_table *ht_init(int base_capacity, free_fn *free_value);
+hash_table *ht_init(size_t base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new hash table whose entries may expire. Expired entries are
+ * removed lazily, when they are looked up, and incrementally, by
+ * `ht_expire_step`.
+ *
+ * @param base_capacity
+ * @param free_value See free_fn; also invoked with the values of expired
+ * entries
+ * @param clock Clock expiry is measured against; if NULL, a monotonic clock
+ * @return hash_table*
+ */
+hash_table *ht_init_ttl(size_t base_capacity, free_fn *free_value,
+                        ht_clock_fn *clock);
+
+/**
+ * Initialize a new hash table in the ordered layout. Entries are appended to
+ * a dense array, and iterate in the order their keys were first inserted -
+ * by `HT_ITER_START`, cursors and slot ranges alike. The slots hashed into
+ * hold positions in that array rather than pointers, each in as few bytes as
+ * the table's size allows, and no bucket list is kept.
+ *
+ * @param base_capacity
+ * @param free_value See free_fn
+ * @return hash_table*
+ */
+hash_table *ht_init_ordered(size_t base_capacity, free_fn *free_value);
+
+/**
+ * Initialize a new hash table which stores values of `value_size` bytes
+ * inline, in the same allocation as each entry, rather than as pointers. The
+ * `value` passed to `ht_insert` is instead the address of the bytes to copy
+ * in, and `ht_get` and `entry->value` point at the entry's own copy, which
+ * stays put until the entry is replaced or deleted. No allocation is made per
+ * value, and none is freed.
+ *
+ * @param base_capacity
+ * @param value_size Size in bytes of each value; must not be 0
+ * @return hash_table*
+ */
+hash_table *ht_init_inline(size_t base_capacity, size_t value_size);
 
 /**
- * Insert a key, value pair into the given hash table.
+ * Insert a key, value pair into the given hash table. In a table with expiry
+ * enabled, the entry never expires - even if it replaces one which would
+ * have. In a table with inline values, `value` is the address of the bytes
+ * to copy in.
  *
  * @param ht
  * @param key
  */
 void ht_insert(hash_table *ht, const char *key, void *value);
 
+/**
+ * Insert a key, value pair which expires after `ttl` milliseconds into a table
+ * initialized with `ht_init_ttl`. Once expired, the entry is no longer
+ * returned by `ht_search` or `ht_get`, but it may still be visited by
+ * iteration until it is removed by a lookup or by `ht_expire_step`.
+ *
+ * @param ht
+ * @param key
+ * @param value
+ * @param ttl Time to live in milliseconds; 0 means the entry never expires.
+ * Ignored by tables without expiry enabled.
+ */
+void ht_insert_ttl(hash_table *ht, const char *key, void *value,
+                   uint64_t ttl);
+
+/**
+ * Remove entries whose time to live has elapsed, doing at most `budget` units
+ * of work. Expiry timers are kept in a hierarchical timing wheel, so the work
+ * done is proportional to the number of entries expired rather than the size
+ * of the table or the time elapsed since the last call; calling this
+ * periodically with a small budget bounds the latency of each call.
+ *
+ * @param ht
+ * @param budget Max number of timers to handle, whether expiring an entry or
+ * moving its timer to a finer-grained level of the wheel
+ * @return unsigned int Number of entries removed
+ */
+unsigned int ht_expire_step(hash_table *ht, unsigned int budget);
+
 /**
  * Search for the entry corresponding to the given key
  *
@@ -91,6 +434,71 @@ ht_entry *ht_search(hash_table *ht, const char *key);
  */
 void *ht_get(hash_table *ht, const char *key);
 
+/**
+ * Build a new hash table from `n` key, value pairs in one pass. The table is
+ * sized up front, keys are hashed and partitioned by slot region in parallel,
+ * and each region is then filled by its own thread - much faster than `n`
+ * calls to `ht_insert` for large inputs. Pairs which share a key are applied
+ * in array order, the last value winning.
+ *
+ * @param keys
+ * @param values Values corresponding to `keys`, or NULL for all NULL values
+ * @param n
+ * @param free_value See free_fn
+ * @param num_threads Number of threads to use; 0 means one per online CPU
+ * @return hash_table*
+ */
+hash_table *ht_build(const char **keys, void **values, size_t n,
+                     free_fn *free_value, unsigned int num_threads);
+
+/**
+ * Set the number of threads used to rehash the given table's entries whenever
+ * it grows or shrinks. See `hash_table.resize_threads`.
+ *
+ * @param ht
+ * @param num_threads
+ */
+void ht_set_resize_threads(hash_table *ht, unsigned int num_threads);
+
+/**
+ * Switch the given table to another hash mode, and rehash its entries in
+ * place. Switching to HT_HASH_SEEDED draws a fresh random seed each time.
+ *
+ * Whatever the mode, a watchdog guards every table: an insertion which probes
+ * past abnormally many other keys - the signature of colliding keys; deleted
+ * slots are not counted - moves an unseeded table to HT_HASH_SEEDED, or
+ * re-seeds a seeded one, so adversarial keys cannot make insertion quadratic.
+ * A seeded table is re-seeded at most once per `count` insertions, so
+ * rehashing costs amortized O(1).
+ *
+ * @param ht
+ * @param mode
+ */
+void ht_set_hash_mode(hash_table *ht, ht_hash_mode mode);
+
+/**
+ * Set how the given table's slot array is backed, moving the current slots
+ * into an array allocated accordingly; every array allocated as the table
+ * grows or shrinks follows suit. Huge pages and NUMA placement are supported
+ * on Linux; elsewhere, and for flags the system cannot honour, slot arrays
+ * come from the heap.
+ *
+ * @param ht
+ * @param flags A combination of `ht_mem_flags`
+ * @param numa_node Node to bind to with HT_MEM_BIND; ignored otherwise
+ */
+void ht_set_memory_policy(hash_table *ht, unsigned int flags, int numa_node);
+
+/**
+ * Collect the given table's stats. The probe length histogram is computed by
+ * walking every slot, so this takes time proportional to the capacity; the
+ * counters are read as they stand.
+ *
+ * @param ht
+ * @param stats
+ */
+void ht_get_stats(hash_table *ht, ht_stats *stats);
+
 /**
  * Delete a hash table and deallocate its memory
  *
@@ -112,53 +520,242 @@ void ht_delete_table(hash_table *ht);
  */
 int ht_delete(hash_table *ht, const char *key);
 
-#define HT_ITER_START(ht)                \
-  node_t *head = ht->occupied_buckets;   \
-  while (!list_is_sentinel_node(head)) { \
-    ht_entry *entry = ht->entries[head->value];
+/**
+ * A visitor function invoked with each entry of a table during iteration.
+ *
+ * @param entry
+ * @param ctx Caller-supplied context
+ */
+typedef void ht_visit_fn(ht_entry *entry, void *ctx);
+
+/**
+ * A reducer function which folds an entry into an accumulator.
+ *
+ * @param acc The accumulator of the calling thread
+ * @param entry
+ * @param ctx Caller-supplied context
+ */
+typedef void ht_reduce_fn(void *acc, ht_entry *entry, void *ctx);
+
+/**
+ * A combiner function which merges the accumulator `other` into `acc`.
+ *
+ * @param acc
+ * @param other
+ * @param ctx Caller-supplied context
+ */
+typedef void ht_combine_fn(void *acc, const void *other, void *ctx);
+
+/**
+ * Visit the entries stored in slots `begin` (inclusive) to `end` (exclusive)
+ * of the given table. Slot ranges partition the table, so disjoint ranges may
+ * be handed to different threads, or a full scan may be split into small
+ * slices. `end` is clamped to the table's capacity; ranges are invalidated by
+ * any insert or delete which resizes the table. In the ordered layout, slots
+ * are positions in insertion order.
+ *
+ * @param ht
+ * @param begin
+ * @param end
+ * @param visit
+ * @param ctx Passed through to `visit`
+ */
+void ht_for_each_range(hash_table *ht, size_t begin, size_t end,
+                       ht_visit_fn *visit, void *ctx);
+
+/**
+ * Visit every entry in the table, spreading chunks of slots across up to
+ * `num_threads` threads. `visit` may be invoked concurrently and must not
+ * modify the table.
+ *
+ * @param ht
+ * @param visit
+ * @param ctx Passed through to `visit`
+ * @param num_threads Number of threads to use; 0 means one per online CPU
+ */
+void ht_parallel_for_each(hash_table *ht, ht_visit_fn *visit, void *ctx,
+                          unsigned int num_threads);
+
+/**
+ * Reduce every entry in the table into `acc` across up to `num_threads`
+ * threads. Each thread folds its share of the entries into a private copy of
+ * `acc`'s initial value, which must therefore be the identity of `combine`;
+ * the private copies are then combined into `acc` on the calling thread.
+ * Neither `reduce` nor `combine` may modify the table.
+ *
+ * @param ht
+ * @param acc The accumulator; holds the initial value on entry and the result
+ * on return
+ * @param acc_size Size in bytes of the accumulator
+ * @param reduce
+ * @param combine
+ * @param ctx Passed through to `reduce` and `combine`
+ * @param num_threads Number of threads to use; 0 means one per online CPU
+ */
+void ht_reduce(hash_table *ht, void *acc, size_t acc_size,
+               ht_reduce_fn *reduce, ht_combine_fn *combine, void *ctx,
+               unsigned int num_threads);
+
+/**
+ * Position a cursor at the start of the given table
+ *
+ * @param ht
+ * @param cursor
+ */
+void ht_cursor_init(hash_table *ht, ht_cursor *cursor);
+
+/**
+ * Advance a cursor to the next entry of the table. The table may be modified
+ * between calls, including deleting the entry which was just returned.
+ *
+ * @param ht
+ * @param cursor
+ * @return ht_entry* The next entry, or NULL once the scan is complete
+ */
+ht_entry *ht_cursor_next(hash_table *ht, ht_cursor *cursor);
+
+/**
+ * Advance a cursor by at most `budget` slots, invoking `visit` with each entry
+ * found. Because the budget counts slots rather than entries, each call does
+ * a bounded amount of work however sparse the table is, which suits sweeping
+ * a large table in small time slices. `visit` may insert or delete entries,
+ * including the one it was invoked with.
+ *
+ * @param ht
+ * @param cursor
+ * @param budget Maximum number of slots to visit
+ * @param visit
+ * @param ctx Passed through to `visit`
+ * @return 1 if slots remain to be visited, 0 once the scan is complete
+ */
+int ht_scan(hash_table *ht, ht_cursor *cursor, size_t budget,
+            ht_visit_fn *visit, void *ctx);
+
+/**
+ * Advance an iteration begun with `HT_ITER_START`
+ *
+ * @param ht
+ * @param head Position in the occupied bucket list, in the hashed layout
+ * @param slot Position in the slot array, in the small and ordered layouts
+ * @return ht_entry* The next entry, or NULL once every entry has been visited
+ */
+ht_entry *ht_iter_next(hash_table *ht, node_t **head, size_t *slot);
+
+/**
+ * Iterate over every entry of a table, binding each in turn to `entry`: most
+ * recently inserted first, or in insertion order in the ordered layout
+ */
+#define HT_ITER_START(ht)              \
+  node_t *head = ht->occupied_buckets; \
+  size_t iter_slot = ht->small_used;   \
+  ht_entry *entry;                     \
+  while ((entry = ht_iter_next(ht, &head, &iter_slot)) != NULL) {
 
-#define HT_ITER_END  \
-  head = head->next; \
-  }
+#define HT_ITER_END }
 
 typedef struct {
   /**
    * Max number of keys which may be stored in the hash set. Adjustable.
    * Calculated as the first prime subsequent to the base capacity.
    */
-  unsigned int capacity;
+  size_t capacity;
 
   /**
    * Base capacity (used to calculate load for resizing)
    */
-  unsigned int base_capacity;
+  size_t base_capacity;
 
   /**
    * Number of non-NULL keys in the hash set
    */
-  unsigned int count;
+  size_t count;
+
+  /**
+   * Number of slots left deleted by removed keys. Probes pass over them as
+   * they do over keys, so they count toward the load.
+   */
+  size_t deleted;
 
   /**
    * The hash set's keys
    */
   char **keys;
+
+  /**
+   * Incremented whenever the set changes capacity. See
+   * `hash_table.generation`.
+   */
+  unsigned int generation;
+
+  /**
+   * See `ht_counters`
+   */
+  ht_counters counters;
+
+  /**
+   * See `hash_table.small_tags` and `hash_table.small_used`
+   */
+  uint64_t small_tags;
+  unsigned int small_used;
 } hash_set;
 
 /**
- * Initialize a new hash set with a size of `max_size`
- *
- * @param max_size The hash set capacity
- * @return hash_set*
+ * See `ht_stats`
  */
-hash_set *hs_init(int base_capacity);
+typedef ht_stats hs_stats;
 
 /**
- * Insert a key into the given hash set.
- *
- * @param hs
- * @param key
+ * An external iterator over a hash set's slots. See `ht_cursor`.
  */
-void hs_insert(hash_set *hs, const void *key);
+typedef struct {
+  /**
+   * Index of the next slot to visit
+   */
+  size_t pos;
+
+  /**
+   * The set's generation when the cursor last moved
+   */
+  unsigned int generation;
+} hs_cursor;
+
+/**
+ * A visitor function invoked with each key of a set during iteration.
+ *
+ * @param key
+ * @param ctx Caller-supplied context
+ */
+typedef void hs_visit_fn(const char *key, void *ctx);
+
+/**
+ * Initialize a new hash set with a size of `max_size`
+ *
+ * @param max_size The hash set capacity
+ * @return hash_set*
+ */
+hash_set *hs_init(size_t base_capacity);
+
+/**
+ * Insert a key into the given hash set.
+ *
+ * @param hs
+ * @param key
+ * @return 1 if the key was newly inserted, 0 if it already existed in the set
+ */
+int hs_insert(hash_set *hs, const void *key);
+
+/**
+ * Build a new hash set from `n` keys in one pass. The set is sized up front,
+ * keys are hashed and partitioned by slot region in parallel, and each region
+ * is then filled by its own thread - much faster than `n` calls to
+ * `hs_insert` for large inputs. Duplicate keys are inserted once.
+ *
+ * @param keys
+ * @param n
+ * @param num_threads Number of threads to use; 0 means one per online CPU
+ * @return hash_set*
+ */
+hash_set *hs_build(const char **keys, size_t n, unsigned int num_threads);
 
 /**
  * Check whether the given hash set contains a key `key`
@@ -176,6 +773,14 @@ int hs_contains(hash_set *hs, const char *key);
  */
 void hs_delete_set(hash_set *hs);
 
+/**
+ * Collect the given set's stats. See `ht_get_stats`.
+ *
+ * @param hs
+ * @param stats
+ */
+void hs_get_stats(hash_set *hs, hs_stats *stats);
+
 /**
  * Delete the given key `key`.
  *
@@ -187,4 +792,970 @@ void hs_delete_set(hash_set *hs);
  */
 int hs_delete(hash_set *hs, const char *key);
 
+/**
+ * Position a cursor at the start of the given set
+ *
+ * @param hs
+ * @param cursor
+ */
+void hs_cursor_init(hash_set *hs, hs_cursor *cursor);
+
+/**
+ * Advance a cursor to the next key of the set. The set may be modified
+ * between calls, including deleting the key which was just returned.
+ *
+ * @param hs
+ * @param cursor
+ * @return const char* The next key, or NULL once the scan is complete
+ */
+const char *hs_cursor_next(hash_set *hs, hs_cursor *cursor);
+
+/**
+ * Advance a cursor by at most `budget` slots, invoking `visit` with each key
+ * found. See `ht_scan`.
+ *
+ * @param hs
+ * @param cursor
+ * @param budget Maximum number of slots to visit
+ * @param visit
+ * @param ctx Passed through to `visit`
+ * @return 1 if slots remain to be visited, 0 once the scan is complete
+ */
+int hs_scan(hash_set *hs, hs_cursor *cursor, size_t budget,
+            hs_visit_fn *visit, void *ctx);
+
+/**
+ * Create a new set holding every key which is in either `a` or `b`. The
+ * larger set is copied slot for slot, so its keys are not rehashed, and only
+ * the keys of the smaller set are probed for.
+ *
+ * @param a
+ * @param b
+ * @param num_threads Number of threads to use for large sets; 0 means one per
+ * online CPU
+ * @return hash_set*
+ */
+hash_set *hs_union(hash_set *a, hash_set *b, unsigned int num_threads);
+
+/**
+ * Create a new set holding every key which is in both `a` and `b`. Only the
+ * keys of the smaller set are probed for in the larger one, in batches whose
+ * memory accesses overlap, and the result is laid out like the smaller set,
+ * so the keys kept are not rehashed.
+ *
+ * @param a
+ * @param b
+ * @param num_threads Number of threads to use for large sets; 0 means one per
+ * online CPU
+ * @return hash_set*
+ */
+hash_set *hs_intersect(hash_set *a, hash_set *b, unsigned int num_threads);
+
+/**
+ * Create a new set holding every key which is in `a` but not in `b`. Probes
+ * whichever of the two sets is larger for the keys of the smaller one.
+ *
+ * @param a
+ * @param b
+ * @param num_threads Number of threads to use for large sets; 0 means one per
+ * online CPU
+ * @return hash_set*
+ */
+hash_set *hs_difference(hash_set *a, hash_set *b, unsigned int num_threads);
+
+/**
+ * Insert every key of `src` into `dst`
+ *
+ * @param dst
+ * @param src
+ */
+void hs_union_into(hash_set *dst, hash_set *src);
+
+/**
+ * Delete every key of `dst` which is not in `src`. If `src` is the smaller
+ * set, the result is computed from it and swapped into `dst`.
+ *
+ * @param dst
+ * @param src
+ * @param num_threads Number of threads to use for large sets; 0 means one per
+ * online CPU
+ */
+void hs_intersect_into(hash_set *dst, hash_set *src, unsigned int num_threads);
+
+/**
+ * Delete every key of `dst` which is in `src`
+ *
+ * @param dst
+ * @param src
+ * @param num_threads Number of threads to use for large sets; 0 means one per
+ * online CPU
+ */
+void hs_difference_into(hash_set *dst, hash_set *src,
+                        unsigned int num_threads);
+
+/**
+ * A lock-free hash set which may be shared by any number of threads. Keys are
+ * claimed with a single compare-and-swap into an open-addressed slot array;
+ * when the array fills, every thread that observes the resize helps migrate
+ * keys into the successor array instead of waiting on a lock.
+ *
+ * Keys cannot be deleted individually - the set is geared towards
+ * deduplication, where membership only ever grows.
+ */
+typedef struct concurrent_hash_set concurrent_hash_set;
+
+/**
+ * Initialize a new concurrent hash set with a size of `base_capacity`
+ *
+ * @param base_capacity The initial hash set capacity
+ * @return concurrent_hash_set*
+ */
+concurrent_hash_set *chs_init(size_t base_capacity);
+
+/**
+ * Insert a key into the given concurrent hash set. Safe to call concurrently
+ * with any other `chs_insert` or `chs_contains` call. When several threads
+ * race to insert the same key, exactly one of them observes it as new.
+ *
+ * @param chs
+ * @param key
+ * @return 1 if the key was newly inserted, 0 if it already existed in the set
+ */
+int chs_insert(concurrent_hash_set *chs, const char *key);
+
+/**
+ * Check whether the given concurrent hash set contains a key `key`. Safe to
+ * call concurrently with any other `chs_insert` or `chs_contains` call.
+ *
+ * @param chs
+ * @param key
+ * @return 1 for true, 0 for false
+ */
+int chs_contains(concurrent_hash_set *chs, const char *key);
+
+/**
+ * Retrieve the number of keys in the given concurrent hash set
+ *
+ * @param chs
+ * @return size_t
+ */
+size_t chs_count(concurrent_hash_set *chs);
+
+/**
+ * Delete a concurrent hash set and deallocate its memory. Must not be called
+ * while other threads are still operating on the set.
+ *
+ * @param chs Concurrent hash set to delete
+ */
+void chs_delete_set(concurrent_hash_set *chs);
+
+/**
+ * A hash table split into independent shards, each a hash_table with its own
+ * lock. Keys are routed by the high bits of their hash, so a resize only
+ * stalls the shard which triggered it and unrelated keys may be operated on
+ * from different threads at the same time.
+ */
+typedef struct sharded_hash_table sharded_hash_table;
+
+/**
+ * Initialize a new sharded hash table
+ *
+ * @param num_shards Number of shards; rounded up to a power of two
+ * @param base_capacity The initial capacity of each shard
+ * @param free_value See free_fn
+ * @return sharded_hash_table*
+ */
+sharded_hash_table *sht_init(unsigned int num_shards, size_t base_capacity,
+                             free_fn *free_value);
+
+/**
+ * Insert a key, value pair into the given sharded hash table. Thread-safe.
+ *
+ * @param sht
+ * @param key
+ * @param value
+ */
+void sht_insert(sharded_hash_table *sht, const char *key, void *value);
+
+/**
+ * Retrieve the value stored at the given key, or NULL if there is no such key.
+ * Thread-safe, though the caller must coordinate the value's lifetime with
+ * any concurrent `sht_delete` of the same key.
+ *
+ * @param sht
+ * @param key
+ */
+void *sht_get(sharded_hash_table *sht, const char *key);
+
+/**
+ * Delete the entry for the given key `key`. Thread-safe.
+ *
+ * @param sht
+ * @param key
+ *
+ * @return 1 if a entry was deleted, 0 if no entry corresponding
+ * to the given key could be found
+ */
+int sht_delete(sharded_hash_table *sht, const char *key);
+
+/**
+ * Insert `n` key, value pairs. Keys are grouped by shard so that each shard's
+ * lock is taken once per batch rather than once per key. Pairs which share a
+ * key are applied in array order.
+ *
+ * @param sht
+ * @param keys
+ * @param values
+ * @param n
+ */
+void sht_insert_batch(sharded_hash_table *sht, const char **keys,
+                      void **values, unsigned int n);
+
+/**
+ * Retrieve the values stored at `n` keys into `values`, taking each shard's
+ * lock once per batch. Missing keys yield NULL.
+ *
+ * @param sht
+ * @param keys
+ * @param values Output array with room for `n` values
+ * @param n
+ */
+void sht_get_batch(sharded_hash_table *sht, const char **keys, void **values,
+                   unsigned int n);
+
+/**
+ * Delete the entries for `n` keys, taking each shard's lock once per batch.
+ *
+ * @param sht
+ * @param keys
+ * @param n
+ * @return unsigned int The number of entries which were deleted
+ */
+unsigned int sht_delete_batch(sharded_hash_table *sht, const char **keys,
+                              unsigned int n);
+
+/**
+ * Visit every entry in the table, handing whole shards out to up to
+ * `num_threads` threads. Each shard is locked for the duration of its visit,
+ * so `visit` may be invoked concurrently for entries of different shards but
+ * must not itself modify the table.
+ *
+ * @param sht
+ * @param visit
+ * @param ctx Passed through to `visit`
+ * @param num_threads Number of threads to use; 0 means one per online CPU
+ */
+void sht_parallel_for_each(sharded_hash_table *sht, ht_visit_fn *visit,
+                           void *ctx, unsigned int num_threads);
+
+/**
+ * Retrieve the number of entries across all shards
+ *
+ * @param sht
+ * @return size_t
+ */
+size_t sht_count(sharded_hash_table *sht);
+
+/**
+ * Delete a sharded hash table and deallocate its memory. Must not be called
+ * while other threads are still operating on the table.
+ *
+ * @param sht Sharded hash table to delete
+ */
+void sht_delete_table(sharded_hash_table *sht);
+
+/**
+ * Eviction policies of a hash_cache
+ */
+typedef enum {
+  /**
+   * Evict the least recently used entry. Every hit relinks the entry at the
+   * head of the recency list.
+   */
+  HC_LRU,
+
+  /**
+   * Evict with the CLOCK approximation of LRU: a hit only sets the entry's
+   * reference flag, and eviction sweeps a hand over the entries, clearing
+   * flags, until it finds one which is unset. Hits never modify the cache's
+   * structure, so `hc_get` calls may run concurrently with one another (under
+   * a shared lock, for example) so long as nothing else runs alongside them.
+   */
+  HC_CLOCK,
+} hc_policy;
+
+/**
+ * A fixed-capacity cache. Entries live in a pool of nodes allocated up front,
+ * which carry their own recency links and are found through an open-addressed
+ * index, so lookups never allocate and every operation is O(1). Once the cache
+ * is full, each insertion of a new key evicts an entry according to the
+ * cache's policy.
+ */
+typedef struct hash_cache hash_cache;
+
+/**
+ * Initialize a new cache holding at most `capacity` entries
+ *
+ * @param capacity At most UINT_MAX - 1; larger capacities are reduced to it
+ * @param policy
+ * @param free_value See free_fn; also invoked with the values of evicted and
+ * replaced entries
+ * @return hash_cache*
+ */
+hash_cache *hc_init(size_t capacity, hc_policy policy, free_fn *free_value);
+
+/**
+ * Retrieve the value stored at the given key, marking the entry as recently
+ * used
+ *
+ * @param hc
+ * @param key
+ * @return void* The value, or NULL if the key is not cached
+ */
+void *hc_get(hash_cache *hc, const char *key);
+
+/**
+ * Insert a key, value pair into the cache, evicting an entry if the cache is
+ * full. If the key is already cached, its value is replaced.
+ *
+ * @param hc
+ * @param key
+ * @param value
+ */
+void hc_put(hash_cache *hc, const char *key, void *value);
+
+/**
+ * Delete the entry for the given key `key`
+ *
+ * @param hc
+ * @param key
+ * @return 1 if an entry was deleted, 0 if the key was not cached
+ */
+int hc_delete(hash_cache *hc, const char *key);
+
+/**
+ * Retrieve the number of entries in the cache
+ *
+ * @param hc
+ * @return size_t
+ */
+size_t hc_count(hash_cache *hc);
+
+/**
+ * Delete a cache and deallocate its memory
+ *
+ * @param hc Cache to delete
+ */
+void hc_delete_cache(hash_cache *hc);
+
+/**
+ * A table of integer counts keyed by string, e.g. a word counter. Counts are
+ * stored inline in the table's slots rather than boxed behind value
+ * pointers, so counting a key which is already present never allocates.
+ */
+typedef struct hash_counter hash_counter;
+
+/**
+ * A key and its count, as returned by the top-k functions. The key points
+ * into the counter it was taken from.
+ */
+typedef struct {
+  const char *key;
+  uint64_t count;
+} hcnt_item;
+
+/**
+ * Initialize a new counter with a size of `base_capacity`
+ *
+ * @param base_capacity
+ * @return hash_counter*
+ */
+hash_counter *hcnt_init(size_t base_capacity);
+
+/**
+ * Add `delta` to the count of the given key, starting from 0 if the key is
+ * not yet counted
+ *
+ * @param hcnt
+ * @param key
+ * @param delta
+ * @return uint64_t The key's new count
+ */
+uint64_t hcnt_add(hash_counter *hcnt, const char *key, uint64_t delta);
+
+/**
+ * Retrieve the count of the given key
+ *
+ * @param hcnt
+ * @param key
+ * @return uint64_t The count, or 0 if the key is not counted
+ */
+uint64_t hcnt_get(hash_counter *hcnt, const char *key);
+
+/**
+ * Remove the given key from the counter
+ *
+ * @param hcnt
+ * @param key
+ * @return uint64_t The key's count, or 0 if the key was not counted
+ */
+uint64_t hcnt_remove(hash_counter *hcnt, const char *key);
+
+/**
+ * Retrieve the number of distinct keys in the counter
+ *
+ * @param hcnt
+ * @return size_t
+ */
+size_t hcnt_count(hash_counter *hcnt);
+
+/**
+ * Retrieve the sum of the counts of every key in the counter
+ *
+ * @param hcnt
+ * @return uint64_t
+ */
+uint64_t hcnt_total(hash_counter *hcnt);
+
+/**
+ * Retrieve the `k` keys with the highest counts, by partial selection: a
+ * single pass keeps the best `k` keys seen so far in a heap, which costs
+ * O(n log k) rather than the O(n log n) of sorting every key. Keys with equal
+ * counts are ranked by key.
+ *
+ * @param hcnt
+ * @param k
+ * @param out Receives up to `k` items, highest count first; the keys remain
+ * valid until the counter is next modified
+ * @return unsigned int The number of items written to `out`
+ */
+unsigned int hcnt_top_k(hash_counter *hcnt, unsigned int k, hcnt_item *out);
+
+/**
+ * Delete a counter and deallocate its memory
+ *
+ * @param hcnt Counter to delete
+ */
+void hcnt_delete_counter(hash_counter *hcnt);
+
+/**
+ * A counter which may be updated by any number of threads at once. A key
+ * claims its slot with a single CAS the first time it is counted, after which
+ * counting it is a single atomic add. Slots are never moved, so the counter
+ * holds a fixed number of distinct keys, set when it is initialized.
+ */
+typedef struct concurrent_hash_counter concurrent_hash_counter;
+
+/**
+ * Initialize a new concurrent counter holding at most `max_keys` distinct
+ * keys
+ *
+ * @param max_keys
+ * @return concurrent_hash_counter*
+ */
+concurrent_hash_counter *chcnt_init(unsigned int max_keys);
+
+/**
+ * Add `delta` to the count of the given key. Safe to call concurrently with
+ * any other `chcnt_add`, `chcnt_get` or `chcnt_top_k` call.
+ *
+ * @param chcnt
+ * @param key
+ * @param delta
+ * @return 1 on success, 0 if the key is new and the counter is full
+ */
+int chcnt_add(concurrent_hash_counter *chcnt, const char *key,
+              uint64_t delta);
+
+/**
+ * Retrieve the count of the given key
+ *
+ * @param chcnt
+ * @param key
+ * @return uint64_t The count, or 0 if the key is not counted
+ */
+uint64_t chcnt_get(concurrent_hash_counter *chcnt, const char *key);
+
+/**
+ * Retrieve the number of distinct keys in the concurrent counter
+ *
+ * @param chcnt
+ * @return unsigned int
+ */
+unsigned int chcnt_count(concurrent_hash_counter *chcnt);
+
+/**
+ * Retrieve the `k` keys with the highest counts. See `hcnt_top_k`. If other
+ * threads are counting meanwhile, each count is read at some point during
+ * the call.
+ *
+ * @param chcnt
+ * @param k
+ * @param out Receives up to `k` items, highest count first; the keys remain
+ * valid until the counter is deleted
+ * @return unsigned int The number of items written to `out`
+ */
+unsigned int chcnt_top_k(concurrent_hash_counter *chcnt, unsigned int k,
+                         hcnt_item *out);
+
+/**
+ * Delete a concurrent counter and deallocate its memory. Must not be called
+ * while other threads are still operating on the counter.
+ *
+ * @param chcnt Concurrent counter to delete
+ */
+void chcnt_delete_counter(concurrent_hash_counter *chcnt);
+
+/**
+ * An approximate counter for streams with too many distinct keys to count
+ * exactly. A Count-Min sketch holds a fixed grid of counters, so its memory
+ * does not grow with the number of keys; estimates never undercount, and
+ * overcount by at most `epsilon` times the stream's total with probability at
+ * least 1 - `delta`. Optionally tracks the `k` heavy hitters - the keys with
+ * the highest estimates.
+ */
+typedef struct count_min_sketch count_min_sketch;
+
+/**
+ * Initialize a new Count-Min sketch
+ *
+ * @param epsilon Max overcount, as a fraction of the stream's total, e.g.
+ * 0.001
+ * @param delta Probability of exceeding the max overcount, e.g. 0.01
+ * @param k Number of heavy hitters to track; 0 disables tracking
+ * @return count_min_sketch*
+ */
+count_min_sketch *cms_init(double epsilon, double delta, unsigned int k);
+
+/**
+ * Add `delta` to the count of the given key
+ *
+ * @param cms
+ * @param key
+ * @param delta
+ * @return uint64_t The key's new estimate
+ */
+uint64_t cms_add(count_min_sketch *cms, const char *key, uint64_t delta);
+
+/**
+ * Estimate the count of the given key
+ *
+ * @param cms
+ * @param key
+ * @return uint64_t
+ */
+uint64_t cms_estimate(count_min_sketch *cms, const char *key);
+
+/**
+ * Retrieve the tracked heavy hitters
+ *
+ * @param cms
+ * @param out Receives up to `k` items, highest estimate first; the keys
+ * remain valid until the sketch is next modified
+ * @return unsigned int The number of items written to `out`
+ */
+unsigned int cms_top_k(count_min_sketch *cms, hcnt_item *out);
+
+/**
+ * Delete a Count-Min sketch and deallocate its memory
+ *
+ * @param cms Sketch to delete
+ */
+void cms_delete_sketch(count_min_sketch *cms);
+
+/**
+ * A HyperLogLog sketch, which estimates the number of distinct keys added to
+ * it in a fixed amount of memory: 2^precision bytes, for a standard error of
+ * about 1.04 / sqrt(2^precision). Keys are hashed with the same 64-bit hash
+ * as the tables. A sketch starts out in a sparse representation, which holds
+ * only the registers set so far at a much higher precision, and so is both
+ * smaller and near exact for small cardinalities; it switches to the dense
+ * representation once that is the smaller of the two.
+ */
+typedef struct hyperloglog hyperloglog;
+
+/**
+ * Initialize a new, empty sketch
+ *
+ * @param precision Number of index bits, from 4 to 18; e.g. 14 for a standard
+ * error of about 0.8% in 16KiB
+ * @return hyperloglog*
+ */
+hyperloglog *hll_init(unsigned int precision);
+
+/**
+ * Add a key to the given sketch
+ *
+ * @param hll
+ * @param key
+ */
+void hll_add(hyperloglog *hll, const char *key);
+
+/**
+ * Estimate the number of distinct keys added to the sketch
+ *
+ * @param hll
+ * @return uint64_t
+ */
+uint64_t hll_count(hyperloglog *hll);
+
+/**
+ * Merge `src` into `dst`, so that `dst` estimates the number of distinct keys
+ * added to either
+ *
+ * @param dst
+ * @param src
+ * @return 1 on success, 0 if the sketches' precisions differ
+ */
+int hll_merge(hyperloglog *dst, hyperloglog *src);
+
+/**
+ * Serialize the given sketch into `buf`. The format is independent of the
+ * host's byte order.
+ *
+ * @param hll
+ * @param buf
+ * @param size Size in bytes of `buf`
+ * @return size_t The size of the serialized sketch; if greater than `size`,
+ * nothing was written
+ */
+size_t hll_serialize(hyperloglog *hll, void *buf, size_t size);
+
+/**
+ * Deserialize a sketch written by `hll_serialize`
+ *
+ * @param buf
+ * @param size
+ * @return hyperloglog* The sketch, or NULL if `buf` does not hold a valid one
+ */
+hyperloglog *hll_deserialize(const void *buf, size_t size);
+
+/**
+ * Delete a sketch and deallocate its memory
+ *
+ * @param hll Sketch to delete
+ */
+void hll_delete(hyperloglog *hll);
+
+/**
+ * A distinct counter which stays exact while it is small: keys are kept in a
+ * hash set until their number exceeds a threshold, at which point they are
+ * replayed into a HyperLogLog sketch and the set is freed.
+ */
+typedef struct distinct_counter distinct_counter;
+
+/**
+ * Initialize a new distinct counter
+ *
+ * @param threshold Number of distinct keys above which the counter switches
+ * to a sketch
+ * @param precision Precision of the sketch; see `hll_init`
+ * @return distinct_counter*
+ */
+distinct_counter *dc_init(unsigned int threshold, unsigned int precision);
+
+/**
+ * Add a key to the given distinct counter
+ *
+ * @param dc
+ * @param key
+ */
+void dc_add(distinct_counter *dc, const char *key);
+
+/**
+ * Retrieve the number of distinct keys added to the counter; exact until the
+ * counter switches to a sketch, and an estimate thereafter
+ *
+ * @param dc
+ * @return uint64_t
+ */
+uint64_t dc_count(distinct_counter *dc);
+
+/**
+ * Check whether the counter is still counting exactly
+ *
+ * @param dc
+ * @return 1 for true, 0 for false
+ */
+int dc_is_exact(distinct_counter *dc);
+
+/**
+ * Delete a distinct counter and deallocate its memory
+ *
+ * @param dc Distinct counter to delete
+ */
+void dc_delete(distinct_counter *dc);
+
+/**
+ * A cache-blocked (split-block) Bloom filter. Each key sets one bit in each of
+ * the eight 32-bit words of a single 32-byte block, so both inserting and
+ * probing touch one cache line. Bloom filters never report a false negative,
+ * so a filter placed in front of a large set answers most negative queries
+ * without touching the set.
+ */
+typedef struct bloom_filter bloom_filter;
+
+/**
+ * Initialize a new, empty Bloom filter sized to hold `n` keys at a false
+ * positive rate of at most `fpr`
+ *
+ * @param n Expected number of keys
+ * @param fpr Target false positive rate, e.g. 0.01
+ * @return bloom_filter*
+ */
+bloom_filter *bf_init(size_t n, double fpr);
+
+/**
+ * Build a Bloom filter over every key of the given set, at a false positive
+ * rate of at most `fpr`. The filter does not track subsequent changes to the
+ * set.
+ *
+ * @param hs
+ * @param fpr Target false positive rate, e.g. 0.01
+ * @return bloom_filter*
+ */
+bloom_filter *bf_from_set(hash_set *hs, double fpr);
+
+/**
+ * Insert a key into the given Bloom filter
+ *
+ * @param bf
+ * @param key
+ */
+void bf_insert(bloom_filter *bf, const char *key);
+
+/**
+ * Check whether the given Bloom filter may contain a key `key`
+ *
+ * @param bf
+ * @param key
+ * @return 0 if the key was definitely never inserted, 1 if it may have been
+ */
+int bf_contains(bloom_filter *bf, const char *key);
+
+/**
+ * Retrieve the size in bytes of the filter's bit array
+ *
+ * @param bf
+ * @return size_t
+ */
+size_t bf_size(bloom_filter *bf);
+
+/**
+ * Delete a Bloom filter and deallocate its memory
+ *
+ * @param bf Bloom filter to delete
+ */
+void bf_delete_filter(bloom_filter *bf);
+
+/**
+ * An immutable hash table indexed by a minimal perfect hash function. Each key
+ * maps to its own slot, so a lookup is a single probe and a key compare, and
+ * there are exactly as many slots as entries. Suited to tables which are
+ * built once and then only read, such as keyword or routing tables.
+ */
+typedef struct frozen_hash_table frozen_hash_table;
+
+/**
+ * An immutable hash set indexed by a minimal perfect hash function. See
+ * `frozen_hash_table`.
+ */
+typedef struct frozen_hash_set frozen_hash_set;
+
+/**
+ * Convert the given table into a frozen table. The table is consumed: its
+ * entries are moved into the frozen table, and it is deallocated.
+ *
+ * @param ht
+ * @return frozen_hash_table* The frozen table, or NULL if two keys share a
+ * 64-bit hash, in which case `ht` is left intact
+ */
+frozen_hash_table *ht_freeze(hash_table *ht);
+
+/**
+ * Search for the entry corresponding to the given key
+ *
+ * @param fht
+ * @param key
+ * @return ht_entry* The entry, or NULL if the key does not exist
+ */
+ht_entry *fht_search(frozen_hash_table *fht, const char *key);
+
+/**
+ * Retrieve the value stored at the given key
+ *
+ * @param fht
+ * @param key
+ * @return void* The value, or NULL if the key does not exist
+ */
+void *fht_get(frozen_hash_table *fht, const char *key);
+
+/**
+ * Retrieve the number of entries in the frozen table
+ *
+ * @param fht
+ * @return size_t
+ */
+size_t fht_count(frozen_hash_table *fht);
+
+/**
+ * Delete a frozen table and deallocate its memory
+ *
+ * @param fht Frozen table to delete
+ */
+void fht_delete_table(frozen_hash_table *fht);
+
+/**
+ * Convert the given set into a frozen set. The set is consumed: its keys are
+ * moved into the frozen set, and it is deallocated.
+ *
+ * @param hs
+ * @return frozen_hash_set* The frozen set, or NULL if two keys share a 64-bit
+ * hash, in which case `hs` is left intact
+ */
+frozen_hash_set *hs_freeze(hash_set *hs);
+
+/**
+ * Check whether the given frozen set contains a key `key`
+ *
+ * @param fhs
+ * @param key
+ * @return 1 for true, 0 for false
+ */
+int fhs_contains(frozen_hash_set *fhs, const char *key);
+
+/**
+ * Retrieve the number of keys in the frozen set
+ *
+ * @param fhs
+ * @return size_t
+ */
+size_t fhs_count(frozen_hash_set *fhs);
+
+/**
+ * Delete a frozen set and deallocate its memory
+ *
+ * @param fhs Frozen set to delete
+ */
+void fhs_delete_set(frozen_hash_set *fhs);
+
+/**
+ * A function which returns the size in bytes of a table value, so that the
+ * value may be copied verbatim into a snapshot.
+ *
+ * @param value A non-NULL value
+ * @return size_t
+ */
+typedef size_t ht_value_size_fn(const void *value);
+
+/**
+ * Save the given table to `path` as a snapshot which `ht_open_mmap` can serve
+ * lookups from directly. The file is position-independent - the slot array
+ * holds file offsets rather than pointers - and is written to a temporary
+ * file which is then renamed over `path`, so processes which have a previous
+ * snapshot at `path` mapped are unaffected.
+ *
+ * @param ht
+ * @param path
+ * @param value_size Returns the size of each non-NULL value; if NULL, values
+ * are taken to be strings and saved along with their NUL terminator. Ignored
+ * for tables with inline values, which are saved at their fixed size.
+ * @return 1 on success, 0 on failure (with `errno` set)
+ */
+int ht_save(hash_table *ht, const char *path, ht_value_size_fn *value_size);
+
+/**
+ * Save the given set to `path` as a snapshot which `hs_open_mmap` can serve
+ * lookups from directly. See `ht_save`.
+ *
+ * @param hs
+ * @param path
+ * @return 1 on success, 0 on failure (with `errno` set)
+ */
+int hs_save(hash_set *hs, const char *path);
+
+/**
+ * A read-only hash table served directly from a memory-mapped snapshot.
+ * Opening a snapshot costs a single `mmap` regardless of its size - nothing
+ * is deserialized, and pages are faulted in as lookups touch them. A mapped
+ * table may be shared by any number of threads.
+ */
+typedef struct ht_mmap ht_mmap;
+
+/**
+ * A read-only hash set served directly from a memory-mapped snapshot. See
+ * `ht_mmap`.
+ */
+typedef struct hs_mmap hs_mmap;
+
+/**
+ * Map the table snapshot at `path`
+ *
+ * @param path
+ * @return ht_mmap* The mapped table, or NULL if the file could not be mapped
+ * or is not a table snapshot
+ */
+ht_mmap *ht_open_mmap(const char *path);
+
+/**
+ * Retrieve the value stored at the given key. The value points into the
+ * mapping and is aligned to 8 bytes; it remains valid until the table is
+ * closed.
+ *
+ * @param htm
+ * @param key
+ * @param size If not NULL, receives the size in bytes of the value
+ * @return const void* The value, or NULL if the key does not exist or its
+ * value was NULL
+ */
+const void *ht_mmap_get(ht_mmap *htm, const char *key, size_t *size);
+
+/**
+ * Retrieve the number of entries in the mapped table
+ *
+ * @param htm
+ * @return size_t
+ */
+size_t ht_mmap_count(ht_mmap *htm);
+
+/**
+ * Unmap a mapped table and deallocate its memory
+ *
+ * @param htm
+ */
+void ht_close_mmap(ht_mmap *htm);
+
+/**
+ * Map the set snapshot at `path`
+ *
+ * @param path
+ * @return hs_mmap* The mapped set, or NULL if the file could not be mapped or
+ * is not a set snapshot
+ */
+hs_mmap *hs_open_mmap(const char *path);
+
+/**
+ * Check whether the mapped set contains a key `key`
+ *
+ * @param hsm
+ * @param key
+ * @return 1 for true, 0 for false
+ */
+int hs_mmap_contains(hs_mmap *hsm, const char *key);
+
+/**
+ * Retrieve the number of keys in the mapped set
+ *
+ * @param hsm
+ * @return size_t
+ */
+size_t hs_mmap_count(hs_mmap *hsm);
+
+/**
+ * Unmap a mapped set and deallocate its memory
+ *
+ * @param hsm
+ */
+void hs_close_mmap(hs_mmap *hsm);
+
 #endif /* LIBHASH_H */
@@ -0,0 +1,160 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * Number of 32-bit words in a block. A key sets one bit in each word of a
+ * single block, so a probe touches 32 contiguous bytes - never more than one
+ * cache line.
+ */
+#define BF_BLOCK_WORDS 8
+
+#define BF_CACHE_LINE 64
+
+/**
+ * Odd multipliers, one per word, which derive a key's bit in each word from
+ * the low half of its hash
+ */
+static const uint32_t BF_SALTS[BF_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+typedef struct {
+  _Alignas(BF_BLOCK_WORDS * 4) uint32_t words[BF_BLOCK_WORDS];
+} bf_block;
+
+struct bloom_filter {
+  bf_block *blocks;
+  size_t num_blocks;
+};
+
+/**
+ * Estimate the false positive rate of a split-block filter holding `c` bits
+ * per key. Keys are spread over blocks unevenly, so the estimate sums the
+ * rate of a block holding `i` keys over the Poisson distribution of `i`.
+ *
+ * @param c Bits per key
+ * @return double
+ */
+static double bf_estimate_fpr(double c) {
+  const double lambda = BF_BLOCK_WORDS * 32 / c;
+
+  double p = exp(-lambda);
+  double fpr = 0;
+  for (unsigned int i = 0; i < 4 * lambda + 64; i++) {
+    // A word holding `i` keys has each bit set with probability 1 - (31/32)^i
+    fpr += p * pow(1 - pow(1 - 1.0 / 32, i), BF_BLOCK_WORDS);
+    p *= lambda / (i + 1);
+  }
+
+  return fpr;
+}
+
+/**
+ * Resolve the block of the given hash. Multiply-shift maps the high bits
+ * onto [0, num_blocks) without a division, while the block count fits in 32
+ * bits; beyond that, the hash is reduced with one.
+ *
+ * @param bf
+ * @param hash
+ * @return bf_block*
+ */
+static bf_block *bf_block_of(bloom_filter *bf, uint64_t hash) {
+  if (bf->num_blocks <= UINT32_MAX) {
+    return &bf->blocks[((hash >> 32) * bf->num_blocks) >> 32];
+  }
+
+  return &bf->blocks[hash % bf->num_blocks];
+}
+
+/**
+ * Compute the mask of bits a hash sets in each word of its block. Written as
+ * fixed-width lane loops so that the compiler can vectorize them.
+ *
+ * @param hash
+ * @param mask
+ */
+static void bf_mask(uint64_t hash, uint32_t mask[BF_BLOCK_WORDS]) {
+  const uint32_t h = (uint32_t)hash;
+
+  for (unsigned int i = 0; i < BF_BLOCK_WORDS; i++) {
+    mask[i] = 1U << ((h * BF_SALTS[i]) >> 27);
+  }
+}
+
+bloom_filter *bf_init(size_t n, double fpr) {
+  // Find the fewest bits per key, to the half bit, meeting the target
+  double c = 4;
+  while (c < 64 && bf_estimate_fpr(c) > fpr) {
+    c += 0.5;
+  }
+
+  const double bits = c * (double)(n ? n : 1);
+  size_t num_blocks = (size_t)ceil(bits / (BF_BLOCK_WORDS * 32));
+  // Keep whole cache lines, as `aligned_alloc` requires
+  const size_t per_line = BF_CACHE_LINE / sizeof(bf_block);
+  num_blocks = (num_blocks + per_line - 1) / per_line * per_line;
+
+  bloom_filter *bf = malloc(sizeof(bloom_filter));
+  bf->num_blocks = num_blocks;
+  bf->blocks = aligned_alloc(BF_CACHE_LINE, sizeof(bf_block) * num_blocks);
+  memset(bf->blocks, 0, sizeof(bf_block) * num_blocks);
+
+  return bf;
+}
+
+bloom_filter *bf_from_set(hash_set *hs, double fpr) {
+  bloom_filter *bf = bf_init(hs->count, fpr);
+
+  hs_cursor cursor;
+  hs_cursor_init(hs, &cursor);
+
+  const char *key;
+  while ((key = hs_cursor_next(hs, &cursor)) != NULL) {
+    bf_insert(bf, key);
+  }
+
+  return bf;
+}
+
+void bf_insert(bloom_filter *bf, const char *key) {
+  const uint64_t hash = h_hash_64(key);
+  bf_block *block = bf_block_of(bf, hash);
+
+  uint32_t mask[BF_BLOCK_WORDS];
+  bf_mask(hash, mask);
+
+  for (unsigned int i = 0; i < BF_BLOCK_WORDS; i++) {
+    block->words[i] |= mask[i];
+  }
+}
+
+int bf_contains(bloom_filter *bf, const char *key) {
+  const uint64_t hash = h_hash_64(key);
+  const bf_block *block = bf_block_of(bf, hash);
+
+  uint32_t mask[BF_BLOCK_WORDS];
+  bf_mask(hash, mask);
+
+  // Accumulate rather than exit early, keeping the loop branch-free
+  uint32_t missing = 0;
+  for (unsigned int i = 0; i < BF_BLOCK_WORDS; i++) {
+    missing |= mask[i] & ~block->words[i];
+  }
+
+  return missing == 0;
+}
+
+size_t bf_size(bloom_filter *bf) {
+  return sizeof(bf_block) * bf->num_blocks;
+}
+
+void bf_delete_filter(bloom_filter *bf) {
+  free(bf->blocks);
+  free(bf);
+}
@@ -0,0 +1,157 @@
+#include "build.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "parallel.h"
+
+/**
+ * Minimum number of keys for which a build is spread across threads
+ */
+#define BUILD_PARALLEL_MIN 16384
+
+typedef struct {
+  build_partition *bp;
+  const char **keys;
+  size_t n;
+  size_t capacity;
+  unsigned int num_workers;
+  /**
+   * Per-worker partition histograms, laid out [worker][partition]; turned
+   * into per-worker scatter cursors in place
+   */
+  size_t *counts;
+} build_task;
+
+/**
+ * Range of keys owned by a worker during the hashing and scatter phases
+ */
+static void build_key_range(build_task *task, unsigned int worker,
+                            size_t *start, size_t *end) {
+  const unsigned long long n = task->n;
+  *start = (size_t)(n * worker / task->num_workers);
+  *end = (size_t)(n * (worker + 1) / task->num_workers);
+}
+
+/**
+ * Partition which owns a home slot. Partitions are contiguous regions of the
+ * slot array, so each worker's first probes stay within its own region.
+ */
+static unsigned int build_partition_of(build_task *task, size_t home) {
+  return (unsigned int)((unsigned long long)home * task->bp->num_partitions /
+                        task->capacity);
+}
+
+/**
+ * Hashing phase: compute each key's probe sequence and histogram the
+ * partitions its home slot falls in
+ */
+static void build_hash_worker(void *arg, unsigned int worker) {
+  build_task *task = arg;
+  size_t *counts = &task->counts[worker * task->bp->num_partitions];
+  size_t start, end;
+  build_key_range(task, worker, &start, &end);
+
+  for (size_t i = start; i < end; i++) {
+    task->bp->probes[i] = h_probe_init(task->keys[i], task->capacity);
+    counts[build_partition_of(task, task->bp->probes[i].hash_a)]++;
+  }
+}
+
+/**
+ * Scatter phase: write each key index to its slot in the partitioned order
+ */
+static void build_scatter_worker(void *arg, unsigned int worker) {
+  build_task *task = arg;
+  size_t *cursors = &task->counts[worker * task->bp->num_partitions];
+  size_t start, end;
+  build_key_range(task, worker, &start, &end);
+
+  for (size_t i = start; i < end; i++) {
+    const size_t home = task->bp->probes[i].hash_a;
+    task->bp->order[cursors[build_partition_of(task, home)]++] = i;
+  }
+}
+
+/**
+ * Number of slots to allocate for a bulk build of `n` keys: enough that the
+ * table stays within its 70% load threshold and never resizes mid-build.
+ *
+ * @param n
+ * @return size_t
+ */
+size_t build_capacity(size_t n) {
+  return (size_t)((unsigned long long)n * 100 / 70 + 1);
+}
+
+/**
+ * Resolve the number of workers for a bulk build of `n` keys; small builds
+ * run on the calling thread.
+ *
+ * @param n
+ * @param requested See `parallel_num_workers`
+ * @return unsigned int
+ */
+unsigned int build_num_workers(size_t n, unsigned int requested) {
+  if (n < BUILD_PARALLEL_MIN) {
+    return 1;
+  }
+
+  return parallel_num_workers(requested);
+}
+
+/**
+ * Hash every key in parallel, then radix-partition the key indices by the
+ * region of the slot array their home slot falls in. The partitioning is
+ * stable, and identical keys always share a partition, so a worker that
+ * processes its partitions in order sees duplicates in their original order.
+ *
+ * @param bp
+ * @param keys
+ * @param n
+ * @param capacity Slot count of the table being built
+ * @param num_workers
+ */
+void build_partition_keys(build_partition *bp, const char **keys, size_t n,
+                          size_t capacity, unsigned int num_workers) {
+  bp->num_partitions = num_workers;
+  bp->probes = malloc(sizeof(h_probe) * (n ? n : 1));
+  bp->order = malloc(sizeof(size_t) * (n ? n : 1));
+  bp->offsets = malloc(sizeof(size_t) * (bp->num_partitions + 1));
+
+  build_task task = {
+      .bp = bp,
+      .keys = keys,
+      .n = n,
+      .capacity = capacity,
+      .num_workers = num_workers,
+      .counts = calloc((size_t)num_workers * bp->num_partitions,
+                       sizeof(size_t)),
+  };
+
+  parallel_run(num_workers, build_hash_worker, &task);
+
+  // Exclusive prefix sum, partition-major so each partition is contiguous
+  // and, within it, worker w's keys follow those of workers before it
+  size_t offset = 0;
+  for (unsigned int p = 0; p < bp->num_partitions; p++) {
+    bp->offsets[p] = offset;
+    for (unsigned int w = 0; w < num_workers; w++) {
+      const size_t count = task.counts[w * bp->num_partitions + p];
+      task.counts[w * bp->num_partitions + p] = offset;
+      offset += count;
+    }
+  }
+  bp->offsets[bp->num_partitions] = offset;
+
+  parallel_run(num_workers, build_scatter_worker, &task);
+
+  free(task.counts);
+}
+
+void build_partition_free(build_partition *bp) {
+  free(bp->probes);
+  free(bp->order);
+  free(bp->offsets);
+}
@@ -0,0 +1,33 @@
+#ifndef LIBHASH_BUILD_H
+#define LIBHASH_BUILD_H
+
+#include <stddef.h>
+
+#include "hash.h"
+
+typedef struct {
+  /**
+   * Probe sequence of each key; `hash_a` is its home slot (first probe)
+   */
+  h_probe *probes;
+
+  /**
+   * Key indices grouped by partition, in their original relative order
+   */
+  size_t *order;
+
+  /**
+   * Partition `p` spans `order[offsets[p]]` to `order[offsets[p + 1] - 1]`
+   */
+  size_t *offsets;
+
+  unsigned int num_partitions;
+} build_partition;
+
+size_t build_capacity(size_t n);
+unsigned int build_num_workers(size_t n, unsigned int requested);
+void build_partition_keys(build_partition *bp, const char **keys, size_t n,
+                          size_t capacity, unsigned int num_workers);
+void build_partition_free(build_partition *bp);
+
+#endif /* LIBHASH_BUILD_H */
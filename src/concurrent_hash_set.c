@@ -0,0 +1,350 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "prime.h"
+#include "strdup/strdup.h"
+
+/**
+ * Number of slots a thread claims at once when helping migrate keys into a
+ * successor table.
+ */
+#define CHS_COPY_CHUNK 1024
+
+/**
+ * Marks an empty slot that has been retired by a resize. Its address is
+ * unique, so it can never compare equal to a caller-owned key.
+ */
+static char CHS_MOVED_KEY[] = "";
+
+typedef struct chs_table chs_table;
+
+/**
+ * One generation of the set's slot array. Slots only ever transition from
+ * NULL to a key or from NULL to CHS_MOVED_KEY, which is what allows lookups
+ * to run without any coordination.
+ */
+struct chs_table {
+  /**
+   * Number of slots in the table; the first prime subsequent to the base
+   * capacity.
+   */
+  size_t capacity;
+
+  /**
+   * Base capacity (used to calculate the successor's capacity)
+   */
+  size_t base_capacity;
+
+  /**
+   * Number of slots claimed by a key, whether inserted or migrated
+   */
+  atomic_size_t used;
+
+  /**
+   * The table's keys
+   */
+  _Atomic(char *) *keys;
+
+  /**
+   * The successor table, once a resize has been started
+   */
+  _Atomic(chs_table *) next;
+
+  /**
+   * The predecessor table. Retired tables are kept alive until the set is
+   * deleted because readers may still be traversing them.
+   */
+  chs_table *prev;
+
+  /**
+   * Next slot index to be handed out to a migrating thread
+   */
+  atomic_size_t copy_idx;
+
+  /**
+   * Number of slots whose migration has completed
+   */
+  atomic_size_t copy_done;
+};
+
+struct concurrent_hash_set {
+  /**
+   * The oldest table which has not yet been fully migrated
+   */
+  _Atomic(chs_table *) table;
+
+  /**
+   * Number of keys in the set
+   */
+  atomic_size_t count;
+};
+
+static int chs_table_insert(concurrent_hash_set *chs, chs_table *t,
+                            const char *key, bool migrating);
+
+/**
+ * Initialize a new table generation
+ *
+ * @param base_capacity
+ * @param prev
+ * @return chs_table*
+ */
+static chs_table *chs_table_init(size_t base_capacity, chs_table *prev) {
+  chs_table *t = malloc(sizeof(chs_table));
+
+  t->base_capacity = base_capacity;
+  t->capacity = next_prime(base_capacity);
+  atomic_init(&t->used, 0);
+  t->keys = calloc(t->capacity, sizeof(_Atomic(char *)));
+  atomic_init(&t->next, NULL);
+  t->prev = prev;
+  atomic_init(&t->copy_idx, 0);
+  atomic_init(&t->copy_done, 0);
+
+  return t;
+}
+
+/**
+ * Retrieve the successor of the given table, allocating it if no thread has
+ * done so yet. Only one allocation wins the race; the rest are discarded.
+ *
+ * @param t
+ * @return chs_table*
+ */
+static chs_table *chs_start_resize(chs_table *t) {
+  chs_table *next = atomic_load(&t->next);
+  if (next != NULL) {
+    return next;
+  }
+
+  chs_table *new_t = chs_table_init(t->base_capacity * 2, t);
+  if (atomic_compare_exchange_strong(&t->next, &next, new_t)) {
+    return new_t;
+  }
+
+  free(new_t->keys);
+  free(new_t);
+
+  return next;
+}
+
+/**
+ * Advance the set's head past every table whose migration has completed.
+ *
+ * @param chs
+ */
+static void chs_promote(concurrent_hash_set *chs) {
+  chs_table *head = atomic_load(&chs->table);
+
+  while (atomic_load(&head->copy_done) == head->capacity) {
+    chs_table *next = atomic_load(&head->next);
+
+    if (next == NULL || !atomic_compare_exchange_strong(&chs->table, &head,
+                                                        next)) {
+      return;
+    }
+
+    head = next;
+  }
+}
+
+/**
+ * Help migrate the keys of table `t` into its successor. Slots are handed out
+ * in chunks so that any number of threads may cooperate; each empty slot is
+ * retired with CHS_MOVED_KEY, and each key is reinserted into the successor.
+ * Keys stay in place in `t`, so concurrent lookups remain correct throughout.
+ *
+ * @param chs
+ * @param t
+ */
+static void chs_help_migrate(concurrent_hash_set *chs, chs_table *t) {
+  chs_table *next = atomic_load(&t->next);
+
+  for (;;) {
+    const size_t start = atomic_fetch_add(&t->copy_idx, CHS_COPY_CHUNK);
+    if (start >= t->capacity) {
+      return;
+    }
+
+    size_t end = start + CHS_COPY_CHUNK;
+    if (end > t->capacity) {
+      end = t->capacity;
+    }
+
+    for (size_t idx = start; idx < end; idx++) {
+      char *current_key = NULL;
+
+      // A failed CAS reloads `current_key` with the key that won the slot
+      if (atomic_compare_exchange_strong(&t->keys[idx], &current_key,
+                                         CHS_MOVED_KEY)) {
+        continue;
+      }
+
+      chs_table_insert(chs, next, current_key, true);
+    }
+
+    if (atomic_fetch_add(&t->copy_done, end - start) + (end - start) ==
+        t->capacity) {
+      chs_promote(chs);
+    }
+  }
+}
+
+/**
+ * Insert a key into the table `t`, following successor tables as needed.
+ * Because claimed slots are never overwritten, every thread inserting the
+ * same key walks the same probe sequence and meets at the same slot, so
+ * exactly one of them claims it.
+ *
+ * @param chs
+ * @param t
+ * @param key
+ * @param migrating Whether `key` is an already-owned key being migrated
+ * @return 1 if the key was newly claimed, 0 if it already existed
+ */
+static int chs_table_insert(concurrent_hash_set *chs, chs_table *t,
+                            const char *key, bool migrating) {
+  char *new_key = migrating ? (char *)key : NULL;
+
+  for (;;) {
+    // Each table generation has its own capacity, and so its own sequence
+    const h_probe probe = h_probe_init(key, t->capacity);
+
+    for (size_t i = 0; i < t->capacity; i++) {
+      const size_t idx = h_probe_at(probe, t->capacity, i);
+      char *current_key = atomic_load(&t->keys[idx]);
+
+      if (current_key == NULL) {
+        if (new_key == NULL) {
+          new_key = strdup(key);
+        }
+
+        if (atomic_compare_exchange_strong(&t->keys[idx], &current_key,
+                                           new_key)) {
+          const uint64_t load = (uint64_t)(atomic_fetch_add(&t->used, 1) + 1) *
+                                100 / t->capacity;
+          if (load > 70) {
+            chs_start_resize(t);
+          }
+
+          return 1;
+        }
+      }
+
+      if (current_key == CHS_MOVED_KEY) {
+        break;
+      }
+
+      if (strcmp(current_key, key) == 0) {
+        if (!migrating) {
+          free(new_key);
+        }
+
+        return 0;
+      }
+    }
+
+    // Either the slot we needed was retired or the table is full; finish
+    // our share of the migration and retry in the successor.
+    chs_table *next = chs_start_resize(t);
+    chs_help_migrate(chs, t);
+    t = next;
+  }
+}
+
+concurrent_hash_set *chs_init(size_t base_capacity) {
+  if (base_capacity < HS_DEFAULT_CAPACITY) {
+    base_capacity = HS_DEFAULT_CAPACITY;
+  }
+
+  concurrent_hash_set *chs = malloc(sizeof(concurrent_hash_set));
+  atomic_init(&chs->table, chs_table_init(base_capacity, NULL));
+  atomic_init(&chs->count, 0);
+
+  return chs;
+}
+
+int chs_insert(concurrent_hash_set *chs, const char *key) {
+  if (chs == NULL) {
+    return 0;
+  }
+
+  chs_table *t = atomic_load(&chs->table);
+
+  // Lend a hand to any in-flight migration before adding to the load
+  if (atomic_load(&t->next) != NULL) {
+    chs_help_migrate(chs, t);
+    t = atomic_load(&chs->table);
+  }
+
+  if (chs_table_insert(chs, t, key, false)) {
+    atomic_fetch_add(&chs->count, 1);
+    return 1;
+  }
+
+  return 0;
+}
+
+int chs_contains(concurrent_hash_set *chs, const char *key) {
+  chs_table *t = atomic_load(&chs->table);
+
+  while (t != NULL) {
+    const h_probe probe = h_probe_init(key, t->capacity);
+
+    for (size_t i = 0; i < t->capacity; i++) {
+      const size_t idx = h_probe_at(probe, t->capacity, i);
+      char *current_key = atomic_load(&t->keys[idx]);
+
+      if (current_key == NULL) {
+        return 0;
+      }
+
+      if (current_key == CHS_MOVED_KEY) {
+        break;
+      }
+
+      if (strcmp(current_key, key) == 0) {
+        return 1;
+      }
+    }
+
+    t = atomic_load(&t->next);
+  }
+
+  return 0;
+}
+
+size_t chs_count(concurrent_hash_set *chs) {
+  return atomic_load(&chs->count);
+}
+
+void chs_delete_set(concurrent_hash_set *chs) {
+  chs_table *t = atomic_load(&chs->table);
+
+  // Finish any outstanding migration so the newest table owns every key
+  while (atomic_load(&t->next) != NULL) {
+    chs_help_migrate(chs, t);
+    t = atomic_load(&t->next);
+  }
+
+  for (size_t i = 0; i < t->capacity; i++) {
+    char *r = atomic_load(&t->keys[i]);
+
+    if (r != NULL && r != CHS_MOVED_KEY) {
+      free(r);
+    }
+  }
+
+  while (t != NULL) {
+    chs_table *prev = t->prev;
+    free(t->keys);
+    free(t);
+    t = prev;
+  }
+
+  free(chs);
+}
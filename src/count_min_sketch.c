@@ -0,0 +1,219 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "strdup/strdup.h"
+
+/**
+ * Max number of rows; enough for a failure probability of 1e-6
+ */
+#define CMS_MAX_DEPTH 16
+
+struct count_min_sketch {
+  /**
+   * Number of counters in each row; always a power of two
+   */
+  unsigned int width;
+
+  /**
+   * Number of rows, each indexed by an independent hash
+   */
+  unsigned int depth;
+
+  uint64_t *counters;
+
+  /**
+   * Number of heavy hitters tracked
+   */
+  unsigned int k;
+
+  /**
+   * Heavy hitter candidates, of which the first `num_candidates` are in use
+   */
+  hcnt_item *candidates;
+  unsigned int num_candidates;
+
+  /**
+   * Candidate with the lowest estimate; the one a new heavy hitter displaces
+   */
+  unsigned int min_candidate;
+
+  /**
+   * Maps each candidate's key to its index in `candidates` plus one
+   */
+  hash_counter *index;
+};
+
+/**
+ * Resolve the counter of a hash in the given row. Rows are indexed by
+ * combining the two halves of a single 64-bit hash (Kirsch-Mitzenmacher),
+ * which is as good as hashing the key once per row.
+ *
+ * @param cms
+ * @param hash
+ * @param row
+ * @return uint64_t*
+ */
+static uint64_t *cms_counter(count_min_sketch *cms, uint64_t hash,
+                             unsigned int row) {
+  const uint32_t h1 = (uint32_t)hash;
+  const uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+
+  return &cms->counters[(size_t)row * cms->width +
+                        ((h1 + row * h2) & (cms->width - 1))];
+}
+
+static void cms_find_min_candidate(count_min_sketch *cms) {
+  cms->min_candidate = 0;
+
+  for (unsigned int i = 1; i < cms->num_candidates; i++) {
+    if (cms->candidates[i].count <
+        cms->candidates[cms->min_candidate].count) {
+      cms->min_candidate = i;
+    }
+  }
+}
+
+/**
+ * Record the new estimate of a key among the heavy hitter candidates. A key
+ * which is not yet a candidate becomes one if there is room, or if its
+ * estimate exceeds that of the lowest candidate, which it then replaces.
+ *
+ * @param cms
+ * @param key
+ * @param estimate
+ */
+static void cms_track(count_min_sketch *cms, const char *key,
+                      uint64_t estimate) {
+  const uint64_t idx = hcnt_get(cms->index, key);
+
+  if (idx > 0) {
+    cms->candidates[idx - 1].count = estimate;
+
+    // Only the lowest candidate's rise can change which one is lowest
+    if (idx - 1 == cms->min_candidate) {
+      cms_find_min_candidate(cms);
+    }
+
+    return;
+  }
+
+  unsigned int i;
+  if (cms->num_candidates < cms->k) {
+    i = cms->num_candidates++;
+  } else if (estimate > cms->candidates[cms->min_candidate].count) {
+    i = cms->min_candidate;
+    hcnt_remove(cms->index, cms->candidates[i].key);
+    free((char *)cms->candidates[i].key);
+  } else {
+    return;
+  }
+
+  cms->candidates[i].key = strdup(key);
+  cms->candidates[i].count = estimate;
+  hcnt_add(cms->index, key, i + 1);
+  cms_find_min_candidate(cms);
+}
+
+count_min_sketch *cms_init(double epsilon, double delta, unsigned int k) {
+  count_min_sketch *cms = malloc(sizeof(count_min_sketch));
+
+  // Each row overestimates by more than `epsilon` times the total with
+  // probability at most 1/e, so ln(1/delta) rows bring that down to `delta`
+  const double min_width = ceil(exp(1) / epsilon);
+  cms->width = 1;
+  while (cms->width < min_width && cms->width < 1U << 30) {
+    cms->width <<= 1;
+  }
+
+  const double depth = ceil(log(1 / delta));
+  cms->depth = depth < 1 ? 1 : depth > CMS_MAX_DEPTH ? CMS_MAX_DEPTH
+                                                      : (unsigned int)depth;
+
+  cms->counters =
+      calloc((size_t)cms->width * cms->depth, sizeof(uint64_t));
+
+  cms->k = k;
+  cms->candidates = malloc(sizeof(hcnt_item) * (k ? k : 1));
+  cms->num_candidates = 0;
+  cms->min_candidate = 0;
+  cms->index = hcnt_init(k * 2);
+
+  return cms;
+}
+
+uint64_t cms_add(count_min_sketch *cms, const char *key, uint64_t delta) {
+  const uint64_t hash = h_hash_64(key);
+
+  // Conservative update: raise each counter only as far as the new estimate,
+  // since any counter above it already overestimates the key
+  uint64_t estimate = UINT64_MAX;
+  for (unsigned int row = 0; row < cms->depth; row++) {
+    const uint64_t c = *cms_counter(cms, hash, row);
+    if (c < estimate) {
+      estimate = c;
+    }
+  }
+  estimate += delta;
+
+  for (unsigned int row = 0; row < cms->depth; row++) {
+    uint64_t *c = cms_counter(cms, hash, row);
+    if (*c < estimate) {
+      *c = estimate;
+    }
+  }
+
+  if (cms->k > 0) {
+    cms_track(cms, key, estimate);
+  }
+
+  return estimate;
+}
+
+uint64_t cms_estimate(count_min_sketch *cms, const char *key) {
+  const uint64_t hash = h_hash_64(key);
+
+  uint64_t estimate = UINT64_MAX;
+  for (unsigned int row = 0; row < cms->depth; row++) {
+    const uint64_t c = *cms_counter(cms, hash, row);
+    if (c < estimate) {
+      estimate = c;
+    }
+  }
+
+  return estimate;
+}
+
+unsigned int cms_top_k(count_min_sketch *cms, hcnt_item *out) {
+  memcpy(out, cms->candidates, sizeof(hcnt_item) * cms->num_candidates);
+
+  // There are only `k` candidates, so a full sort is cheap
+  for (unsigned int i = 1; i < cms->num_candidates; i++) {
+    const hcnt_item item = out[i];
+
+    unsigned int j = i;
+    while (j > 0 && (out[j - 1].count < item.count ||
+                     (out[j - 1].count == item.count &&
+                      strcmp(out[j - 1].key, item.key) > 0))) {
+      out[j] = out[j - 1];
+      j--;
+    }
+    out[j] = item;
+  }
+
+  return cms->num_candidates;
+}
+
+void cms_delete_sketch(count_min_sketch *cms) {
+  for (unsigned int i = 0; i < cms->num_candidates; i++) {
+    free((char *)cms->candidates[i].key);
+  }
+
+  hcnt_delete_counter(cms->index);
+  free(cms->candidates);
+  free(cms->counters);
+  free(cms);
+}
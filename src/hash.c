@@ -1,7 +1,10 @@
 #include "hash.h"
 
-#include <math.h>    // for pow
+#include <math.h>  // for pow
+#include <stdatomic.h>
+#include <stdio.h>
 #include <string.h>  // for strlen
+#include <time.h>
 
 static const int H_PRIME_1 = 157;
 static const int H_PRIME_2 = 163;
@@ -13,21 +16,93 @@ static const int H_PRIME_2 = 163;
  * @param key
  * @param prime
  * @param capacity
- * @return unsigned int
+ * @return size_t
  */
-static unsigned int h_hash(const char *key, const int prime,
-                           const int capacity) {
-  long hash = 0;
+static size_t h_hash(const char *key, const int prime, const size_t capacity) {
+  int64_t hash = 0;
 
   const size_t len_s = strlen(key);
-  for (unsigned int i = 0; i < len_s; i++) {
+  for (size_t i = 0; i < len_s; i++) {
     // convert the key to a large integer
-    hash += (long)pow(prime, len_s - (i + 1)) * key[i];
+    hash += (int64_t)pow(prime, len_s - (i + 1)) * key[i];
     // reduce said large integer to a fixed range
-    hash = hash % capacity;
+    hash = hash % (int64_t)capacity;
   }
 
-  return (unsigned int)hash;
+  return (size_t)(hash < 0 ? hash + (int64_t)capacity : hash);
+}
+
+/**
+ * Compute `a * b % m` without overflow
+ *
+ * @param a
+ * @param b
+ * @param m
+ * @return uint64_t
+ */
+static uint64_t h_mul_mod(uint64_t a, uint64_t b, uint64_t m) {
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef unsigned __int128 h_uint128;
+  return (uint64_t)((h_uint128)a * b % m);
+#else
+  uint64_t r = 0;
+  a %= m;
+  for (; b > 0; b >>= 1) {
+    if (b & 1) {
+      r = r >= m - a ? r - (m - a) : r + a;
+    }
+    a = a >= m - a ? a - (m - a) : a + a;
+  }
+
+  return r;
+#endif
+}
+
+/**
+ * Compute the two hashes which determine the probe sequence of the given key
+ * in a table of the given capacity. Computing them is the costly part of
+ * probing, so callers which probe a key more than once should compute them
+ * once and resolve each probe with `h_probe_at`.
+ *
+ * @param key
+ * @param capacity
+ * @return h_probe
+ */
+h_probe h_probe_init(const char *key, const size_t capacity) {
+  h_probe probe = {
+      .hash_a = h_hash(key, H_PRIME_1, capacity),
+      .hash_b = h_hash(key, H_PRIME_2, capacity),
+  };
+
+  // Prevent infinite cycling when hash_b == num capacity.
+  if (probe.hash_b % capacity == 0) {
+    probe.hash_b = 1;
+  }
+
+  return probe;
+}
+
+/**
+ * Resolve the index of the given attempt along a probe sequence. Yields the
+ * same indices as `h_compute_hash`.
+ *
+ * The sequence is computed exactly, never wrapping, so that with a prime
+ * capacity it visits every slot before repeating one. Both hashes are below
+ * the capacity, so while the capacity and attempt fit in 32 bits the sum
+ * fits in 64; beyond that, the product is reduced without overflow.
+ *
+ * @param probe
+ * @param capacity
+ * @param attempt
+ * @return size_t
+ */
+size_t h_probe_at(h_probe probe, const size_t capacity, const size_t attempt) {
+  if (capacity <= UINT32_MAX && attempt <= UINT32_MAX) {
+    return (probe.hash_a + attempt * probe.hash_b) % capacity;
+  }
+
+  return (probe.hash_a + h_mul_mod(attempt, probe.hash_b, capacity)) %
+         capacity;
 }
 
 /**
@@ -43,17 +118,261 @@ static unsigned int h_hash(const char *key, const int prime,
  * @param key
  * @param capacity
  * @param attempt Number of attempts made to generate a non-colliding hash.
- * @return unsigned int
+ * @return size_t
  */
-unsigned int h_compute_hash(const char *key, const int capacity,
-                            const int attempt) {
-  const unsigned int hash_a = h_hash(key, H_PRIME_1, capacity);
-  unsigned int hash_b = h_hash(key, H_PRIME_2, capacity);
+size_t h_compute_hash(const char *key, const size_t capacity,
+                      const size_t attempt) {
+  return h_probe_at(h_probe_init(key, capacity), capacity, attempt);
+}
 
-  // Prevent infinite cycling when hash_b == num capacity.
-  if (hash_b % capacity == 0) {
-    hash_b = 1;
+/**
+ * Murmur3's 64-bit finalizer, so that every input bit affects every output
+ * bit. A bijection, so distinct inputs always yield distinct outputs.
+ *
+ * @param hash
+ * @return uint64_t
+ */
+uint64_t h_mix_64(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+
+  return hash;
+}
+
+/**
+ * Hash a given key to a full 64-bit value, independent of any table capacity.
+ * Used wherever keys must be routed or partitioned before a slot is chosen,
+ * so all bits - the high ones in particular - are well mixed.
+ *
+ * @param key
+ * @return uint64_t
+ */
+uint64_t h_hash_64(const char *key) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+    hash ^= *p;
+    hash *= 0x100000001b3ULL;
+  }
+
+  return h_mix_64(hash);
+}
+
+#define H_ROTL_64(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define H_SIP_ROUND(v0, v1, v2, v3) \
+  do {                              \
+    v0 += v1;                       \
+    v1 = H_ROTL_64(v1, 13);         \
+    v1 ^= v0;                       \
+    v0 = H_ROTL_64(v0, 32);         \
+    v2 += v3;                       \
+    v3 = H_ROTL_64(v3, 16);         \
+    v3 ^= v2;                       \
+    v0 += v3;                       \
+    v3 = H_ROTL_64(v3, 21);         \
+    v3 ^= v0;                       \
+    v2 += v1;                       \
+    v1 = H_ROTL_64(v1, 17);         \
+    v1 ^= v2;                       \
+    v2 = H_ROTL_64(v2, 32);         \
+  } while (0)
+
+/**
+ * Hash a given key with SipHash-1-3, keyed with a 128-bit secret. Without the
+ * secret, keys which collide cannot be found any faster than by brute force,
+ * so an adversary choosing the keys cannot force long probe sequences.
+ *
+ * @param key
+ * @param seed The secret key
+ * @return uint64_t
+ */
+uint64_t h_siphash_13(const char *key, const uint64_t seed[2]) {
+  uint64_t v0 = 0x736f6d6570736575ULL ^ seed[0];
+  uint64_t v1 = 0x646f72616e646f6dULL ^ seed[1];
+  uint64_t v2 = 0x6c7967656e657261ULL ^ seed[0];
+  uint64_t v3 = 0x7465646279746573ULL ^ seed[1];
+
+  const unsigned char *p = (const unsigned char *)key;
+  const size_t len = strlen(key);
+  const unsigned char *end = p + (len & ~(size_t)7);
+
+  for (; p != end; p += 8) {
+    uint64_t m = 0;
+    for (unsigned int i = 0; i < 8; i++) {
+      m |= (uint64_t)p[i] << (8 * i);
+    }
+
+    v3 ^= m;
+    H_SIP_ROUND(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+
+  // The final block holds the remaining bytes and, in its top byte, the length
+  uint64_t m = (uint64_t)len << 56;
+  for (unsigned int i = 0; i < (len & 7); i++) {
+    m |= (uint64_t)p[i] << (8 * i);
+  }
+
+  v3 ^= m;
+  H_SIP_ROUND(v0, v1, v2, v3);
+  v0 ^= m;
+
+  v2 ^= 0xff;
+  H_SIP_ROUND(v0, v1, v2, v3);
+  H_SIP_ROUND(v0, v1, v2, v3);
+  H_SIP_ROUND(v0, v1, v2, v3);
+
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * Derive a probe sequence from a full 64-bit hash. The capacity is prime, so
+ * any step between 1 and capacity - 1 visits every slot.
+ *
+ * @param hash
+ * @param capacity
+ * @return h_probe
+ */
+h_probe h_probe_from_64(uint64_t hash, const size_t capacity) {
+  h_probe probe = {
+      .hash_a = (size_t)(hash % capacity),
+      .hash_b = 1,
+  };
+
+  if (capacity > 1) {
+    probe.hash_b += (size_t)((hash >> 32) % (capacity - 1));
+  }
+
+  return probe;
+}
+
+/**
+ * Draw a random 128-bit seed for a keyed hash, from the system's entropy
+ * source where there is one
+ *
+ * @param seed
+ */
+void h_random_seed(uint64_t seed[2]) {
+  static atomic_uint_fast64_t counter = 0;
+
+  FILE *f = fopen("/dev/urandom", "rb");
+  if (f != NULL) {
+    const size_t got = fread(seed, sizeof(uint64_t), 2, f);
+    fclose(f);
+
+    if (got == 2) {
+      return;
+    }
+  }
+
+  // Without an entropy source, fall back to values which at least differ
+  // between tables and between runs
+  const uint64_t n = atomic_fetch_add(&counter, 1);
+  seed[0] = h_mix_64((uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ n);
+  seed[1] = h_mix_64((uint64_t)(uintptr_t)seed ^ (n * 0x9e3779b97f4a7c15ULL));
+}
+
+/**
+ * CRC32C (Castagnoli) remainders of each 4-bit value, for the portable CRC
+ */
+static const uint32_t H_CRC32C_NIBBLES[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3,
+    0x61c69362, 0x7198540d, 0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9,
+    0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75};
+
+// Static, so the dispatcher may take its address without the objects of the
+// shared library having been compiled as position-independent code
+static uint32_t h_crc32c_nibbles(const char *key) {
+  uint32_t crc = 0xffffffff;
+
+  for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+    crc ^= *p;
+    crc = (crc >> 4) ^ H_CRC32C_NIBBLES[crc & 0xf];
+    crc = (crc >> 4) ^ H_CRC32C_NIBBLES[crc & 0xf];
+  }
+
+  return ~crc;
+}
+
+/**
+ * Compute the CRC32C of a key in software, a nibble at a time
+ *
+ * @param key
+ * @return uint32_t
+ */
+uint32_t h_crc32c_portable(const char *key) { return h_crc32c_nibbles(key); }
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+
+#define H_HAVE_CRC32C_SSE42 1
+
+/**
+ * Compute the CRC32C of a key with the SSE4.2 `crc32` instruction, eight
+ * bytes at a time. Only called once the CPU is known to support it.
+ *
+ * @param key
+ * @return uint32_t
+ */
+__attribute__((target("sse4.2"))) static uint32_t h_crc32c_sse42(
+    const char *key) {
+  size_t len = strlen(key);
+  uint64_t crc = 0xffffffff;
+
+  for (; len >= 8; key += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, key, sizeof(word));
+    crc = _mm_crc32_u64(crc, word);
+  }
+
+  uint32_t crc32 = (uint32_t)crc;
+  for (; len > 0; key++, len--) {
+    crc32 = _mm_crc32_u8(crc32, (unsigned char)*key);
+  }
+
+  return ~crc32;
+}
+#endif
+
+typedef uint32_t h_crc32c_fn(const char *key);
+
+/**
+ * Pick the fastest CRC32C implementation the CPU supports
+ *
+ * @return h_crc32c_fn*
+ */
+static h_crc32c_fn *h_crc32c_resolve(void) {
+#ifdef H_HAVE_CRC32C_SSE42
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    return h_crc32c_sse42;
+  }
+#endif
+
+  return h_crc32c_nibbles;
+}
+
+/**
+ * Compute the CRC32C of a key, in hardware where the CPU supports it. The
+ * implementation is resolved on first use; every implementation yields the
+ * same value.
+ *
+ * @param key
+ * @return uint32_t
+ */
+uint32_t h_crc32c(const char *key) {
+  static _Atomic(h_crc32c_fn *) impl = NULL;
+
+  h_crc32c_fn *fn = atomic_load_explicit(&impl, memory_order_relaxed);
+  if (fn == NULL) {
+    // Racing threads resolve the same function, so the race is benign
+    fn = h_crc32c_resolve();
+    atomic_store_explicit(&impl, fn, memory_order_relaxed);
   }
 
-  return (hash_a + (attempt * hash_b)) % capacity;
+  return fn(key);
 }
@@ -1,7 +1,30 @@
 #ifndef LIBHASH_HASH_H
 #define LIBHASH_HASH_H
 
-unsigned int h_compute_hash(const char *key, const int capacity,
-                            const int attempt);
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The two hashes which together determine a key's probe sequence
+ */
+typedef struct {
+  size_t hash_a;
+  size_t hash_b;
+} h_probe;
+
+size_t h_compute_hash(const char *key, const size_t capacity,
+                      const size_t attempt);
+h_probe h_probe_init(const char *key, const size_t capacity);
+size_t h_probe_at(h_probe probe, const size_t capacity, const size_t attempt);
+
+uint64_t h_mix_64(uint64_t hash);
+uint64_t h_hash_64(const char *key);
+
+uint64_t h_siphash_13(const char *key, const uint64_t seed[2]);
+h_probe h_probe_from_64(uint64_t hash, const size_t capacity);
+void h_random_seed(uint64_t seed[2]);
+
+uint32_t h_crc32c(const char *key);
+uint32_t h_crc32c_portable(const char *key);
 
 #endif /* LIBHASH_HASH_H */
@@ -0,0 +1,390 @@
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "prime.h"
+#include "strdup/strdup.h"
+
+/**
+ * Marks the absence of a node, both in links and in the index
+ */
+#define HC_NIL UINT_MAX
+
+/**
+ * Marks an index slot whose node has been removed, so that probing continues
+ * past it
+ */
+#define HC_DELETED (UINT_MAX - 1)
+
+/**
+ * Max number of entries, so that every node's number stays below the markers
+ */
+#define HC_MAX_CAPACITY HC_DELETED
+
+/**
+ * Max percentage of index slots which may be claimed by nodes and deleted
+ * slots together before the index is rebuilt
+ */
+#define HC_MAX_INDEX_LOAD 70
+
+typedef struct {
+  /**
+   * The cached entry; its key is NULL while the node is unused
+   */
+  ht_entry entry;
+
+  /**
+   * Neighbours in the recency list (HC_LRU), or the next free node
+   */
+  unsigned int prev;
+  unsigned int next;
+
+  /**
+   * Index slot which refers to this node
+   */
+  size_t slot;
+
+  /**
+   * Set on access (HC_CLOCK)
+   */
+  atomic_bool referenced;
+} hc_node;
+
+struct hash_cache {
+  hc_policy policy;
+
+  /**
+   * Max number of entries; every node is allocated up front
+   */
+  size_t capacity;
+
+  /**
+   * Number of entries in the cache
+   */
+  size_t count;
+
+  hc_node *nodes;
+
+  /**
+   * Head of the list of unused nodes
+   */
+  unsigned int free_head;
+
+  /**
+   * Most and least recently used nodes (HC_LRU)
+   */
+  unsigned int head;
+  unsigned int tail;
+
+  /**
+   * Next node considered for eviction (HC_CLOCK)
+   */
+  unsigned int hand;
+
+  /**
+   * Open-addressed index from keys to nodes
+   */
+  unsigned int *slots;
+  size_t index_capacity;
+
+  /**
+   * Number of HC_DELETED index slots
+   */
+  size_t deleted;
+
+  free_fn *free_value;
+};
+
+/**
+ * Find the node holding the given key
+ *
+ * @param hc
+ * @param key
+ * @return unsigned int The node, or HC_NIL
+ */
+static unsigned int hc_find(hash_cache *hc, const char *key) {
+  const h_probe probe = h_probe_init(key, hc->index_capacity);
+
+  for (size_t i = 0; i < hc->index_capacity; i++) {
+    const unsigned int n = hc->slots[h_probe_at(probe, hc->index_capacity, i)];
+
+    if (n == HC_NIL) {
+      return HC_NIL;
+    }
+
+    if (n != HC_DELETED && strcmp(hc->nodes[n].entry.key, key) == 0) {
+      return n;
+    }
+  }
+
+  return HC_NIL;
+}
+
+/**
+ * Point the first free index slot along the key's probe sequence at node
+ * `n`. The key must not already be indexed.
+ *
+ * @param hc
+ * @param n
+ */
+static void hc_index(hash_cache *hc, unsigned int n) {
+  const char *key = hc->nodes[n].entry.key;
+
+  const h_probe probe = h_probe_init(key, hc->index_capacity);
+
+  size_t i = 0;
+  size_t idx = h_probe_at(probe, hc->index_capacity, i);
+  while (hc->slots[idx] != HC_NIL && hc->slots[idx] != HC_DELETED) {
+    idx = h_probe_at(probe, hc->index_capacity, ++i);
+  }
+
+  if (hc->slots[idx] == HC_DELETED) {
+    hc->deleted--;
+  }
+
+  hc->slots[idx] = n;
+  hc->nodes[n].slot = idx;
+}
+
+/**
+ * Rebuild the index from scratch, clearing every deleted slot
+ *
+ * @param hc
+ */
+static void hc_reindex(hash_cache *hc) {
+  for (size_t i = 0; i < hc->index_capacity; i++) {
+    hc->slots[i] = HC_NIL;
+  }
+  hc->deleted = 0;
+
+  for (unsigned int n = 0; n < hc->capacity; n++) {
+    if (hc->nodes[n].entry.key != NULL) {
+      hc_index(hc, n);
+    }
+  }
+}
+
+static void hc_unlink(hash_cache *hc, unsigned int n) {
+  hc_node *node = &hc->nodes[n];
+
+  if (node->prev != HC_NIL) {
+    hc->nodes[node->prev].next = node->next;
+  } else {
+    hc->head = node->next;
+  }
+
+  if (node->next != HC_NIL) {
+    hc->nodes[node->next].prev = node->prev;
+  } else {
+    hc->tail = node->prev;
+  }
+}
+
+static void hc_link_head(hash_cache *hc, unsigned int n) {
+  hc_node *node = &hc->nodes[n];
+
+  node->prev = HC_NIL;
+  node->next = hc->head;
+
+  if (hc->head != HC_NIL) {
+    hc->nodes[hc->head].prev = n;
+  } else {
+    hc->tail = n;
+  }
+
+  hc->head = n;
+}
+
+/**
+ * Record an access to node `n`. Under HC_CLOCK this is a single flag store,
+ * and only if the flag is not already set.
+ *
+ * @param hc
+ * @param n
+ */
+static void hc_touch(hash_cache *hc, unsigned int n) {
+  hc_node *node = &hc->nodes[n];
+
+  if (hc->policy == HC_CLOCK) {
+    if (!atomic_load_explicit(&node->referenced, memory_order_relaxed)) {
+      atomic_store_explicit(&node->referenced, true, memory_order_relaxed);
+    }
+  } else if (hc->head != n) {
+    hc_unlink(hc, n);
+    hc_link_head(hc, n);
+  }
+}
+
+/**
+ * Remove node `n` from the cache, hand its value to `free_value` and return
+ * the node to the free list
+ *
+ * @param hc
+ * @param n
+ */
+static void hc_remove(hash_cache *hc, unsigned int n) {
+  hc_node *node = &hc->nodes[n];
+
+  hc->slots[node->slot] = HC_DELETED;
+  hc->deleted++;
+
+  if (hc->policy == HC_LRU) {
+    hc_unlink(hc, n);
+  }
+
+  if (hc->free_value != NULL) {
+    hc->free_value(node->entry.value);
+  }
+  free(node->entry.key);
+  node->entry.key = NULL;
+  node->entry.value = NULL;
+
+  node->next = hc->free_head;
+  hc->free_head = n;
+  hc->count--;
+}
+
+/**
+ * Select the node to evict: the least recently used (HC_LRU), or the first
+ * node the clock hand reaches which has not been accessed since the hand last
+ * passed it (HC_CLOCK)
+ *
+ * @param hc
+ * @return unsigned int
+ */
+static unsigned int hc_victim(hash_cache *hc) {
+  if (hc->policy == HC_LRU) {
+    return hc->tail;
+  }
+
+  // Every node is in use whenever we evict, so the hand never meets a gap
+  for (;;) {
+    const unsigned int n = hc->hand;
+    hc->hand = (hc->hand + 1) % hc->capacity;
+
+    if (!atomic_exchange_explicit(&hc->nodes[n].referenced, false,
+                                  memory_order_relaxed)) {
+      return n;
+    }
+  }
+}
+
+hash_cache *hc_init(size_t capacity, hc_policy policy, free_fn *free_value) {
+  if (capacity == 0) {
+    capacity = 1;
+  } else if (capacity > HC_MAX_CAPACITY) {
+    capacity = HC_MAX_CAPACITY;
+  }
+
+  hash_cache *hc = malloc(sizeof(hash_cache));
+  hc->policy = policy;
+  hc->capacity = capacity;
+  hc->count = 0;
+  hc->free_value = free_value;
+  hc->head = HC_NIL;
+  hc->tail = HC_NIL;
+  hc->hand = 0;
+
+  hc->nodes = malloc(sizeof(hc_node) * capacity);
+  for (unsigned int n = 0; n < capacity; n++) {
+    hc->nodes[n].entry.key = NULL;
+    hc->nodes[n].entry.value = NULL;
+    hc->nodes[n].next = n + 1 < capacity ? n + 1 : HC_NIL;
+    atomic_init(&hc->nodes[n].referenced, false);
+  }
+  hc->free_head = 0;
+
+  // Keep the index at most half full with every node in use
+  hc->index_capacity = next_prime(capacity * 2);
+  hc->slots = malloc(sizeof(unsigned int) * hc->index_capacity);
+  hc_reindex(hc);
+
+  return hc;
+}
+
+void *hc_get(hash_cache *hc, const char *key) {
+  const unsigned int n = hc_find(hc, key);
+
+  if (n == HC_NIL) {
+    return NULL;
+  }
+
+  hc_touch(hc, n);
+
+  return hc->nodes[n].entry.value;
+}
+
+void hc_put(hash_cache *hc, const char *key, void *value) {
+  unsigned int n = hc_find(hc, key);
+
+  if (n != HC_NIL) {
+    hc_node *node = &hc->nodes[n];
+
+    if (hc->free_value != NULL && node->entry.value != value) {
+      hc->free_value(node->entry.value);
+    }
+    node->entry.value = value;
+    hc_touch(hc, n);
+
+    return;
+  }
+
+  if (hc->free_head == HC_NIL) {
+    hc_remove(hc, hc_victim(hc));
+  }
+
+  if ((uint64_t)(hc->count + 1 + hc->deleted) * 100 / hc->index_capacity >
+      HC_MAX_INDEX_LOAD) {
+    hc_reindex(hc);
+  }
+
+  n = hc->free_head;
+  hc_node *node = &hc->nodes[n];
+  hc->free_head = node->next;
+
+  node->entry.key = strdup(key);
+  node->entry.value = value;
+  atomic_store_explicit(&node->referenced, false, memory_order_relaxed);
+
+  hc_index(hc, n);
+  if (hc->policy == HC_LRU) {
+    hc_link_head(hc, n);
+  }
+
+  hc->count++;
+}
+
+int hc_delete(hash_cache *hc, const char *key) {
+  const unsigned int n = hc_find(hc, key);
+
+  if (n == HC_NIL) {
+    return 0;
+  }
+
+  hc_remove(hc, n);
+
+  return 1;
+}
+
+size_t hc_count(hash_cache *hc) { return hc->count; }
+
+void hc_delete_cache(hash_cache *hc) {
+  for (unsigned int n = 0; n < hc->capacity; n++) {
+    hc_node *node = &hc->nodes[n];
+
+    if (node->entry.key != NULL) {
+      if (hc->free_value != NULL) {
+        hc->free_value(node->entry.value);
+      }
+      free(node->entry.key);
+    }
+  }
+
+  free(hc->slots);
+  free(hc->nodes);
+  free(hc);
+}
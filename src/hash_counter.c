@@ -0,0 +1,509 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "prime.h"
+#include "strdup/strdup.h"
+
+/**
+ * Marks a slot whose key has been removed, so that probing continues past
+ * it. Its address is unique, so it can never compare equal to a real key.
+ */
+static char HCNT_DELETED_KEY[] = "";
+
+/**
+ * Max percentage of slots which may be claimed by keys and deleted slots
+ * together before the counter is rehashed
+ */
+#define HCNT_MAX_LOAD 70
+
+/**
+ * A counter slot. The count lives in the slot itself, so counting a key which
+ * is already present never allocates, and the key's full hash is kept
+ * alongside so that probes only compare keys whose hashes match and resizing
+ * never rehashes a key.
+ */
+typedef struct {
+  char *key;
+  uint64_t hash;
+  uint64_t count;
+} hcnt_slot;
+
+struct hash_counter {
+  /**
+   * Number of slots; always prime
+   */
+  size_t capacity;
+
+  /**
+   * Number of distinct keys
+   */
+  size_t count;
+
+  /**
+   * Number of HCNT_DELETED_KEY slots
+   */
+  size_t deleted;
+
+  /**
+   * Sum of every key's count
+   */
+  uint64_t total;
+
+  hcnt_slot *slots;
+};
+
+typedef struct {
+  _Atomic(char *) key;
+  atomic_uint_least64_t count;
+} chcnt_slot;
+
+struct concurrent_hash_counter {
+  /**
+   * Number of slots; fixed, since slots are never moved
+   */
+  size_t capacity;
+
+  /**
+   * Max number of distinct keys
+   */
+  unsigned int max_keys;
+
+  /**
+   * Number of keys which hold a slot
+   */
+  atomic_uint count;
+
+  /**
+   * Number of keys which hold a slot or are about to claim one. Threads
+   * counting the same new key each reserve room for it, and all but the one
+   * claiming its slot hand the room back.
+   */
+  atomic_uint reserved;
+
+  chcnt_slot *slots;
+};
+
+/**
+ * Find the slot holding the given key
+ *
+ * @param hcnt
+ * @param key
+ * @param hash
+ * @return hcnt_slot* The slot, or NULL if the key is not counted
+ */
+static hcnt_slot *hcnt_find(hash_counter *hcnt, const char *key,
+                            uint64_t hash) {
+  // Both the start and the stride of the probe sequence are derived from the
+  // one 64-bit hash
+  const h_probe probe = h_probe_from_64(hash, hcnt->capacity);
+
+  for (size_t i = 0; i < hcnt->capacity; i++) {
+    hcnt_slot *slot = &hcnt->slots[h_probe_at(probe, hcnt->capacity, i)];
+
+    if (slot->key == NULL) {
+      return NULL;
+    }
+
+    if (slot->key != HCNT_DELETED_KEY && slot->hash == hash &&
+        strcmp(slot->key, key) == 0) {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Move every key into a new slot array of the given base capacity, clearing
+ * every deleted slot. Keys are moved along with their stored hashes, so none
+ * is rehashed.
+ *
+ * @param hcnt
+ * @param base_capacity
+ */
+static void hcnt_resize(hash_counter *hcnt, size_t base_capacity) {
+  hcnt_slot *old_slots = hcnt->slots;
+  const size_t old_capacity = hcnt->capacity;
+
+  hcnt->capacity = next_prime(base_capacity);
+  hcnt->slots = calloc(hcnt->capacity, sizeof(hcnt_slot));
+  hcnt->deleted = 0;
+
+  for (size_t j = 0; j < old_capacity; j++) {
+    const hcnt_slot *old = &old_slots[j];
+    if (old->key == NULL || old->key == HCNT_DELETED_KEY) {
+      continue;
+    }
+
+    const h_probe probe = h_probe_from_64(old->hash, hcnt->capacity);
+    size_t i = 0;
+    size_t idx = h_probe_at(probe, hcnt->capacity, i);
+    while (hcnt->slots[idx].key != NULL) {
+      idx = h_probe_at(probe, hcnt->capacity, ++i);
+    }
+
+    hcnt->slots[idx] = *old;
+  }
+
+  free(old_slots);
+}
+
+/**
+ * Order two items by descending count, and by key on a tie, so that the
+ * ranking of equal counts is deterministic
+ *
+ * @param a
+ * @param b
+ * @return int Whether `a` ranks below `b`
+ */
+static int hcnt_item_below(const hcnt_item *a, const hcnt_item *b) {
+  if (a->count != b->count) {
+    return a->count < b->count;
+  }
+
+  return strcmp(a->key, b->key) > 0;
+}
+
+static void hcnt_sift_down(hcnt_item *heap, unsigned int size,
+                           unsigned int i) {
+  for (;;) {
+    unsigned int lowest = i;
+    const unsigned int l = 2 * i + 1;
+    const unsigned int r = 2 * i + 2;
+
+    if (l < size && hcnt_item_below(&heap[l], &heap[lowest])) {
+      lowest = l;
+    }
+    if (r < size && hcnt_item_below(&heap[r], &heap[lowest])) {
+      lowest = r;
+    }
+    if (lowest == i) {
+      return;
+    }
+
+    const hcnt_item tmp = heap[i];
+    heap[i] = heap[lowest];
+    heap[lowest] = tmp;
+    i = lowest;
+  }
+}
+
+/**
+ * Offer an item to a min-heap of the `k` highest ranked items seen so far.
+ * Once the heap is full, an item only enters it by displacing the lowest
+ * ranked item, so selecting the top `k` of `n` items costs O(n log k) rather
+ * than the O(n log n) of a full sort.
+ *
+ * @param heap
+ * @param size Number of items in the heap
+ * @param k
+ * @param key
+ * @param count
+ */
+static void hcnt_offer(hcnt_item *heap, unsigned int *size, unsigned int k,
+                       const char *key, uint64_t count) {
+  const hcnt_item item = {.key = key, .count = count};
+
+  if (*size < k) {
+    // Sift up
+    unsigned int i = (*size)++;
+    while (i > 0 && hcnt_item_below(&item, &heap[(i - 1) / 2])) {
+      heap[i] = heap[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+    heap[i] = item;
+  } else if (k > 0 && hcnt_item_below(&heap[0], &item)) {
+    heap[0] = item;
+    hcnt_sift_down(heap, *size, 0);
+  }
+}
+
+/**
+ * Sort a min-heap in place into descending rank, by repeatedly moving its
+ * lowest ranked item to the end
+ *
+ * @param heap
+ * @param size
+ */
+static void hcnt_sort_heap(hcnt_item *heap, unsigned int size) {
+  while (size > 1) {
+    size--;
+
+    const hcnt_item tmp = heap[0];
+    heap[0] = heap[size];
+    heap[size] = tmp;
+    hcnt_sift_down(heap, size, 0);
+  }
+}
+
+hash_counter *hcnt_init(size_t base_capacity) {
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  hash_counter *hcnt = malloc(sizeof(hash_counter));
+  hcnt->capacity = next_prime(base_capacity);
+  hcnt->count = 0;
+  hcnt->deleted = 0;
+  hcnt->total = 0;
+  hcnt->slots = calloc(hcnt->capacity, sizeof(hcnt_slot));
+
+  return hcnt;
+}
+
+uint64_t hcnt_add(hash_counter *hcnt, const char *key, uint64_t delta) {
+  const uint64_t hash = h_hash_64(key);
+  hcnt->total += delta;
+
+  hcnt_slot *slot = hcnt_find(hcnt, key, hash);
+  if (slot != NULL) {
+    slot->count += delta;
+    return slot->count;
+  }
+
+  if ((uint64_t)(hcnt->count + 1 + hcnt->deleted) * 100 / hcnt->capacity >
+      HCNT_MAX_LOAD) {
+    // Grow only if keys, rather than deleted slots, are what fill the array
+    hcnt_resize(hcnt, hcnt->count * 2 > hcnt->capacity ? hcnt->capacity * 2
+                                                         : hcnt->capacity);
+  }
+
+  // Reuse the first deleted slot along the probe sequence
+  const h_probe probe = h_probe_from_64(hash, hcnt->capacity);
+  size_t i = 0;
+  slot = &hcnt->slots[h_probe_at(probe, hcnt->capacity, i)];
+  while (slot->key != NULL && slot->key != HCNT_DELETED_KEY) {
+    slot = &hcnt->slots[h_probe_at(probe, hcnt->capacity, ++i)];
+  }
+
+  if (slot->key == HCNT_DELETED_KEY) {
+    hcnt->deleted--;
+  }
+
+  slot->key = strdup(key);
+  slot->hash = hash;
+  slot->count = delta;
+  hcnt->count++;
+
+  return delta;
+}
+
+uint64_t hcnt_get(hash_counter *hcnt, const char *key) {
+  const hcnt_slot *slot = hcnt_find(hcnt, key, h_hash_64(key));
+
+  return slot != NULL ? slot->count : 0;
+}
+
+uint64_t hcnt_remove(hash_counter *hcnt, const char *key) {
+  hcnt_slot *slot = hcnt_find(hcnt, key, h_hash_64(key));
+
+  if (slot == NULL) {
+    return 0;
+  }
+
+  const uint64_t count = slot->count;
+  free(slot->key);
+  slot->key = HCNT_DELETED_KEY;
+  hcnt->total -= count;
+  hcnt->count--;
+  hcnt->deleted++;
+
+  return count;
+}
+
+size_t hcnt_count(hash_counter *hcnt) { return hcnt->count; }
+
+uint64_t hcnt_total(hash_counter *hcnt) { return hcnt->total; }
+
+unsigned int hcnt_top_k(hash_counter *hcnt, unsigned int k, hcnt_item *out) {
+  unsigned int size = 0;
+
+  for (size_t i = 0; i < hcnt->capacity; i++) {
+    const hcnt_slot *slot = &hcnt->slots[i];
+
+    if (slot->key != NULL && slot->key != HCNT_DELETED_KEY) {
+      hcnt_offer(out, &size, k, slot->key, slot->count);
+    }
+  }
+
+  hcnt_sort_heap(out, size);
+
+  return size;
+}
+
+void hcnt_delete_counter(hash_counter *hcnt) {
+  for (size_t i = 0; i < hcnt->capacity; i++) {
+    if (hcnt->slots[i].key != HCNT_DELETED_KEY) {
+      free(hcnt->slots[i].key);
+    }
+  }
+
+  free(hcnt->slots);
+  free(hcnt);
+}
+
+concurrent_hash_counter *chcnt_init(unsigned int max_keys) {
+  if (max_keys == 0) {
+    max_keys = 1;
+  }
+
+  concurrent_hash_counter *chcnt = malloc(sizeof(concurrent_hash_counter));
+  chcnt->max_keys = max_keys;
+  // Keep the slot array at most half full
+  chcnt->capacity = next_prime((size_t)max_keys * 2);
+  atomic_init(&chcnt->count, 0);
+  atomic_init(&chcnt->reserved, 0);
+
+  chcnt->slots = malloc(sizeof(chcnt_slot) * chcnt->capacity);
+  for (size_t i = 0; i < chcnt->capacity; i++) {
+    atomic_init(&chcnt->slots[i].key, NULL);
+    atomic_init(&chcnt->slots[i].count, 0);
+  }
+
+  return chcnt;
+}
+
+/**
+ * Reserve room for a new key. Room reserved for a key another thread claims
+ * first is handed back, so a counter which looks full while reservations are
+ * outstanding may yet have room; it is only refused once the keys which hold
+ * slots fill it.
+ *
+ * @param chcnt
+ * @return bool
+ */
+static bool chcnt_reserve(concurrent_hash_counter *chcnt) {
+  for (;;) {
+    if (atomic_fetch_add(&chcnt->reserved, 1) < chcnt->max_keys) {
+      return true;
+    }
+    atomic_fetch_sub(&chcnt->reserved, 1);
+
+    if (atomic_load(&chcnt->count) >= chcnt->max_keys) {
+      return false;
+    }
+  }
+}
+
+/**
+ * Find the slot holding the given key, claiming a free one for it if it is
+ * absent. Claimed slots are never released, so every thread counting the
+ * same key walks the same probe sequence and meets at the same slot.
+ *
+ * @param chcnt
+ * @param key
+ * @param claim Whether to claim a slot for an absent key
+ * @return chcnt_slot* The slot, or NULL if the key is absent and either
+ * `claim` is unset or the counter is full
+ */
+static chcnt_slot *chcnt_find(concurrent_hash_counter *chcnt, const char *key,
+                              bool claim) {
+  const uint64_t hash = h_hash_64(key);
+  char *new_key = NULL;
+
+  const h_probe probe = h_probe_from_64(hash, chcnt->capacity);
+
+  for (size_t i = 0; i < chcnt->capacity; i++) {
+    chcnt_slot *slot = &chcnt->slots[h_probe_at(probe, chcnt->capacity, i)];
+    char *current_key = atomic_load(&slot->key);
+
+    if (current_key == NULL) {
+      if (!claim) {
+        return NULL;
+      }
+
+      // Reserve room for the key before claiming its slot
+      if (new_key == NULL && chcnt_reserve(chcnt)) {
+        new_key = strdup(key);
+      }
+
+      if (new_key == NULL) {
+        // Full, but the key itself may have claimed the slot since it was
+        // loaded, and filled the counter in doing so
+        current_key = atomic_load(&slot->key);
+        if (current_key == NULL) {
+          return NULL;
+        }
+      } else if (atomic_compare_exchange_strong(&slot->key, &current_key,
+                                                new_key)) {
+        atomic_fetch_add(&chcnt->count, 1);
+        return slot;
+      }
+
+      // Either way `current_key` now holds the key that won the slot
+    }
+
+    if (strcmp(current_key, key) == 0) {
+      if (new_key != NULL) {
+        free(new_key);
+        atomic_fetch_sub(&chcnt->reserved, 1);
+      }
+
+      return slot;
+    }
+  }
+
+  if (new_key != NULL) {
+    free(new_key);
+    atomic_fetch_sub(&chcnt->reserved, 1);
+  }
+
+  return NULL;
+}
+
+int chcnt_add(concurrent_hash_counter *chcnt, const char *key,
+              uint64_t delta) {
+  chcnt_slot *slot = chcnt_find(chcnt, key, true);
+
+  if (slot == NULL) {
+    return 0;
+  }
+
+  atomic_fetch_add_explicit(&slot->count, delta, memory_order_relaxed);
+
+  return 1;
+}
+
+uint64_t chcnt_get(concurrent_hash_counter *chcnt, const char *key) {
+  chcnt_slot *slot = chcnt_find(chcnt, key, false);
+
+  return slot != NULL
+             ? atomic_load_explicit(&slot->count, memory_order_relaxed)
+             : 0;
+}
+
+unsigned int chcnt_count(concurrent_hash_counter *chcnt) {
+  return atomic_load(&chcnt->count);
+}
+
+unsigned int chcnt_top_k(concurrent_hash_counter *chcnt, unsigned int k,
+                         hcnt_item *out) {
+  unsigned int size = 0;
+
+  for (size_t i = 0; i < chcnt->capacity; i++) {
+    const char *key = atomic_load(&chcnt->slots[i].key);
+
+    if (key != NULL) {
+      hcnt_offer(out, &size, k, key,
+                 atomic_load_explicit(&chcnt->slots[i].count,
+                                      memory_order_relaxed));
+    }
+  }
+
+  hcnt_sort_heap(out, size);
+
+  return size;
+}
+
+void chcnt_delete_counter(concurrent_hash_counter *chcnt) {
+  for (size_t i = 0; i < chcnt->capacity; i++) {
+    free(atomic_load(&chcnt->slots[i].key));
+  }
+
+  free(chcnt->slots);
+  free(chcnt);
+}
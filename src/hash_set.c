@@ -1,50 +1,155 @@
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "build.h"
 #include "hash.h"
 #include "libhash.h"
+#include "parallel.h"
+#include "perfect_hash.h"
 #include "prime.h"
+#include "small.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "strdup/strdup.h"
 
+/**
+ * Placeholder left in the slot of a deleted key so that probing continues
+ * past it to any keys which collided with it. Its address is unique, so it
+ * can never compare equal to a stored key.
+ */
+static char HS_SENTINEL_KEY[] = "";
+
+/**
+ * Cursor position marking a completed scan
+ */
+#define HS_CURSOR_DONE SIZE_MAX
+
+/**
+ * Slot index marking a key which could not be found
+ */
+#define HS_NOT_FOUND SIZE_MAX
+
+/**
+ * Number of keys whose probes are issued together by the set operations, so
+ * that the memory accesses of one batch overlap rather than stall one by one
+ */
+#define HS_PROBE_BATCH 16
+
+/**
+ * Number of slots a worker claims at once in a parallel set operation
+ */
+#define HS_SET_OP_CHUNK 4096
+
+#if defined(__GNUC__)
+#define HS_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HS_PREFETCH(addr)
+#endif
+
+struct frozen_hash_set {
+  perfect_hash ph;
+
+  /**
+   * Each key, stored in the slot its perfect hash resolves to
+   */
+  char **keys;
+};
+
+/**
+ * Determine whether the set is in the small layout. Hashed slot arrays are
+ * always a prime number of slots, so their sizes cannot be mistaken for it.
+ *
+ * @param hs
+ * @return bool
+ */
+static bool hs_is_small(const hash_set *hs) {
+  return hs->capacity == HT_SMALL_CAPACITY;
+}
+
 /**
  * Resize the hash set. This implementation has a set capacity;
  * hash collisions rise beyond the capacity and `hs_insert` will fail.
  * To mitigate this, we resize up if the load (measured as the ratio of keys
  * count to capacity) is less than .1, or down if the load exceeds .7. To
- * resize, we create a new set approx. 1/2x or 2x times the current set
- * size, then insert into it all non-deleted keys.
+ * resize, we allocate a new slot array approx. 1/2x or 2x times the current
+ * set size, then move into it all non-deleted keys. Keys are moved rather
+ * than copied, so a key stays valid for as long as it remains in the set.
+ * The small layout holds no deleted slots, so it is moved out of the same way.
  *
  * @param hs
  * @param base_capacity
  * @return int
  */
-static void hs_resize(hash_set *hs, const int base_capacity) {
-  if (base_capacity < 0) {
-    return;
+static void hs_resize(hash_set *hs, size_t base_capacity) {
+  if (!base_capacity) {
+    base_capacity = HS_DEFAULT_CAPACITY;
   }
 
-  hash_set *new_hs = hs_init(base_capacity);
+  const uint64_t started = STATS_NOW();
+  const size_t new_capacity = next_prime(base_capacity);
+  const size_t old_capacity = hs->capacity;
+  char **new_keys = calloc(new_capacity, sizeof(char *));
+  STATS_ALLOC(hs->counters, sizeof(char *) * new_capacity);
 
-  for (unsigned int i = 0; i < hs->capacity; i++) {
-    const char *r = hs->keys[i];
+  for (size_t i = 0; i < hs->capacity; i++) {
+    char *r = hs->keys[i];
 
-    if (r != NULL) {
-      hs_insert(new_hs, r);
+    if (r == NULL || r == HS_SENTINEL_KEY) {
+      continue;
     }
+
+    // Keys are distinct and the new array holds no deleted slots, so the
+    // first empty slot along the probe sequence is the key's home
+    const h_probe probe = h_probe_init(r, new_capacity);
+    size_t attempt = 0;
+    size_t idx = h_probe_at(probe, new_capacity, attempt);
+    while (new_keys[idx] != NULL) {
+      idx = h_probe_at(probe, new_capacity, ++attempt);
+    }
+
+    new_keys[idx] = r;
   }
 
-  hs->base_capacity = new_hs->base_capacity;
-  hs->count = new_hs->count;
+  // A set in the small layout has moved to the hashed one
+  hs->small_tags = 0;
+  hs->small_used = 0;
 
-  const unsigned int tmp_capacity = hs->capacity;
-  hs->capacity = new_hs->capacity;
-  new_hs->capacity = tmp_capacity;
+  free(hs->keys);
+  hs->keys = new_keys;
+  hs->base_capacity = base_capacity;
+  hs->capacity = new_capacity;
+  hs->deleted = 0;
+  // A rehash at the same size leaves cursors where they are; see `ht_cursor`
+  if (new_capacity != old_capacity) {
+    hs->generation++;
+  }
+  STATS_RESIZED(hs->counters, started);
+}
 
-  char **tmp_keys = hs->keys;
-  hs->keys = new_hs->keys;
-  new_hs->keys = tmp_keys;
+/**
+ * Compute the set's load as a percentage of its capacity. The product is
+ * taken in 64 bits, so it cannot overflow however many keys are stored.
+ *
+ * @param hs
+ * @return unsigned int
+ */
+static unsigned int hs_load(const hash_set *hs) {
+  return (unsigned int)((uint64_t)hs->count * 100 / hs->capacity);
+}
 
-  hs_delete_set(new_hs);
+/**
+ * Compute the share of the set's slots, as a percentage, which probes must
+ * pass over: those holding keys and those left deleted
+ *
+ * @param hs
+ * @return unsigned int
+ */
+static unsigned int hs_used_load(const hash_set *hs) {
+  return (unsigned int)((uint64_t)(hs->count + hs->deleted) * 100 /
+                        hs->capacity);
 }
 
 /**
@@ -54,7 +159,7 @@ static void hs_resize(hash_set *hs, const int base_capacity) {
  * @param hs
  */
 static void hs_resize_up(hash_set *hs) {
-  const unsigned int new_capacity = hs->base_capacity * 2;
+  const size_t new_capacity = hs->base_capacity * 2;
   hs_resize(hs, new_capacity);
 }
 
@@ -65,10 +170,103 @@ static void hs_resize_up(hash_set *hs) {
  * @param hs
  */
 static void hs_resize_down(hash_set *hs) {
-  const unsigned int new_capacity = hs->base_capacity / 2;
+  const size_t new_capacity = hs->base_capacity / 2;
+
+  // Already at the smallest capacity; a rehash would only move the keys
+  if (next_prime(new_capacity ? new_capacity : HS_DEFAULT_CAPACITY) ==
+      hs->capacity) {
+    return;
+  }
+
   hs_resize(hs, new_capacity);
 }
 
+typedef struct {
+  const char **keys;
+  build_partition *bp;
+  _Atomic(char *) *slots;
+  size_t capacity;
+  atomic_uint next_partition;
+  size_t *counts;
+} hs_build_task;
+
+/**
+ * Bulk build worker. Claims partitions one at a time and places their keys;
+ * a slot is claimed with a compare-and-swap because probe sequences may leave
+ * the partition's region, but no two partitions share a key, so a lost race
+ * only ever means moving on to the next probe.
+ *
+ * @param arg
+ * @param worker
+ */
+static void hs_build_worker(void *arg, unsigned int worker) {
+  hs_build_task *task = arg;
+  build_partition *bp = task->bp;
+  size_t count = 0;
+
+  for (;;) {
+    const unsigned int p = atomic_fetch_add(&task->next_partition, 1);
+    if (p >= bp->num_partitions) {
+      break;
+    }
+
+    for (size_t j = bp->offsets[p]; j < bp->offsets[p + 1]; j++) {
+      const char *key = task->keys[bp->order[j]];
+      char *new_key = NULL;
+
+      const h_probe probe = bp->probes[bp->order[j]];
+
+      size_t i = 0;
+      size_t idx = probe.hash_a;
+      for (;;) {
+        char *current_key =
+            atomic_load_explicit(&task->slots[idx], memory_order_acquire);
+
+        if (current_key == NULL) {
+          if (new_key == NULL) {
+            new_key = strdup(key);
+          }
+
+          if (atomic_compare_exchange_strong_explicit(
+                  &task->slots[idx], &current_key, new_key,
+                  memory_order_release, memory_order_acquire)) {
+            count++;
+            break;
+          }
+        }
+
+        // Key already exists
+        if (strcmp(current_key, key) == 0) {
+          free(new_key);
+          break;
+        }
+
+        idx = h_probe_at(probe, task->capacity, ++i);
+      }
+    }
+  }
+
+  task->counts[worker] = count;
+}
+
+/**
+ * Account for the allocations of the keys of a set filled in without going
+ * through `hs_insert`
+ *
+ * @param hs
+ */
+static void hs_stats_key_allocs(hash_set *hs) {
+#ifdef LIBHASH_STATS
+  for (size_t i = 0; i < hs->capacity; i++) {
+    const char *r = hs->keys[i];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      STATS_ALLOC(hs->counters, strlen(r) + 1);
+    }
+  }
+#endif
+}
+
 /**
  * Delete a key and deallocate its memory
  *
@@ -76,82 +274,311 @@ static void hs_resize_down(hash_set *hs) {
  */
 static void hs_delete_key(char *r) { free(r); }
 
-hash_set *hs_init(int base_capacity) {
-  if (!base_capacity) {
-    base_capacity = HS_DEFAULT_CAPACITY;
+/**
+ * Find the slot holding the given key
+ *
+ * @param hs
+ * @param key
+ * @param probe The key's probe sequence in `hs`
+ * @return size_t The slot, or HS_NOT_FOUND
+ */
+static size_t hs_find(hash_set *hs, const char *key, h_probe probe) {
+  // If the capacity was set to the exact number of keys there won't be any
+  // NULL keys, so we stop once every slot has been probed
+  for (size_t i = 0; i < hs->capacity; i++) {
+    const size_t idx = h_probe_at(probe, hs->capacity, i);
+    const char *current_key = hs->keys[idx];
+
+    if (current_key == NULL) {
+      break;
+    }
+
+    if (current_key != HS_SENTINEL_KEY && strcmp(current_key, key) == 0) {
+      return idx;
+    }
+  }
+
+  return HS_NOT_FOUND;
+}
+
+/**
+ * Find the slot of a key in the small layout. Only slots whose tag matches
+ * have their keys compared.
+ *
+ * @param hs
+ * @param key
+ * @param tag The key's tag
+ * @return size_t The slot, or HS_NOT_FOUND
+ */
+static size_t hs_small_find(hash_set *hs, const char *key, uint8_t tag) {
+  unsigned int matches = small_match(hs->small_tags, tag);
+
+  for (unsigned int i = 0; matches != 0; i++, matches >>= 1) {
+    if ((matches & 1) && strcmp(hs->keys[i], key) == 0) {
+      return i;
+    }
+  }
+
+  return HS_NOT_FOUND;
+}
+
+/**
+ * Find the slot holding the given key, in either layout
+ *
+ * @param hs
+ * @param key
+ * @return size_t The slot, or HS_NOT_FOUND
+ */
+static size_t hs_lookup(hash_set *hs, const char *key) {
+  if (hs_is_small(hs)) {
+    return hs_small_find(hs, key, small_tag(key));
+  }
+
+  return hs_find(hs, key, h_probe_init(key, hs->capacity));
+}
+
+/**
+ * Trim the gaps deletions have left at the end of the small layout, giving
+ * those slots back to the next insertion
+ *
+ * @param hs
+ */
+static void hs_small_trim(hash_set *hs) {
+  while (hs->small_used > 0 && hs->keys[hs->small_used - 1] == NULL) {
+    hs->small_used--;
+  }
+}
+
+/**
+ * Delete the key in the given slot, without resizing the set
+ *
+ * @param hs
+ * @param idx
+ */
+static void hs_remove_slot(hash_set *hs, size_t idx) {
+  hs_delete_key(hs->keys[idx]);
+  hs->count--;
+
+  if (hs_is_small(hs)) {
+    hs->keys[idx] = NULL;
+    hs->small_tags = small_set_tag(hs->small_tags, (unsigned int)idx, 0);
+    hs_small_trim(hs);
+  } else {
+    hs->keys[idx] = HS_SENTINEL_KEY;
+    hs->deleted++;
+  }
+}
+
+/**
+ * Close the gaps deletions have left in the small layout, keeping the
+ * remaining keys in insertion order.
+ *
+ * @param hs
+ */
+static void hs_small_compact(hash_set *hs) {
+  unsigned int used = 0;
+  uint64_t tags = 0;
+
+  for (unsigned int i = 0; i < hs->small_used; i++) {
+    if (hs->keys[i] != NULL) {
+      tags = small_set_tag(tags, used, (uint8_t)(hs->small_tags >> (i * 8)));
+      hs->keys[used++] = hs->keys[i];
+    }
+  }
+
+  memset(&hs->keys[used], 0, sizeof(char *) * (HT_SMALL_CAPACITY - used));
+  hs->small_tags = tags;
+  hs->small_used = used;
+}
+
+/**
+ * Bring a set in the small layout back in line with it after `hs_filter`:
+ * slots of dropped keys are cleared, rather than left deleted, and the tags
+ * recomputed. Sets in the hashed layout are left as they are.
+ *
+ * @param hs
+ */
+static void hs_small_retag(hash_set *hs) {
+  if (!hs_is_small(hs)) {
+    return;
   }
 
+  hs->small_tags = 0;
+  hs->deleted = 0;
+  for (unsigned int i = 0; i < hs->small_used; i++) {
+    if (hs->keys[i] == HS_SENTINEL_KEY) {
+      hs->keys[i] = NULL;
+    } else if (hs->keys[i] != NULL) {
+      hs->small_tags = small_set_tag(hs->small_tags, i, small_tag(hs->keys[i]));
+    }
+  }
+
+  hs_small_trim(hs);
+}
+
+/**
+ * Allocate an empty set
+ *
+ * @param base_capacity
+ * @param capacity HT_SMALL_CAPACITY for the small layout, which moves to the
+ * hashed one at `base_capacity`
+ * @return hash_set*
+ */
+static hash_set *hs_alloc(size_t base_capacity, size_t capacity) {
   hash_set *hs = malloc(sizeof(hash_set));
   hs->base_capacity = base_capacity;
 
-  hs->capacity = next_prime(hs->base_capacity);
+  hs->capacity = capacity;
   hs->count = 0;
-  hs->keys = calloc((size_t)hs->capacity, sizeof(char *));
+  hs->deleted = 0;
+  hs->keys = calloc(hs->capacity, sizeof(char *));
+  hs->generation = 0;
+  hs->counters = (ht_counters){0};
+  STATS_ALLOC(hs->counters, sizeof(char *) * hs->capacity);
+  hs->small_tags = 0;
+  hs->small_used = 0;
 
   return hs;
 }
 
-void hs_insert(hash_set *hs, const void *key) {
-  if (hs == NULL) {
-    return;
+hash_set *hs_init(size_t base_capacity) {
+  // Sets asked for no more than the small layout holds start out in it
+  if (base_capacity <= HT_SMALL_CAPACITY) {
+    return hs_alloc(HS_DEFAULT_CAPACITY, HT_SMALL_CAPACITY);
   }
 
-  const unsigned int load = hs->count * 100 / hs->capacity;
-  if (load > 70) {
-    hs_resize_up(hs);
+  return hs_alloc(base_capacity, next_prime(base_capacity));
+}
+
+/**
+ * Variant of `hs_insert` for a set in the small layout. Gaps left by deletions
+ * are closed once the appended keys reach the last slot.
+ *
+ * @param hs
+ * @param key
+ * @return int 1 if inserted, 0 if already present, -1 if every slot holds a
+ * key and the set must move to the hashed layout first
+ */
+static int hs_small_insert(hash_set *hs, const char *key) {
+  const uint8_t tag = small_tag(key);
+  if (hs_small_find(hs, key, tag) != HS_NOT_FOUND) {
+    return 0;
   }
 
-  void *new_entry = strdup(key);
+  if (hs->small_used == HT_SMALL_CAPACITY) {
+    if (hs->count == HT_SMALL_CAPACITY) {
+      return -1;
+    }
+    hs_small_compact(hs);
+  }
+
+  hs->keys[hs->small_used] = strdup(key);
+  STATS_ALLOC(hs->counters, strlen(key) + 1);
+  hs->small_tags = small_set_tag(hs->small_tags, hs->small_used, tag);
+  hs->small_used++;
+  hs->count++;
+
+  return 1;
+}
+
+int hs_insert(hash_set *hs, const void *key) {
+  if (hs == NULL) {
+    return 0;
+  }
+
+  if (hs_is_small(hs)) {
+    const int inserted = hs_small_insert(hs, key);
+    if (inserted >= 0) {
+      return inserted;
+    }
 
-  unsigned int idx = h_compute_hash(key, hs->capacity, 0);
+    // Outgrown; move to the hashed layout at the default capacity
+    hs_resize(hs, hs->base_capacity);
+  } else if (hs_used_load(hs) > 70) {
+    // Grow only if keys, rather than deleted slots, are what fill the array;
+    // otherwise rehash at the same size to clear the deleted slots
+    if (hs->count * 2 > hs->capacity) {
+      hs_resize_up(hs);
+    } else {
+      hs_resize(hs, hs->base_capacity);
+    }
+  }
+
+  const h_probe probe = h_probe_init(key, hs->capacity);
+  size_t idx = h_probe_at(probe, hs->capacity, 0);
   char *current_key = hs->keys[idx];
 
-  unsigned int i = 1;
+  // Reuse the first slot freed by a deletion, once we know the key is absent
+  size_t free_idx = SIZE_MAX;
+
+  size_t i = 1;
   // If there was a collision...
-  while (current_key != NULL) {
-    // Key already exists (update)
-    if (strcmp(current_key, key) == 0) {
-      return;
+  while (current_key != NULL && i <= hs->capacity) {
+    if (current_key == HS_SENTINEL_KEY) {
+      if (free_idx == SIZE_MAX) {
+        free_idx = idx;
+      }
+    } else if (strcmp(current_key, key) == 0) {
+      // Key already exists
+      return 0;
     }
 
-    idx = h_compute_hash(new_entry, hs->capacity, i);
+    idx = h_probe_at(probe, hs->capacity, i);
     current_key = hs->keys[idx];
     i++;
   }
 
-  hs->keys[idx] = new_entry;
+  if (free_idx != SIZE_MAX) {
+    idx = free_idx;
+    hs->deleted--;
+  }
+
+  hs->keys[idx] = strdup(key);
+  STATS_ALLOC(hs->counters, strlen(key) + 1);
   hs->count++;
+
+  return 1;
 }
 
 int hs_contains(hash_set *hs, const char *key) {
-  unsigned int idx = h_compute_hash(key, hs->capacity, 0);
-  char *current_key = hs->keys[idx];
+  return hs_lookup(hs, key) != HS_NOT_FOUND;
+}
 
-  unsigned int i = 1;
-  while (current_key != NULL) {
-    if (strcmp(current_key, key) == 0) {
-      return 1;
+void hs_get_stats(hash_set *hs, hs_stats *stats) {
+  stats_begin(stats, hs->capacity, hs->count, &hs->counters);
+
+  if (hs_is_small(hs)) {
+    // See `ht_get_stats`
+    for (unsigned int i = 0; i < hs->small_used; i++) {
+      if (hs->keys[i] == NULL) {
+        stats->tombstones++;
+      } else {
+        stats_add_displacement(stats, 0);
+      }
     }
 
-    idx = h_compute_hash(key, hs->capacity, i);
-    current_key = hs->keys[idx];
-    i++;
+    stats_end(stats);
+    return;
+  }
 
-    // If the capacity was set to the exact number of keys, we need to break
-    // once we've checked all of them - there won't be any NULL keys
-    if (i == hs->count + 1) {
-      break;
+  for (size_t i = 0; i < hs->capacity; i++) {
+    const char *r = hs->keys[i];
+
+    if (r == HS_SENTINEL_KEY) {
+      stats->tombstones++;
+    } else if (r != NULL) {
+      stats_add_key(stats, h_probe_init(r, hs->capacity), i);
     }
   }
 
-  return 0;
+  stats_end(stats);
 }
 
 void hs_delete_set(hash_set *hs) {
-  for (unsigned int i = 0; i < hs->capacity; i++) {
+  for (size_t i = 0; i < hs->capacity; i++) {
     char *r = hs->keys[i];
 
-    if (r != NULL) {
+    if (r != NULL && r != HS_SENTINEL_KEY) {
       hs_delete_key(r);
     }
   }
@@ -161,30 +588,500 @@ void hs_delete_set(hash_set *hs) {
 }
 
 int hs_delete(hash_set *hs, const char *key) {
-  const unsigned int load = hs->count * 100 / hs->capacity;
-
-  if (load < 10) {
+  // A set never moves back to the small layout
+  if (!hs_is_small(hs) && hs_load(hs) < 10) {
     hs_resize_down(hs);
   }
 
-  unsigned int i = 0;
-  unsigned int idx = h_compute_hash(key, hs->capacity, i);
+  const size_t idx = hs_lookup(hs, key);
+  if (idx == HS_NOT_FOUND) {
+    return 0;
+  }
 
-  char *current_key = hs->keys[idx];
+  hs_remove_slot(hs, idx);
+
+  return 1;
+}
+
+hash_set *hs_build(const char **keys, size_t n, unsigned int num_threads) {
+  const size_t base_capacity = build_capacity(n);
+  hash_set *hs = hs_alloc(base_capacity, next_prime(base_capacity));
+  const unsigned int num_workers = build_num_workers(n, num_threads);
 
-  while (current_key != NULL) {
-    if (strcmp(current_key, key) == 0) {
-      hs_delete_key(current_key);
-      hs->keys[idx] = NULL;
+  build_partition bp;
+  build_partition_keys(&bp, keys, n, hs->capacity, num_workers);
 
-      hs->count--;
+  hs_build_task task = {
+      .keys = keys,
+      .bp = &bp,
+      // The array is only ever accessed atomically until the workers join
+      .slots = (_Atomic(char *) *)hs->keys,
+      .capacity = hs->capacity,
+      .counts = malloc(sizeof(size_t) * num_workers),
+  };
+  atomic_init(&task.next_partition, 0);
 
-      return 1;
+  parallel_run(num_workers, hs_build_worker, &task);
+
+  for (unsigned int w = 0; w < num_workers; w++) {
+    hs->count += task.counts[w];
+  }
+  hs_stats_key_allocs(hs);
+
+  free(task.counts);
+  build_partition_free(&bp);
+
+  return hs;
+}
+
+int hs_save(hash_set *hs, const char *path) {
+  const char **keys = malloc(sizeof(char *) * (hs->count ? hs->count : 1));
+
+  size_t n = 0;
+  for (size_t i = 0; i < hs->capacity; i++) {
+    const char *r = hs->keys[i];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      keys[n++] = r;
     }
+  }
 
-    idx = h_compute_hash(key, hs->capacity, ++i);
-    current_key = hs->keys[idx];
+  const int ok = snapshot_write(path, SNAPSHOT_SET, keys, NULL, NULL, n);
+  free(keys);
+
+  return ok;
+}
+
+frozen_hash_set *hs_freeze(hash_set *hs) {
+  const size_t n = hs->count;
+  uint64_t *hashes = malloc(sizeof(uint64_t) * (n ? n : 1));
+  char **keys = malloc(sizeof(char *) * (n ? n : 1));
+
+  size_t j = 0;
+  for (size_t i = 0; i < hs->capacity; i++) {
+    char *r = hs->keys[i];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      keys[j] = r;
+      hashes[j] = h_hash_64(r);
+      j++;
+    }
+  }
+
+  frozen_hash_set *fhs = malloc(sizeof(frozen_hash_set));
+  if (!ph_build(&fhs->ph, hashes, n)) {
+    free(fhs);
+    free(keys);
+    free(hashes);
+    return NULL;
+  }
+
+  fhs->keys = malloc(sizeof(char *) * (n ? n : 1));
+  for (size_t i = 0; i < n; i++) {
+    fhs->keys[ph_position(&fhs->ph, hashes[i])] = keys[i];
+  }
+
+  // The keys now belong to the frozen set
+  free(hs->keys);
+  free(hs);
+
+  free(keys);
+  free(hashes);
+
+  return fhs;
+}
+
+int fhs_contains(frozen_hash_set *fhs, const char *key) {
+  if (fhs->ph.n == 0) {
+    return 0;
+  }
+
+  return strcmp(fhs->keys[ph_position(&fhs->ph, h_hash_64(key))], key) == 0;
+}
+
+size_t fhs_count(frozen_hash_set *fhs) { return fhs->ph.n; }
+
+void fhs_delete_set(frozen_hash_set *fhs) {
+  for (size_t i = 0; i < fhs->ph.n; i++) {
+    hs_delete_key(fhs->keys[i]);
+  }
+
+  ph_free(&fhs->ph);
+  free(fhs->keys);
+  free(fhs);
+}
+
+/**
+ * Bring a cursor up to date with the set, restarting it if the set has
+ * changed capacity since the cursor last moved.
+ *
+ * @param hs
+ * @param cursor
+ * @return 1 if slots remain to be visited, 0 if the scan is complete
+ */
+static int hs_cursor_sync(hash_set *hs, hs_cursor *cursor) {
+  if (cursor->pos == HS_CURSOR_DONE) {
+    return 0;
+  }
+
+  // Slot positions don't survive a resize; start over in the new slot array
+  if (cursor->generation != hs->generation) {
+    cursor->pos = 0;
+    cursor->generation = hs->generation;
+  }
+
+  if (cursor->pos >= hs->capacity) {
+    cursor->pos = HS_CURSOR_DONE;
+    return 0;
+  }
+
+  return 1;
+}
+
+void hs_cursor_init(hash_set *hs, hs_cursor *cursor) {
+  cursor->pos = 0;
+  cursor->generation = hs->generation;
+}
+
+const char *hs_cursor_next(hash_set *hs, hs_cursor *cursor) {
+  while (hs_cursor_sync(hs, cursor)) {
+    const char *r = hs->keys[cursor->pos++];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      return r;
+    }
+  }
+
+  return NULL;
+}
+
+int hs_scan(hash_set *hs, hs_cursor *cursor, size_t budget,
+            hs_visit_fn *visit, void *ctx) {
+  for (size_t n = 0; n < budget && hs_cursor_sync(hs, cursor); n++) {
+    const char *r = hs->keys[cursor->pos++];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      visit(r, ctx);
+    }
+  }
+
+  return hs_cursor_sync(hs, cursor);
+}
+
+typedef struct {
+  /**
+   * The set whose keys are filtered
+   */
+  hash_set *src;
+
+  /**
+   * The set keys are tested against; NULL keeps every key
+   */
+  hash_set *other;
+
+  /**
+   * Whether to keep the keys which are members of `other`, or those which
+   * are not
+   */
+  bool keep_members;
+
+  /**
+   * Slot array receiving the result, laid out like `src`'s; if it is `src`'s
+   * own, keys are filtered in place
+   */
+  char **out;
+
+  atomic_size_t next_chunk;
+  size_t *counts;
+} hs_filter_task;
+
+/**
+ * Filter the keys in slots `begin` (inclusive) to `end` (exclusive) of the
+ * task's source set. Keys are tested against the other set in batches: the
+ * probe sequences of a whole batch are computed, and their first slots
+ * prefetched, before any of them is resolved.
+ *
+ * @param task
+ * @param begin
+ * @param end
+ * @return size_t Number of keys kept
+ */
+static size_t hs_filter_range(hs_filter_task *task, size_t begin, size_t end) {
+  hash_set *other = task->other;
+  const bool in_place = task->out == task->src->keys;
+  size_t kept = 0;
+
+  size_t batch[HS_PROBE_BATCH];
+  h_probe probes[HS_PROBE_BATCH];
+
+  size_t idx = begin;
+  while (idx < end) {
+    size_t n = 0;
+    for (; idx < end && n < HS_PROBE_BATCH; idx++) {
+      char *r = task->src->keys[idx];
+
+      if (r == NULL || r == HS_SENTINEL_KEY) {
+        task->out[idx] = r;
+        continue;
+      }
+
+      if (other != NULL && other->count > 0 && !hs_is_small(other)) {
+        probes[n] = h_probe_init(r, other->capacity);
+        HS_PREFETCH(&other->keys[h_probe_at(probes[n], other->capacity, 0)]);
+      }
+      batch[n++] = idx;
+    }
+
+    for (size_t j = 0; j < n; j++) {
+      char *r = task->src->keys[batch[j]];
+      // A small set is searched at once; its tags are a single word
+      const bool member =
+          other != NULL && other->count > 0 &&
+          (hs_is_small(other) ? hs_small_find(other, r, small_tag(r))
+                              : hs_find(other, r, probes[j])) != HS_NOT_FOUND;
+
+      if (other == NULL || member == task->keep_members) {
+        task->out[batch[j]] = in_place ? r : strdup(r);
+        kept++;
+      } else {
+        if (in_place) {
+          hs_delete_key(r);
+        }
+        task->out[batch[j]] = HS_SENTINEL_KEY;
+      }
+    }
+  }
+
+  return kept;
+}
+
+static void hs_filter_worker(void *arg, unsigned int worker) {
+  hs_filter_task *task = arg;
+  size_t kept = 0;
+
+  for (;;) {
+    const size_t begin = atomic_fetch_add(&task->next_chunk, HS_SET_OP_CHUNK);
+    if (begin >= task->src->capacity) {
+      break;
+    }
+
+    const size_t end = begin + HS_SET_OP_CHUNK < task->src->capacity
+                           ? begin + HS_SET_OP_CHUNK
+                           : task->src->capacity;
+    kept += hs_filter_range(task, begin, end);
+  }
+
+  task->counts[worker] = kept;
+}
+
+/**
+ * Keep the keys of `src` which are (or are not) members of `other`, writing
+ * the result into `out`, which is laid out slot for slot like `src`: each
+ * kept key stays at its index, and each dropped key leaves a deleted slot
+ * behind, so every kept key remains reachable along its probe sequence and no
+ * key is ever rehashed into a new position. A set in the small layout must
+ * then be passed to `hs_small_retag`.
+ *
+ * @param src
+ * @param other The set keys are tested against; NULL keeps every key
+ * @param keep_members
+ * @param out Either `src->keys`, to filter in place, or a zeroed array of
+ * `src->capacity` slots, to receive copies of the kept keys
+ * @param num_threads
+ * @return size_t Number of keys kept
+ */
+static size_t hs_filter(hash_set *src, hash_set *other, bool keep_members,
+                        char **out, unsigned int num_threads) {
+  const unsigned int num_workers = build_num_workers(src->count, num_threads);
+
+  hs_filter_task task = {
+      .src = src,
+      .other = other,
+      .keep_members = keep_members,
+      .out = out,
+      .counts = malloc(sizeof(size_t) * num_workers),
+  };
+  atomic_init(&task.next_chunk, 0);
+
+  parallel_run(num_workers, hs_filter_worker, &task);
+
+  size_t kept = 0;
+  for (unsigned int w = 0; w < num_workers; w++) {
+    kept += task.counts[w];
+  }
+
+  free(task.counts);
+
+  return kept;
+}
+
+/**
+ * Rehash the set into a smaller slot array if deleted slots far outnumber
+ * its keys
+ *
+ * @param hs
+ */
+static void hs_compact(hash_set *hs) {
+  if (hs->capacity > HS_DEFAULT_CAPACITY && hs_load(hs) < 10) {
+    hs_resize(hs, hs->count * 2);
+  }
+}
+
+/**
+ * Create a set holding the keys of `src` which are (or are not) members of
+ * `other`. See `hs_filter`.
+ *
+ * @param src
+ * @param other
+ * @param keep_members
+ * @param num_threads
+ * @return hash_set*
+ */
+static hash_set *hs_filtered_copy(hash_set *src, hash_set *other,
+                                  bool keep_members,
+                                  unsigned int num_threads) {
+  hash_set *hs = hs_alloc(src->base_capacity, src->capacity);
+  hs->count = hs_filter(src, other, keep_members, hs->keys, num_threads);
+  hs->deleted = src->deleted + (src->count - hs->count);
+  hs->small_used = src->small_used;
+  hs_small_retag(hs);
+  hs_stats_key_allocs(hs);
+
+  hs_compact(hs);
+
+  return hs;
+}
+
+/**
+ * Remove each key of `keys` from `hs`, without resizing it
+ *
+ * @param hs
+ * @param keys
+ */
+static void hs_remove_all(hash_set *hs, hash_set *keys) {
+  for (size_t i = 0; i < keys->capacity; i++) {
+    const char *r = keys->keys[i];
+
+    if (r == NULL || r == HS_SENTINEL_KEY) {
+      continue;
+    }
+
+    const size_t idx = hs_lookup(hs, r);
+    if (idx != HS_NOT_FOUND) {
+      hs_remove_slot(hs, idx);
+    }
+  }
+}
+
+hash_set *hs_union(hash_set *a, hash_set *b, unsigned int num_threads) {
+  hash_set *larger = a->count >= b->count ? a : b;
+  hash_set *smaller = larger == a ? b : a;
+
+  // Copy the larger set slot for slot, then add only the smaller one's keys
+  hash_set *hs = hs_filtered_copy(larger, NULL, true, num_threads);
+  hs_union_into(hs, smaller);
+
+  return hs;
+}
+
+hash_set *hs_intersect(hash_set *a, hash_set *b, unsigned int num_threads) {
+  hash_set *larger = a->count >= b->count ? a : b;
+  hash_set *smaller = larger == a ? b : a;
+
+  return hs_filtered_copy(smaller, larger, true, num_threads);
+}
+
+hash_set *hs_difference(hash_set *a, hash_set *b, unsigned int num_threads) {
+  if (b->count < a->count) {
+    // Cheaper to probe `a` once per key of `b` than `b` once per key of `a`
+    hash_set *hs = hs_filtered_copy(a, NULL, true, num_threads);
+    hs_remove_all(hs, b);
+    hs_compact(hs);
+
+    return hs;
+  }
+
+  return hs_filtered_copy(a, b, false, num_threads);
+}
+
+void hs_union_into(hash_set *dst, hash_set *src) {
+  if (dst == src) {
+    return;
+  }
+
+  for (size_t i = 0; i < src->capacity; i++) {
+    const char *r = src->keys[i];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      hs_insert(dst, r);
+    }
+  }
+}
+
+void hs_intersect_into(hash_set *dst, hash_set *src,
+                       unsigned int num_threads) {
+  if (dst == src) {
+    return;
+  }
+
+  if (dst->count <= src->count) {
+    const size_t kept = hs_filter(dst, src, true, dst->keys, num_threads);
+    dst->deleted += dst->count - kept;
+    dst->count = kept;
+    hs_small_retag(dst);
+    hs_compact(dst);
+    return;
+  }
+
+  // Filter the smaller set instead, and swap the result in
+  hash_set *hs = hs_filtered_copy(src, dst, true, num_threads);
+
+  for (size_t i = 0; i < dst->capacity; i++) {
+    char *r = dst->keys[i];
+
+    if (r != NULL && r != HS_SENTINEL_KEY) {
+      hs_delete_key(r);
+    }
+  }
+  free(dst->keys);
+
+  dst->keys = hs->keys;
+  dst->capacity = hs->capacity;
+  dst->base_capacity = hs->base_capacity;
+  dst->count = hs->count;
+  dst->deleted = hs->deleted;
+  dst->small_tags = hs->small_tags;
+  dst->small_used = hs->small_used;
+  dst->generation++;
+  dst->counters.resizes += hs->counters.resizes;
+  dst->counters.resize_ns += hs->counters.resize_ns;
+  dst->counters.allocations += hs->counters.allocations;
+  dst->counters.allocated_bytes += hs->counters.allocated_bytes;
+  free(hs);
+}
+
+void hs_difference_into(hash_set *dst, hash_set *src,
+                        unsigned int num_threads) {
+  if (dst == src) {
+    // Every key is a member of the set itself
+    for (size_t i = 0; i < dst->capacity; i++) {
+      if (dst->keys[i] != NULL && dst->keys[i] != HS_SENTINEL_KEY) {
+        hs_delete_key(dst->keys[i]);
+      }
+      dst->keys[i] = NULL;
+    }
+    dst->count = 0;
+    dst->deleted = 0;
+    dst->small_tags = 0;
+    dst->small_used = 0;
+  } else if (src->count < dst->count) {
+    hs_remove_all(dst, src);
+  } else {
+    const size_t kept = hs_filter(dst, src, false, dst->keys, num_threads);
+    dst->deleted += dst->count - kept;
+    dst->count = kept;
+    hs_small_retag(dst);
   }
 
-  return 0;
+  hs_compact(dst);
 }
@@ -1,66 +1,670 @@
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "build.h"
 #include "hash.h"
 #include "libhash.h"
+#include "parallel.h"
+#include "perfect_hash.h"
 #include "prime.h"
+#include "slots.h"
+#include "small.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "strdup/strdup.h"
+#include "timer_wheel.h"
 
 static ht_entry HT_SENTINEL_ENTRY = {NULL, NULL};
 
-static void __ht_insert(hash_table *ht, const char *key, void *value);
+/**
+ * An entry of a table with expiry enabled. The entry comes first, so the two
+ * may be passed around and freed interchangeably.
+ */
+typedef struct {
+  ht_entry entry;
+  tw_timer timer;
+} ht_ttl_entry;
+
+struct ht_expiry {
+  timer_wheel wheel;
+  ht_clock_fn *clock;
+};
+
+struct frozen_hash_table {
+  perfect_hash ph;
+
+  /**
+   * Each entry, stored in the slot its key's perfect hash resolves to
+   */
+  ht_entry **entries;
+
+  free_fn *free_value;
+};
+
+static ht_entry *__ht_insert(hash_table *ht, const char *key, void *value);
 static int __ht_delete(hash_table *ht, const char *key);
 static void __ht_delete_table(hash_table *ht);
 
+/**
+ * Number of slots a parallel scan worker claims at a time
+ */
+#define HT_ITER_CHUNK 4096
+
+/**
+ * Minimum number of entries for which a resize is spread across threads;
+ * below it, thread start-up costs more than the rehash itself.
+ */
+#define HT_PARALLEL_RESIZE_MIN 16384
+
+/**
+ * Number of old slots a resize worker claims at a time
+ */
+#define HT_RESIZE_CHUNK 4096
+
+/**
+ * Cursor position marking a completed scan
+ */
+#define HT_CURSOR_DONE SIZE_MAX
+
+/**
+ * Slot index marking a key which could not be found
+ */
+#define HT_NOT_FOUND SIZE_MAX
+
+/**
+ * Number of other keys an insertion may probe past before it is taken as a
+ * sign of colliding keys; both the hashed and the ordered layouts count them
+ * the same way. Deleted slots are passed over uncounted, as they say nothing
+ * about the hash. Under a uniform hash at the max load of .7, a sequence this
+ * long turns up about once in 10^10 insertions.
+ */
+#define HT_WATCHDOG_PROBES 64
+
+/**
+ * How a table lays out its entries, when it is created
+ */
+typedef enum { HT_LAYOUT_SMALL, HT_LAYOUT_HASHED, HT_LAYOUT_ORDERED } ht_layout;
+
+typedef struct {
+  const hash_table *ht;
+  ht_entry **old_entries;
+  size_t old_capacity;
+  _Atomic(ht_entry *) *new_entries;
+  size_t new_capacity;
+  node_t *old_buckets;
+  atomic_size_t next_slot;
+  node_t **heads;
+  node_t **tails;
+} ht_resize_task;
+
+/**
+ * Compute the probe sequence of a key in a slot array of the given capacity,
+ * using the table's hash mode
+ *
+ * @param ht
+ * @param key
+ * @param capacity
+ * @return h_probe
+ */
+static h_probe ht_probe(const hash_table *ht, const char *key,
+                        size_t capacity) {
+  if (ht->hash_mode == HT_HASH_SEEDED) {
+    return h_probe_from_64(h_siphash_13(key, ht->seed), capacity);
+  }
+
+  if (ht->hash_mode == HT_HASH_CRC32C) {
+    // Spread the 32-bit CRC over both halves, from which the probe is taken
+    return h_probe_from_64(h_mix_64(h_crc32c(key)), capacity);
+  }
+
+  return h_probe_init(key, capacity);
+}
+
+/**
+ * Determine whether the table is in the small layout. Hashed slot arrays never
+ * go below the default capacity, so their sizes cannot be mistaken for it.
+ *
+ * @param ht
+ * @return bool
+ */
+static bool ht_is_small(const hash_table *ht) {
+  return ht->capacity == HT_SMALL_CAPACITY;
+}
+
+/**
+ * Determine whether the table is in the ordered layout
+ *
+ * @param ht
+ * @return bool
+ */
+static bool ht_is_ordered(const hash_table *ht) {
+  return ht->ordered_index != NULL;
+}
+
+/**
+ * Number of entries the dense array of an ordered table holds, for a hash
+ * index of the given capacity. Tables grow at 70% load, so a quarter of the
+ * index is always left empty, however many entries were deleted in between.
+ *
+ * @param capacity
+ * @return size_t
+ */
+static size_t ht_ordered_slots(size_t capacity) { return capacity * 3 / 4 + 1; }
+
+/**
+ * Number of slots in the table's `entries` array; slot ranges, cursors and
+ * scans all run over these
+ *
+ * @param ht
+ * @return size_t
+ */
+static size_t ht_num_slots(const hash_table *ht) {
+  return ht_is_ordered(ht) ? ht_ordered_slots(ht->capacity) : ht->capacity;
+}
+
+/**
+ * Choose the width of the hash index for a dense array of the given length;
+ * the largest value of each width is kept to mark deleted entries
+ *
+ * @param num_slots
+ * @return unsigned int Bytes per index slot
+ */
+static unsigned int ht_ordered_width(size_t num_slots) {
+  if (num_slots < UINT8_MAX) {
+    return 1;
+  }
+  if (num_slots < UINT16_MAX) {
+    return 2;
+  }
+  if (num_slots < UINT32_MAX) {
+    return 4;
+  }
+  return 8;
+}
+
+/**
+ * Value of a hash index slot whose entry was deleted
+ *
+ * @param ht
+ * @return size_t
+ */
+static size_t ht_ordered_deleted(const hash_table *ht) {
+  return (size_t)(UINT64_MAX >> (64 - 8 * ht->ordered_width));
+}
+
+static size_t ht_index_get(const hash_table *ht, size_t i) {
+  switch (ht->ordered_width) {
+    case 1:
+      return ((const uint8_t *)ht->ordered_index)[i];
+    case 2:
+      return ((const uint16_t *)ht->ordered_index)[i];
+    case 4:
+      return ((const uint32_t *)ht->ordered_index)[i];
+    default:
+      return ((const uint64_t *)ht->ordered_index)[i];
+  }
+}
+
+static void ht_index_set(hash_table *ht, size_t i, size_t value) {
+  switch (ht->ordered_width) {
+    case 1:
+      ((uint8_t *)ht->ordered_index)[i] = (uint8_t)value;
+      break;
+    case 2:
+      ((uint16_t *)ht->ordered_index)[i] = (uint16_t)value;
+      break;
+    case 4:
+      ((uint32_t *)ht->ordered_index)[i] = (uint32_t)value;
+      break;
+    default:
+      ((uint64_t *)ht->ordered_index)[i] = value;
+  }
+}
+
+/**
+ * Find the hash index slot of a key in the ordered layout
+ *
+ * @param ht
+ * @param key
+ * @return size_t The index slot, or HT_NOT_FOUND
+ */
+static size_t ht_ordered_lookup(const hash_table *ht, const char *key) {
+  const h_probe probe = ht_probe(ht, key, ht->capacity);
+  const size_t deleted = ht_ordered_deleted(ht);
+
+  for (size_t i = 0; i < ht->capacity; i++) {
+    const size_t idx = h_probe_at(probe, ht->capacity, i);
+    const size_t pos = ht_index_get(ht, idx);
+
+    if (pos == 0) {
+      break;
+    }
+
+    if (pos != deleted && strcmp(ht->entries[pos - 1]->key, key) == 0) {
+      return idx;
+    }
+  }
+
+  return HT_NOT_FOUND;
+}
+
+/**
+ * Find the slot of a key in the small layout. Only slots whose tag matches
+ * have their keys compared.
+ *
+ * @param ht
+ * @param key
+ * @param tag The key's tag
+ * @return unsigned int The key's slot, or HT_SMALL_CAPACITY if absent
+ */
+static unsigned int ht_small_find(const hash_table *ht, const char *key,
+                                  uint8_t tag) {
+  unsigned int matches = small_match(ht->small_tags, tag);
+
+  for (unsigned int i = 0; matches != 0; i++, matches >>= 1) {
+    if ((matches & 1) && strcmp(ht->entries[i]->key, key) == 0) {
+      return i;
+    }
+  }
+
+  return HT_SMALL_CAPACITY;
+}
+
+/**
+ * Close the gaps deleted entries have left in the small layout, keeping the
+ * remaining entries in insertion order.
+ *
+ * @param ht
+ */
+static void ht_small_compact(hash_table *ht) {
+  unsigned int used = 0;
+  uint64_t tags = 0;
+
+  for (unsigned int i = 0; i < ht->small_used; i++) {
+    if (ht->entries[i] != NULL) {
+      tags = small_set_tag(tags, used, (uint8_t)(ht->small_tags >> (i * 8)));
+      ht->entries[used++] = ht->entries[i];
+    }
+  }
+
+  memset(&ht->entries[used], 0,
+         sizeof(ht_entry *) * (HT_SMALL_CAPACITY - used));
+  ht->small_tags = tags;
+  ht->small_used = used;
+}
+
+/**
+ * Place an entry into the first free slot of its probe sequence. Entries
+ * being moved by a resize are known to be unique and the destination has no
+ * deleted slots, so no key comparisons are needed.
+ *
+ * @param ht
+ * @param entries
+ * @param capacity
+ * @param entry
+ * @return size_t The slot the entry was placed in
+ */
+static size_t ht_place_entry(const hash_table *ht, ht_entry **entries,
+                             size_t capacity, ht_entry *entry) {
+  const h_probe probe = ht_probe(ht, entry->key, capacity);
+  size_t i = 0;
+  size_t idx = h_probe_at(probe, capacity, i);
+
+  while (entries[idx] != NULL) {
+    idx = h_probe_at(probe, capacity, ++i);
+  }
+
+  entries[idx] = entry;
+  return idx;
+}
+
+/**
+ * Variant of `ht_place_entry` which may run concurrently with itself; slots
+ * are claimed with a compare-and-swap, and a worker which loses a slot simply
+ * carries on along its probe sequence.
+ *
+ * @param ht
+ * @param entries
+ * @param capacity
+ * @param entry
+ * @return size_t The slot the entry was placed in
+ */
+static size_t ht_place_entry_atomic(const hash_table *ht,
+                                    _Atomic(ht_entry *) *entries,
+                                    size_t capacity, ht_entry *entry) {
+  const h_probe probe = ht_probe(ht, entry->key, capacity);
+
+  for (size_t i = 0;; i++) {
+    const size_t idx = h_probe_at(probe, capacity, i);
+    ht_entry *expected = NULL;
+
+    if (atomic_compare_exchange_strong_explicit(&entries[idx], &expected,
+                                                entry, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+      return idx;
+    }
+  }
+}
+
+/**
+ * Resize worker. Worker 0 first releases the old occupied bucket list, which
+ * can only be walked serially; every worker then claims chunks of the old
+ * slot array and moves their entries into the new one, recording the new
+ * slots in a worker-local bucket list.
+ *
+ * @param arg
+ * @param worker
+ */
+static void ht_resize_worker(void *arg, unsigned int worker) {
+  ht_resize_task *task = arg;
+
+  if (worker == 0) {
+    list_free(task->old_buckets);
+  }
+
+  node_t *head = list_create_sentinel_node();
+  node_t *tail = NULL;
+
+  for (;;) {
+    const size_t start = atomic_fetch_add(&task->next_slot, HT_RESIZE_CHUNK);
+    if (start >= task->old_capacity) {
+      break;
+    }
+
+    size_t end = start + HT_RESIZE_CHUNK;
+    if (end > task->old_capacity) {
+      end = task->old_capacity;
+    }
+
+    for (size_t i = start; i < end; i++) {
+      ht_entry *r = task->old_entries[i];
+      if (r == NULL || r == &HT_SENTINEL_ENTRY) {
+        continue;
+      }
+
+      list_prepend(&head, ht_place_entry_atomic(task->ht, task->new_entries,
+                                                task->new_capacity, r));
+      if (tail == NULL) {
+        tail = head;
+      }
+    }
+  }
+
+  task->heads[worker] = head;
+  task->tails[worker] = tail;
+}
+
+/**
+ * Splice together the occupied bucket lists built by each worker of a
+ * parallel operation. Workers which placed no entries have a NULL tail.
+ *
+ * @param heads
+ * @param tails
+ * @param num_workers
+ * @return node_t*
+ */
+static node_t *ht_splice_buckets(node_t **heads, node_t **tails,
+                                 unsigned int num_workers) {
+  node_t *head = list_create_sentinel_node();
+
+  for (unsigned int w = 0; w < num_workers; w++) {
+    if (tails[w] != NULL) {
+      tails[w]->next = head;
+      head = heads[w];
+    }
+  }
+
+  return head;
+}
+
+/**
+ * Move every entry into `new_entries` across `num_workers` threads, then
+ * splice the workers' bucket lists together.
+ *
+ * @param ht
+ * @param new_entries
+ * @param new_capacity
+ * @param num_workers
+ */
+static void ht_resize_parallel(hash_table *ht, ht_entry **new_entries,
+                               size_t new_capacity, unsigned int num_workers) {
+  ht_resize_task task = {
+      .ht = ht,
+      .old_entries = ht->entries,
+      .old_capacity = ht->capacity,
+      // The array is only ever accessed atomically until the workers join
+      .new_entries = (_Atomic(ht_entry *) *)new_entries,
+      .new_capacity = new_capacity,
+      .old_buckets = ht->occupied_buckets,
+      .heads = malloc(sizeof(node_t *) * num_workers),
+      .tails = malloc(sizeof(node_t *) * num_workers),
+  };
+  atomic_init(&task.next_slot, 0);
+
+  parallel_run(num_workers, ht_resize_worker, &task);
+
+  ht->occupied_buckets = ht_splice_buckets(task.heads, task.tails, num_workers);
+
+  free(task.heads);
+  free(task.tails);
+}
+
+/**
+ * Allocate a zeroed slot array for the table, reusing its spare array if that
+ * is large enough
+ *
+ * @param ht
+ * @param capacity
+ * @param mapped Set to the length of the mapping backing the array, or 0
+ * @return ht_entry**
+ */
+static ht_entry **ht_slots_alloc(hash_table *ht, size_t capacity,
+                                 size_t *mapped) {
+  const size_t size = sizeof(ht_entry *) * capacity;
+
+  ht_entry **entries =
+      slots_take_spare(&ht->spare_slots, &ht->spare_mapped, size, mapped);
+  if (entries == NULL) {
+    entries = slots_alloc(size, ht->mem_flags, ht->numa_node, mapped);
+    STATS_ALLOC(ht->counters, size);
+  }
+
+  return entries;
+}
+
+/**
+ * Shrink the table within its current slot array, rather than allocating a
+ * new one and holding both while entries are moved. The live entries are first
+ * packed against the top of the array, walking down so that no slot is
+ * overwritten before it has been read; the bottom `new_capacity` slots are
+ * then cleared and the entries placed back into them. Slots past the new
+ * capacity are returned to the system.
+ *
+ * Only mapped arrays are shrunk in place, and only while the packed entries
+ * clear the new capacity, which a shrink at 30% load always leaves room for.
+ *
+ * @param ht
+ * @param new_capacity
+ * @return bool Whether the table was shrunk
+ */
+static bool ht_shrink_in_place(hash_table *ht, size_t new_capacity) {
+  const size_t old_capacity = ht->capacity;
+  if (ht->entries_mapped == 0 || new_capacity >= old_capacity ||
+      ht->count > old_capacity - new_capacity) {
+    return false;
+  }
+
+  size_t top = old_capacity;
+  for (size_t i = old_capacity; i-- > 0;) {
+    ht_entry *r = ht->entries[i];
+    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
+      ht->entries[--top] = r;
+    }
+  }
+
+  memset(ht->entries, 0, sizeof(ht_entry *) * new_capacity);
+
+  // The occupied bucket list holds a node per entry, so its nodes are
+  // re-pointed at the new slots in turn
+  node_t *node = ht->occupied_buckets;
+  for (size_t i = top; i < old_capacity; i++) {
+    node->value = ht_place_entry(ht, ht->entries, new_capacity, ht->entries[i]);
+    node = node->next;
+  }
+
+  slots_trim(ht->entries, sizeof(ht_entry *) * new_capacity,
+             ht->entries_mapped);
+  return true;
+}
+
+/**
+ * Rebuild an ordered table with a hash index of the given capacity. Live
+ * entries are packed into a new dense array in their existing order, leaving
+ * behind the gaps of deleted ones, and the index is rebuilt alongside at
+ * whatever width the new array needs.
+ *
+ * @param ht
+ * @param new_capacity
+ */
+static void ht_ordered_rebuild(hash_table *ht, size_t new_capacity) {
+  ht_entry **old_entries = ht->entries;
+  const size_t old_used = ht->ordered_used;
+  const size_t num_slots = ht_ordered_slots(new_capacity);
+
+  size_t new_mapped;
+  ht_entry **new_entries = ht_slots_alloc(ht, num_slots, &new_mapped);
+
+  free(ht->ordered_index);
+  ht->ordered_width = ht_ordered_width(num_slots);
+  ht->ordered_index = calloc(new_capacity, ht->ordered_width);
+  STATS_ALLOC(ht->counters, (size_t)ht->ordered_width * new_capacity);
+
+  size_t used = 0;
+  for (size_t i = 0; i < old_used; i++) {
+    ht_entry *r = old_entries[i];
+    if (r == NULL) {
+      continue;
+    }
+
+    // As in `ht_place_entry`, the first empty slot is the key's home
+    const h_probe probe = ht_probe(ht, r->key, new_capacity);
+    size_t attempt = 0;
+    size_t idx = h_probe_at(probe, new_capacity, attempt);
+    while (ht_index_get(ht, idx) != 0) {
+      idx = h_probe_at(probe, new_capacity, ++attempt);
+    }
+
+    new_entries[used++] = r;
+    ht_index_set(ht, idx, used);
+  }
+
+  slots_release(&ht->spare_slots, &ht->spare_mapped, old_entries,
+                ht->entries_mapped);
+  ht->entries = new_entries;
+  ht->entries_mapped = new_mapped;
+  ht->ordered_used = used;
+}
+
 /**
  * Resize the hash table. This implementation has a set capacity;
  * hash collisions rise beyond the capacity and `ht_insert` will fail.
  * To mitigate this, we resize up if the load (measured as the ratio of
  * entries count to capacity) is less than .1, or down if the load exceeds
- * .7. To resize, we create a new table approx. 1/2x or 2x times the current
- * table size, then insert into it all non-deleted entries.
+ * .7. To resize, we allocate a new slot array approx. 1/2x or 2x times the
+ * current table size, then move into it all non-deleted entries. Entries are
+ * moved rather than copied, so their keys and values are never reallocated.
+ * Mapped slot arrays are instead shrunk in place, and the array a resize
+ * releases is kept for reuse by the next.
+ *
+ * Large tables whose `resize_threads` is not 1 are rehashed in parallel. A
+ * table in the small layout is moved to the hashed one; one in the ordered
+ * layout is rebuilt in order.
  *
  * @param ht
  * @param base_capacity
  * @return int
  */
-static void ht_resize(hash_table *ht, int base_capacity) {
+static void ht_resize(hash_table *ht, size_t base_capacity) {
   if (base_capacity < HT_DEFAULT_CAPACITY) {
     base_capacity = HT_DEFAULT_CAPACITY;
   }
 
-  hash_table *new_ht = ht_init(base_capacity, ht->free_value);
-
-  for (unsigned int i = 0; i < ht->capacity; i++) {
-    ht_entry *r = ht->entries[i];
-    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
-      __ht_insert(new_ht, r->key, r->value);
-    }
-  }
+  const uint64_t started = STATS_NOW();
+  const size_t new_capacity = next_prime(base_capacity);
+  const size_t old_capacity = ht->capacity;
 
-  ht->base_capacity = new_ht->base_capacity;
-  ht->capacity = new_ht->capacity;
-  ht->count = new_ht->count;
+  if (ht_is_ordered(ht)) {
+    ht_ordered_rebuild(ht, new_capacity);
+  } else if (!ht_shrink_in_place(ht, new_capacity)) {
+    size_t new_mapped;
+    ht_entry **new_entries = ht_slots_alloc(ht, new_capacity, &new_mapped);
 
-  // Cannot free values - we may still be using them.
-  ht_entry **tmp_entries = ht->entries;
-  ht->entries = new_ht->entries;
-  free(tmp_entries);
+    const unsigned int num_workers = parallel_num_workers(ht->resize_threads);
+    if (ht_is_small(ht)) {
+      // The small layout keeps no bucket list, so one is built as entries
+      // move; oldest first, leaving the most recent at its head
+      for (unsigned int i = 0; i < ht->small_used; i++) {
+        if (ht->entries[i] != NULL) {
+          list_prepend(&ht->occupied_buckets,
+                       ht_place_entry(ht, new_entries, new_capacity,
+                                      ht->entries[i]));
+          STATS_ALLOC(ht->counters, sizeof(node_t));
+        }
+      }
+      ht->small_tags = 0;
+      ht->small_used = 0;
+    } else if (num_workers > 1 && ht->count >= HT_PARALLEL_RESIZE_MIN) {
+      ht_resize_parallel(ht, new_entries, new_capacity, num_workers);
+    } else {
+      // Re-point the existing bucket list at the new slots; no reallocation
+      for (node_t *head = ht->occupied_buckets; !list_is_sentinel_node(head);
+           head = head->next) {
+        head->value = ht_place_entry(ht, new_entries, new_capacity,
+                                     ht->entries[head->value]);
+      }
+    }
 
-  // TODO: Figure out why list_free doesnt work but this does
-  node_t *head = ht->occupied_buckets;
-  node_t *tmp;
+    slots_release(&ht->spare_slots, &ht->spare_mapped, ht->entries,
+                  ht->entries_mapped);
+    ht->entries = new_entries;
+    ht->entries_mapped = new_mapped;
+  }
 
-  while (!list_is_sentinel_node(head)) {
-    tmp = head;
-    head = head->next;
-    free(tmp);
+  ht->base_capacity = base_capacity;
+  ht->capacity = new_capacity;
+  ht->deleted = 0;
+  // A rehash at the same size leaves cursors where they are; see `ht_cursor`
+  if (new_capacity != old_capacity) {
+    ht->generation++;
   }
+  STATS_RESIZED(ht->counters, started);
+}
 
-  ht->occupied_buckets = new_ht->occupied_buckets;
+/**
+ * Compute the table's load as a percentage of its capacity. The product is
+ * taken in 64 bits, so it cannot overflow however many entries are stored.
+ *
+ * @param ht
+ * @return unsigned int
+ */
+static unsigned int ht_load(const hash_table *ht) {
+  return (unsigned int)((uint64_t)ht->count * 100 / ht->capacity);
+}
 
-  free(new_ht);
+/**
+ * Compute the share of the table's slots, as a percentage, which probes must
+ * pass over: those holding entries and those left deleted
+ *
+ * @param ht
+ * @return unsigned int
+ */
+static unsigned int ht_used_load(const hash_table *ht) {
+  return (unsigned int)((uint64_t)(ht->count + ht->deleted) * 100 /
+                        ht->capacity);
 }
 
 /**
@@ -70,7 +674,7 @@ static void ht_resize(hash_table *ht, int base_capacity) {
  * @param ht
  */
 static void ht_resize_up(hash_table *ht) {
-  const unsigned int new_capacity = ht->base_capacity * 2;
+  const size_t new_capacity = ht->base_capacity * 2;
   ht_resize(ht, new_capacity);
 }
 
@@ -81,7 +685,16 @@ static void ht_resize_up(hash_table *ht) {
  * @param ht
  */
 static void ht_resize_down(hash_table *ht) {
-  const unsigned int new_capacity = ht->base_capacity / 2;
+  size_t new_capacity = ht->base_capacity / 2;
+  if (new_capacity < HT_DEFAULT_CAPACITY) {
+    new_capacity = HT_DEFAULT_CAPACITY;
+  }
+
+  // Already at the minimum capacity; a rehash would only move the entries
+  if (next_prime(new_capacity) == ht->capacity) {
+    return;
+  }
+
   ht_resize(ht, new_capacity);
 }
 
@@ -97,82 +710,485 @@ static ht_entry *ht_entry_init(const char *k, void *v) {
   r->key = strdup(k);
   r->value = v;
 
-  return r;
+  return r;
+}
+
+/**
+ * Initialize a new entry for a table with expiry enabled. The entry's timer
+ * starts out unscheduled.
+ *
+ * @param k entry key
+ * @param v entry value
+ * @return ht_entry*
+ */
+static ht_entry *ht_ttl_entry_init(const char *k, void *v) {
+  ht_ttl_entry *r = malloc(sizeof(ht_ttl_entry));
+  r->entry.key = strdup(k);
+  r->entry.value = v;
+  r->timer.expires = 0;
+
+  return &r->entry;
+}
+
+/**
+ * Offset of an inline value within its entry: past the entry, aligned for any
+ * type the value may hold
+ */
+#define HT_INLINE_OFFSET                            \
+  ((sizeof(ht_entry) + _Alignof(max_align_t) - 1) / \
+   _Alignof(max_align_t) * _Alignof(max_align_t))
+
+/**
+ * Initialize a new entry for a table with inline values, the value copied
+ * into the same allocation as the entry
+ *
+ * @param ht
+ * @param k entry key
+ * @param v `ht->value_size` bytes to copy, or NULL to zero the value
+ * @return ht_entry*
+ */
+static ht_entry *ht_inline_entry_init(const hash_table *ht, const char *k,
+                                      const void *v) {
+  ht_entry *r = malloc(HT_INLINE_OFFSET + ht->value_size);
+  r->key = strdup(k);
+  r->value = (char *)r + HT_INLINE_OFFSET;
+  if (v != NULL) {
+    memcpy(r->value, v, ht->value_size);
+  } else {
+    memset(r->value, 0, ht->value_size);
+  }
+
+  return r;
+}
+
+/**
+ * Delete a entry and deallocate its memory
+ *
+ * @param r entry to delete
+ */
+static void ht_delete_entry(ht_entry *r, free_fn *maybe_free_value) {
+  free(r->key);
+  if (maybe_free_value && r->value) {
+    maybe_free_value(r->value);
+    r->value = NULL;
+  }
+  free(r);
+}
+
+static tw_timer *ht_entry_timer(ht_entry *r) {
+  return &((ht_ttl_entry *)r)->timer;
+}
+
+/**
+ * Unschedule the expiry of an entry which is being removed
+ *
+ * @param ht
+ * @param r
+ */
+static void ht_cancel_expiry(hash_table *ht, ht_entry *r) {
+  if (ht->expiry != NULL) {
+    tw_cancel(&ht->expiry->wheel, ht_entry_timer(r));
+  }
+}
+
+/**
+ * Determine whether the given entry's time to live has elapsed
+ *
+ * @param ht
+ * @param r
+ * @return bool
+ */
+static bool ht_is_expired(hash_table *ht, ht_entry *r) {
+  if (ht->expiry == NULL) {
+    return false;
+  }
+
+  const uint64_t expires = ht_entry_timer(r)->expires;
+
+  return expires != 0 && expires <= ht->expiry->clock();
+}
+
+typedef struct {
+  const char **keys;
+  void **values;
+  build_partition *bp;
+  _Atomic(ht_entry *) *slots;
+  size_t capacity;
+  atomic_uint next_partition;
+  size_t *counts;
+  node_t **heads;
+  node_t **tails;
+} ht_build_task;
+
+/**
+ * Bulk build worker. Claims partitions one at a time and places their
+ * entries; a slot is claimed with a compare-and-swap because probe sequences
+ * may leave the partition's region, but no two partitions share a key, so a
+ * lost race only ever means moving on to the next probe. Duplicate keys
+ * within a partition are applied in order, the last value winning.
+ *
+ * @param arg
+ * @param worker
+ */
+static void ht_build_worker(void *arg, unsigned int worker) {
+  ht_build_task *task = arg;
+  build_partition *bp = task->bp;
+  node_t *head = list_create_sentinel_node();
+  node_t *tail = NULL;
+  size_t count = 0;
+
+  for (;;) {
+    const unsigned int p = atomic_fetch_add(&task->next_partition, 1);
+    if (p >= bp->num_partitions) {
+      break;
+    }
+
+    for (size_t j = bp->offsets[p]; j < bp->offsets[p + 1]; j++) {
+      const char *key = task->keys[bp->order[j]];
+      void *value = task->values ? task->values[bp->order[j]] : NULL;
+      ht_entry *new_entry = NULL;
+
+      const h_probe probe = bp->probes[bp->order[j]];
+
+      size_t i = 0;
+      size_t idx = probe.hash_a;
+      for (;;) {
+        ht_entry *current_entry =
+            atomic_load_explicit(&task->slots[idx], memory_order_acquire);
+
+        if (current_entry == NULL) {
+          if (new_entry == NULL) {
+            new_entry = ht_entry_init(key, value);
+          }
+
+          if (atomic_compare_exchange_strong_explicit(
+                  &task->slots[idx], &current_entry, new_entry,
+                  memory_order_release, memory_order_acquire)) {
+            list_prepend(&head, idx);
+            if (tail == NULL) {
+              tail = head;
+            }
+            count++;
+            break;
+          }
+        }
+
+        // Only this worker can hold an entry with the same key
+        if (strcmp(current_entry->key, key) == 0) {
+          current_entry->value = value;
+          if (new_entry != NULL) {
+            ht_delete_entry(new_entry, NULL);
+          }
+          break;
+        }
+
+        idx = h_probe_at(probe, task->capacity, ++i);
+      }
+    }
+  }
+
+  task->counts[worker] = count;
+  task->heads[worker] = head;
+  task->tails[worker] = tail;
+}
+
+/**
+ * Respond to an insertion whose probe sequence ran past abnormally many keys.
+ * Deleted slots are not counted, so the keys collide under the hash itself,
+ * and rehashing under the same hash would only rebuild the same chains. The
+ * unseeded hashes can be inverted, so the table moves to a keyed hash
+ * instead. A seeded table is re-seeded, unless it was only just rehashed, in
+ * which case the long sequence is put down to chance.
+ *
+ * @param ht
+ */
+static void ht_probe_watchdog(hash_table *ht) {
+  if (ht->hash_mode == HT_HASH_SEEDED &&
+      ht->inserts_since_rehash < ht->count) {
+    return;
+  }
+
+  ht_set_hash_mode(ht, HT_HASH_SEEDED);
+}
+
+/**
+ * Insert an entry into a table in the small layout, replacing the entry of the
+ * same key if there is one. Gaps left by deletions are closed once the
+ * appended entries reach the last slot.
+ *
+ * @param ht
+ * @param key
+ * @param new_entry
+ * @return bool false if every slot holds an entry, and the table must move to
+ * the hashed layout first
+ */
+static bool ht_small_insert(hash_table *ht, const char *key,
+                            ht_entry *new_entry) {
+  const uint8_t tag = small_tag(key);
+  const unsigned int idx = ht_small_find(ht, key, tag);
+
+  if (idx < HT_SMALL_CAPACITY) {
+    ht_cancel_expiry(ht, ht->entries[idx]);
+    ht_delete_entry(ht->entries[idx], NULL);
+    ht->entries[idx] = new_entry;
+    return true;
+  }
+
+  if (ht->small_used == HT_SMALL_CAPACITY) {
+    if (ht->count == HT_SMALL_CAPACITY) {
+      return false;
+    }
+    ht_small_compact(ht);
+  }
+
+  ht->entries[ht->small_used] = new_entry;
+  ht->small_tags = small_set_tag(ht->small_tags, ht->small_used, tag);
+  ht->small_used++;
+  ht->count++;
+  ht->inserts_since_rehash++;
+
+  return true;
+}
+
+/**
+ * Delete a key from a table in the small layout
+ *
+ * @param ht
+ * @param key
+ * @return int 1 if the key was deleted, 0 if absent
+ */
+static int ht_small_delete(hash_table *ht, const char *key) {
+  const unsigned int idx = ht_small_find(ht, key, small_tag(key));
+  if (idx == HT_SMALL_CAPACITY) {
+    return 0;
+  }
+
+  ht_cancel_expiry(ht, ht->entries[idx]);
+  ht_delete_entry(ht->entries[idx], ht->free_value);
+  ht->entries[idx] = NULL;
+  ht->small_tags = small_set_tag(ht->small_tags, idx, 0);
+  ht->count--;
+
+  // Trailing gaps are given back to the next insertion
+  while (ht->small_used > 0 && ht->entries[ht->small_used - 1] == NULL) {
+    ht->small_used--;
+  }
+
+  return 1;
+}
+
+/**
+ * Insert an entry into a table in the ordered layout, which must have room
+ * for it in its dense array. A replaced entry keeps its position.
+ *
+ * @param ht
+ * @param key
+ * @param new_entry
+ * @return ht_entry* `new_entry`
+ */
+static ht_entry *ht_ordered_insert(hash_table *ht, const char *key,
+                                   ht_entry *new_entry) {
+  const h_probe probe = ht_probe(ht, key, ht->capacity);
+  const size_t deleted = ht_ordered_deleted(ht);
+  bool has_free_idx = false;
+  size_t free_idx = 0;
+  size_t collisions = 0;
+
+  size_t i = 0;
+  size_t idx = h_probe_at(probe, ht->capacity, i);
+  for (size_t pos; (pos = ht_index_get(ht, idx)) != 0;) {
+    if (pos == deleted) {
+      if (!has_free_idx) {
+        has_free_idx = true;
+        free_idx = idx;
+      }
+    } else if (strcmp(ht->entries[pos - 1]->key, key) == 0) {
+      ht_cancel_expiry(ht, ht->entries[pos - 1]);
+      ht_delete_entry(ht->entries[pos - 1], NULL);
+      ht->entries[pos - 1] = new_entry;
+      return new_entry;
+    } else {
+      collisions++;
+    }
+
+    idx = h_probe_at(probe, ht->capacity, ++i);
+  }
+
+  if (has_free_idx) {
+    idx = free_idx;
+    ht->deleted--;
+  }
+
+  ht->entries[ht->ordered_used++] = new_entry;
+  ht_index_set(ht, idx, ht->ordered_used);
+  ht->count++;
+  ht->inserts_since_rehash++;
+
+  if (collisions > HT_WATCHDOG_PROBES) {
+    ht_probe_watchdog(ht);
+  }
+
+  return new_entry;
 }
 
 /**
- * Delete a entry and deallocate its memory
+ * Delete a key from a table in the ordered layout
  *
- * @param r entry to delete
+ * @param ht
+ * @param key
+ * @return int 1 if the key was deleted, 0 if absent
  */
-static void ht_delete_entry(ht_entry *r, free_fn *maybe_free_value) {
-  free(r->key);
-  if (maybe_free_value && r->value) {
-    maybe_free_value(r->value);
-    r->value = NULL;
+static int ht_ordered_delete(hash_table *ht, const char *key) {
+  const size_t idx = ht_ordered_lookup(ht, key);
+  if (idx == HT_NOT_FOUND) {
+    return 0;
   }
-  free(r);
+
+  const size_t pos = ht_index_get(ht, idx) - 1;
+  ht_cancel_expiry(ht, ht->entries[pos]);
+  ht_delete_entry(ht->entries[pos], ht->free_value);
+  ht->entries[pos] = NULL;
+  ht_index_set(ht, idx, ht_ordered_deleted(ht));
+  ht->count--;
+  ht->deleted++;
+
+  // Trailing gaps are given back to the next insertion
+  while (ht->ordered_used > 0 && ht->entries[ht->ordered_used - 1] == NULL) {
+    ht->ordered_used--;
+  }
+
+  return 1;
 }
 
-static void __ht_insert(hash_table *ht, const char *key, void *value) {
+static ht_entry *__ht_insert(hash_table *ht, const char *key, void *value) {
   if (ht == NULL) {
-    return;
+    return NULL;
+  }
+
+  ht_entry *new_entry;
+  if (ht->value_size > 0) {
+    new_entry = ht_inline_entry_init(ht, key, value);
+    STATS_ALLOC(ht->counters, HT_INLINE_OFFSET + ht->value_size);
+  } else if (ht->expiry != NULL) {
+    new_entry = ht_ttl_entry_init(key, value);
+    STATS_ALLOC(ht->counters, sizeof(ht_ttl_entry));
+  } else {
+    new_entry = ht_entry_init(key, value);
+    STATS_ALLOC(ht->counters, sizeof(ht_entry));
   }
+  STATS_ALLOC(ht->counters, strlen(key) + 1);
+
+  if (ht_is_small(ht)) {
+    if (ht_small_insert(ht, key, new_entry)) {
+      return new_entry;
+    }
 
-  const unsigned int load = ht->count * 100 / ht->capacity;
-  if (load > 70) {
-    ht_resize_up(ht);
+    // Outgrown; move to the hashed layout at the default capacity
+    ht_resize(ht, ht->base_capacity);
+  } else if (ht_used_load(ht) > 70) {
+    // Grow only if entries, rather than deleted slots, are what fill the
+    // array, and fill enough of it that the grown table is not shrunk again
+    // at the next deletion; otherwise rehash at the same size to clear the
+    // deleted slots
+    if (ht_load(ht) > 60) {
+      ht_resize_up(ht);
+    } else {
+      ht_resize(ht, ht->base_capacity);
+    }
+  } else if (ht_is_ordered(ht) && ht->ordered_used == ht_num_slots(ht)) {
+    // The dense array is full of gaps; squeeze them out
+    ht_resize(ht, ht->base_capacity);
   }
 
-  ht_entry *new_entry = ht_entry_init(key, value);
+  if (ht_is_ordered(ht)) {
+    return ht_ordered_insert(ht, key, new_entry);
+  }
 
-  unsigned int idx = h_compute_hash(new_entry->key, ht->capacity, 0);
+  const h_probe probe = ht_probe(ht, key, ht->capacity);
+  size_t i = 0;
+  size_t idx = h_probe_at(probe, ht->capacity, i);
   ht_entry *current_entry = ht->entries[idx];
   // If there was a hash collision, we need to perform double hashing and
   // partial linear probing by incrementing this index and hashing it until we
-  // find a bucket.
-  unsigned int i = 1;
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    // If the keys match, then we've inserted this key before. Use this bucket.
-    if (strcmp(current_entry->key, key) == 0) {
+  // find a bucket. Deleted entries don't end the search - the key may still
+  // live further along - but the first one is remembered so it can be reused.
+  bool has_free_idx = false;
+  size_t free_idx = 0;
+  size_t collisions = 0;
+  while (current_entry != NULL && i < ht->capacity) {
+    if (current_entry == &HT_SENTINEL_ENTRY) {
+      if (!has_free_idx) {
+        has_free_idx = true;
+        free_idx = idx;
+      }
+    } else if (strcmp(current_entry->key, key) == 0) {
+      // If the keys match, then we've inserted this key before. Use this
+      // bucket.
+      ht_cancel_expiry(ht, current_entry);
       ht_delete_entry(current_entry, NULL);
       ht->entries[idx] = new_entry;
-      return;
+      return new_entry;
+    } else {
+      collisions++;
     }
 
-    idx = h_compute_hash(new_entry->key, ht->capacity, i);
+    idx = h_probe_at(probe, ht->capacity, ++i);
     current_entry = ht->entries[idx];
-    i++;
+  }
+
+  if (has_free_idx) {
+    idx = free_idx;
+    ht->deleted--;
   }
 
   ht->entries[idx] = new_entry;
   list_prepend(&ht->occupied_buckets, idx);
+  STATS_ALLOC(ht->counters, sizeof(node_t));
   ht->count++;
+  ht->inserts_since_rehash++;
+
+  if (collisions > HT_WATCHDOG_PROBES) {
+    ht_probe_watchdog(ht);
+  }
+
+  return new_entry;
 }
 
 static int __ht_delete(hash_table *ht, const char *key) {
-  const unsigned int load = ht->count * 100 / ht->capacity;
+  // A table never moves back to the small layout, which saves nothing once
+  // it has held enough keys to leave it
+  if (ht_is_small(ht)) {
+    return ht_small_delete(ht, key);
+  }
 
   // TODO: const
-  if (load < 30) {
+  if (ht_load(ht) < 30) {
     ht_resize_down(ht);
   }
 
-  unsigned int i = 0;
-  unsigned int idx = h_compute_hash(key, ht->capacity, i);
+  if (ht_is_ordered(ht)) {
+    return ht_ordered_delete(ht, key);
+  }
+
+  const h_probe probe = ht_probe(ht, key, ht->capacity);
+  size_t i = 0;
+  size_t idx = h_probe_at(probe, ht->capacity, i);
 
   ht_entry *current_entry = ht->entries[idx];
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    if (strcmp(current_entry->key, key) == 0) {
+  while (current_entry != NULL && i < ht->capacity) {
+    if (current_entry != &HT_SENTINEL_ENTRY &&
+        strcmp(current_entry->key, key) == 0) {
+      ht_cancel_expiry(ht, current_entry);
       ht_delete_entry(current_entry, ht->free_value);
       ht->entries[idx] = &HT_SENTINEL_ENTRY;
       list_remove(&ht->occupied_buckets, idx);
       ht->count--;
+      ht->deleted++;
 
       return 1;
     }
 
-    idx = h_compute_hash(key, ht->capacity, ++i);
+    idx = h_probe_at(probe, ht->capacity, ++i);
     current_entry = ht->entries[idx];
   }
 
@@ -180,7 +1196,7 @@ static int __ht_delete(hash_table *ht, const char *key) {
 }
 
 static void __ht_delete_table(hash_table *ht) {
-  for (unsigned int i = 0; i < ht->capacity; i++) {
+  for (size_t i = 0; i < ht_num_slots(ht); i++) {
     ht_entry *r = ht->entries[i];
 
     if (r != NULL && r != &HT_SENTINEL_ENTRY) {
@@ -188,11 +1204,25 @@ static void __ht_delete_table(hash_table *ht) {
     }
   }
 
-  free(ht->entries);
+  list_free(ht->occupied_buckets);
+  free(ht->expiry);
+  free(ht->ordered_index);
+  slots_free(ht->entries, ht->entries_mapped);
+  slots_free(ht->spare_slots, ht->spare_mapped);
   free(ht);
 }
 
-hash_table *ht_init(int base_capacity, free_fn *free_value) {
+/**
+ * Allocate an empty table
+ *
+ * @param base_capacity
+ * @param layout A table starting in the small layout moves to the hashed one
+ * at `base_capacity`
+ * @param free_value
+ * @return hash_table*
+ */
+static hash_table *ht_create(size_t base_capacity, ht_layout layout,
+                             free_fn *free_value) {
   if (base_capacity < HT_DEFAULT_CAPACITY) {
     base_capacity = HT_DEFAULT_CAPACITY;
   }
@@ -200,11 +1230,56 @@ hash_table *ht_init(int base_capacity, free_fn *free_value) {
   hash_table *ht = malloc(sizeof(hash_table));
   ht->base_capacity = base_capacity;
 
-  ht->capacity = next_prime(ht->base_capacity);
+  ht->capacity = layout == HT_LAYOUT_SMALL ? HT_SMALL_CAPACITY
+                                           : next_prime(ht->base_capacity);
   ht->count = 0;
-  ht->entries = calloc((size_t)ht->capacity, sizeof(ht_entry *));
+  ht->deleted = 0;
+  ht->counters = (ht_counters){0};
+  ht->ordered_index = NULL;
+  ht->ordered_width = 0;
+  ht->ordered_used = 0;
+  if (layout == HT_LAYOUT_ORDERED) {
+    ht->ordered_width = ht_ordered_width(ht_ordered_slots(ht->capacity));
+    ht->ordered_index = calloc(ht->capacity, ht->ordered_width);
+    STATS_ALLOC(ht->counters, (size_t)ht->ordered_width * ht->capacity);
+  }
+  ht->mem_flags = HT_MEM_DEFAULT;
+  ht->numa_node = -1;
+  ht->spare_slots = NULL;
+  ht->spare_mapped = 0;
+  ht->entries = slots_alloc(sizeof(ht_entry *) * ht_num_slots(ht),
+                            ht->mem_flags, ht->numa_node, &ht->entries_mapped);
   ht->free_value = free_value;
   ht->occupied_buckets = list_create_sentinel_node();
+  ht->resize_threads = 1;
+  ht->generation = 0;
+  ht->expiry = NULL;
+  STATS_ALLOC(ht->counters, sizeof(ht_entry *) * ht_num_slots(ht));
+  ht->hash_mode = HT_HASH_DEFAULT;
+  ht->seed[0] = 0;
+  ht->seed[1] = 0;
+  ht->inserts_since_rehash = 0;
+  ht->small_tags = 0;
+  ht->small_used = 0;
+  ht->value_size = 0;
+  return ht;
+}
+
+hash_table *ht_init(size_t base_capacity, free_fn *free_value) {
+  return ht_create(base_capacity,
+                   base_capacity <= HT_DEFAULT_CAPACITY ? HT_LAYOUT_SMALL
+                                                        : HT_LAYOUT_HASHED,
+                   free_value);
+}
+
+hash_table *ht_init_ordered(size_t base_capacity, free_fn *free_value) {
+  return ht_create(base_capacity, HT_LAYOUT_ORDERED, free_value);
+}
+
+hash_table *ht_init_inline(size_t base_capacity, size_t value_size) {
+  hash_table *ht = ht_init(base_capacity, NULL);
+  ht->value_size = value_size;
+
   return ht;
 }
 
@@ -212,19 +1287,79 @@ void ht_insert(hash_table *ht, const char *key, void *value) {
   __ht_insert(ht, key, value);
 }
 
+/**
+ * Variant of `ht_search` for a table in the small layout
+ *
+ * @param ht
+ * @param key
+ * @return ht_entry*
+ */
+static ht_entry *ht_small_search(hash_table *ht, const char *key) {
+  const unsigned int idx = ht_small_find(ht, key, small_tag(key));
+  if (idx == HT_SMALL_CAPACITY) {
+    return NULL;
+  }
+
+  ht_entry *r = ht->entries[idx];
+  if (ht_is_expired(ht, r)) {
+    ht_small_delete(ht, key);
+    return NULL;
+  }
+
+  return r;
+}
+
+/**
+ * Variant of `ht_search` for a table in the ordered layout
+ *
+ * @param ht
+ * @param key
+ * @return ht_entry*
+ */
+static ht_entry *ht_ordered_search(hash_table *ht, const char *key) {
+  const size_t idx = ht_ordered_lookup(ht, key);
+  if (idx == HT_NOT_FOUND) {
+    return NULL;
+  }
+
+  ht_entry *r = ht->entries[ht_index_get(ht, idx) - 1];
+  if (ht_is_expired(ht, r)) {
+    __ht_delete(ht, key);
+    return NULL;
+  }
+
+  return r;
+}
+
 ht_entry *ht_search(hash_table *ht, const char *key) {
-  unsigned int idx = h_compute_hash(key, ht->capacity, 0);
+  if (ht_is_small(ht)) {
+    return ht_small_search(ht, key);
+  }
+
+  if (ht_is_ordered(ht)) {
+    return ht_ordered_search(ht, key);
+  }
+
+  const h_probe probe = ht_probe(ht, key, ht->capacity);
+  size_t idx = h_probe_at(probe, ht->capacity, 0);
 
   ht_entry *current_entry = ht->entries[idx];
 
-  unsigned int i = 1;
+  size_t i = 1;
+
+  while (current_entry != NULL && i <= ht->capacity) {
+    if (current_entry != &HT_SENTINEL_ENTRY &&
+        strcmp(current_entry->key, key) == 0) {
+      // Expire lazily, should the entry's timer not have been reached yet
+      if (ht_is_expired(ht, current_entry)) {
+        __ht_delete(ht, key);
+        return NULL;
+      }
 
-  while (current_entry != NULL && current_entry != &HT_SENTINEL_ENTRY) {
-    if (strcmp(current_entry->key, key) == 0) {
       return current_entry;
     }
 
-    idx = h_compute_hash(key, ht->capacity, i);
+    idx = h_probe_at(probe, ht->capacity, i);
     current_entry = ht->entries[idx];
     i++;
   }
@@ -237,6 +1372,497 @@ void *ht_get(hash_table *ht, const char *key) {
   return r ? r->value : NULL;
 }
 
+typedef struct {
+  hash_table *ht;
+  ht_visit_fn *visit;
+  ht_reduce_fn *reduce;
+  void *ctx;
+  void *init_acc;
+  size_t acc_size;
+  void **accs;
+  atomic_size_t next_slot;
+} ht_scan_task;
+
+/**
+ * Parallel scan worker. Claims chunks of the slot array until none remain,
+ * either visiting each entry or folding it into the worker's own accumulator.
+ *
+ * @param arg
+ * @param worker
+ */
+static void ht_scan_worker(void *arg, unsigned int worker) {
+  ht_scan_task *task = arg;
+  void *acc = NULL;
+
+  if (task->reduce) {
+    acc = task->accs[worker] = malloc(task->acc_size);
+    memcpy(acc, task->init_acc, task->acc_size);
+  }
+
+  const size_t num_slots = ht_num_slots(task->ht);
+
+  for (;;) {
+    const size_t begin = atomic_fetch_add(&task->next_slot, HT_ITER_CHUNK);
+    if (begin >= num_slots) {
+      return;
+    }
+
+    const size_t end = begin + HT_ITER_CHUNK;
+    for (size_t i = begin; i < end && i < num_slots; i++) {
+      ht_entry *r = task->ht->entries[i];
+      if (r == NULL || r == &HT_SENTINEL_ENTRY) {
+        continue;
+      }
+
+      if (acc) {
+        task->reduce(acc, r, task->ctx);
+      } else {
+        task->visit(r, task->ctx);
+      }
+    }
+  }
+}
+
+/**
+ * Resolve the number of workers for a parallel scan; small tables are
+ * scanned on the calling thread.
+ *
+ * @param ht
+ * @param num_threads
+ * @return unsigned int
+ */
+static unsigned int ht_scan_workers(hash_table *ht, unsigned int num_threads) {
+  const size_t num_chunks =
+      (ht_num_slots(ht) + HT_ITER_CHUNK - 1) / HT_ITER_CHUNK;
+  const unsigned int num_workers = parallel_num_workers(num_threads);
+
+  return num_workers < num_chunks ? num_workers : (unsigned int)num_chunks;
+}
+
+hash_table *ht_build(const char **keys, void **values, size_t n,
+                     free_fn *free_value, unsigned int num_threads) {
+  hash_table *ht = ht_create(build_capacity(n), HT_LAYOUT_HASHED, free_value);
+  const unsigned int num_workers = build_num_workers(n, num_threads);
+
+  build_partition bp;
+  build_partition_keys(&bp, keys, n, ht->capacity, num_workers);
+
+  ht_build_task task = {
+      .keys = keys,
+      .values = values,
+      .bp = &bp,
+      // The array is only ever accessed atomically until the workers join
+      .slots = (_Atomic(ht_entry *) *)ht->entries,
+      .capacity = ht->capacity,
+      .counts = malloc(sizeof(size_t) * num_workers),
+      .heads = malloc(sizeof(node_t *) * num_workers),
+      .tails = malloc(sizeof(node_t *) * num_workers),
+  };
+  atomic_init(&task.next_partition, 0);
+
+  parallel_run(num_workers, ht_build_worker, &task);
+
+  for (unsigned int w = 0; w < num_workers; w++) {
+    ht->count += task.counts[w];
+  }
+  ht->occupied_buckets = ht_splice_buckets(task.heads, task.tails, num_workers);
+
+#ifdef LIBHASH_STATS
+  // The workers place entries without touching the table, so they are
+  // accounted for afterwards
+  for (node_t *head = ht->occupied_buckets; !list_is_sentinel_node(head);
+       head = head->next) {
+    STATS_ALLOC(ht->counters, sizeof(ht_entry));
+    STATS_ALLOC(ht->counters, strlen(ht->entries[head->value]->key) + 1);
+    STATS_ALLOC(ht->counters, sizeof(node_t));
+  }
+#endif
+
+  free(task.counts);
+  free(task.heads);
+  free(task.tails);
+  build_partition_free(&bp);
+
+  return ht;
+}
+
+void ht_for_each_range(hash_table *ht, size_t begin, size_t end,
+                       ht_visit_fn *visit, void *ctx) {
+  if (end > ht_num_slots(ht)) {
+    end = ht_num_slots(ht);
+  }
+
+  for (size_t i = begin; i < end; i++) {
+    ht_entry *r = ht->entries[i];
+
+    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
+      visit(r, ctx);
+    }
+  }
+}
+
+void ht_parallel_for_each(hash_table *ht, ht_visit_fn *visit, void *ctx,
+                          unsigned int num_threads) {
+  ht_scan_task task = {.ht = ht, .visit = visit, .ctx = ctx};
+  atomic_init(&task.next_slot, 0);
+
+  parallel_run(ht_scan_workers(ht, num_threads), ht_scan_worker, &task);
+}
+
+void ht_reduce(hash_table *ht, void *acc, size_t acc_size,
+               ht_reduce_fn *reduce, ht_combine_fn *combine, void *ctx,
+               unsigned int num_threads) {
+  const unsigned int num_workers = ht_scan_workers(ht, num_threads);
+
+  ht_scan_task task = {
+      .ht = ht,
+      .reduce = reduce,
+      .ctx = ctx,
+      .init_acc = acc,
+      .acc_size = acc_size,
+      .accs = malloc(sizeof(void *) * num_workers),
+  };
+  atomic_init(&task.next_slot, 0);
+
+  parallel_run(num_workers, ht_scan_worker, &task);
+
+  // `acc` still holds the initial value, which must be the identity of
+  // `combine`, so folding every partial result into it yields the total
+  for (unsigned int w = 0; w < num_workers; w++) {
+    combine(acc, task.accs[w], ctx);
+    free(task.accs[w]);
+  }
+
+  free(task.accs);
+}
+
+/**
+ * Bring a cursor up to date with the table, restarting it if the table has
+ * changed capacity or hash since the cursor last moved.
+ *
+ * @param ht
+ * @param cursor
+ * @return 1 if slots remain to be visited, 0 if the scan is complete
+ */
+static int ht_cursor_sync(hash_table *ht, ht_cursor *cursor) {
+  if (cursor->pos == HT_CURSOR_DONE) {
+    return 0;
+  }
+
+  // Slot positions don't survive a resize; start over in the new slot array
+  if (cursor->generation != ht->generation) {
+    cursor->pos = 0;
+    cursor->generation = ht->generation;
+  }
+
+  if (cursor->pos >= ht_num_slots(ht)) {
+    cursor->pos = HT_CURSOR_DONE;
+    return 0;
+  }
+
+  return 1;
+}
+
+void ht_cursor_init(hash_table *ht, ht_cursor *cursor) {
+  cursor->pos = 0;
+  cursor->generation = ht->generation;
+}
+
+ht_entry *ht_cursor_next(hash_table *ht, ht_cursor *cursor) {
+  while (ht_cursor_sync(ht, cursor)) {
+    ht_entry *r = ht->entries[cursor->pos++];
+
+    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
+      return r;
+    }
+  }
+
+  return NULL;
+}
+
+int ht_scan(hash_table *ht, ht_cursor *cursor, size_t budget,
+            ht_visit_fn *visit, void *ctx) {
+  for (size_t n = 0; n < budget && ht_cursor_sync(ht, cursor); n++) {
+    ht_entry *r = ht->entries[cursor->pos++];
+
+    if (r != NULL && r != &HT_SENTINEL_ENTRY) {
+      visit(r, ctx);
+    }
+  }
+
+  return ht_cursor_sync(ht, cursor);
+}
+
+ht_entry *ht_iter_next(hash_table *ht, node_t **head, size_t *slot) {
+  if (ht_is_small(ht)) {
+    // Walk down from the most recently filled slot, passing over gaps
+    while (*slot > 0) {
+      ht_entry *r = ht->entries[--*slot];
+      if (r != NULL) {
+        return r;
+      }
+    }
+
+    return NULL;
+  }
+
+  if (ht_is_ordered(ht)) {
+    // Walk up from the first position, where the oldest entry is
+    while (*slot < ht->ordered_used) {
+      ht_entry *r = ht->entries[(*slot)++];
+      if (r != NULL) {
+        return r;
+      }
+    }
+
+    return NULL;
+  }
+
+  if (list_is_sentinel_node(*head)) {
+    return NULL;
+  }
+
+  ht_entry *r = ht->entries[(*head)->value];
+  *head = (*head)->next;
+
+  return r;
+}
+
+int ht_save(hash_table *ht, const char *path, ht_value_size_fn *value_size) {
+  const size_t n = ht->count ? ht->count : 1;
+  const char **keys = malloc(sizeof(char *) * n);
+  const void **values = malloc(sizeof(void *) * n);
+  size_t *value_sizes = malloc(sizeof(size_t) * n);
+
+  size_t i = 0;
+  HT_ITER_START(ht)
+  keys[i] = entry->key;
+  values[i] = entry->value;
+  if (entry->value == NULL) {
+    value_sizes[i] = 0;
+  } else if (ht->value_size > 0) {
+    value_sizes[i] = ht->value_size;
+  } else if (value_size != NULL) {
+    value_sizes[i] = value_size(entry->value);
+  } else {
+    value_sizes[i] = strlen(entry->value) + 1;
+  }
+  i++;
+  HT_ITER_END
+
+  const int ok =
+      snapshot_write(path, SNAPSHOT_TABLE, keys, values, value_sizes, i);
+
+  free(value_sizes);
+  free(values);
+  free(keys);
+
+  return ok;
+}
+
+frozen_hash_table *ht_freeze(hash_table *ht) {
+  const size_t n = ht->count;
+  uint64_t *hashes = malloc(sizeof(uint64_t) * (n ? n : 1));
+  ht_entry **entries = malloc(sizeof(ht_entry *) * (n ? n : 1));
+
+  size_t i = 0;
+  HT_ITER_START(ht)
+  entries[i] = entry;
+  hashes[i] = h_hash_64(entry->key);
+  i++;
+  HT_ITER_END
+
+  frozen_hash_table *fht = malloc(sizeof(frozen_hash_table));
+  if (!ph_build(&fht->ph, hashes, n)) {
+    free(fht);
+    free(entries);
+    free(hashes);
+    return NULL;
+  }
+
+  fht->entries = malloc(sizeof(ht_entry *) * (n ? n : 1));
+  fht->free_value = ht->free_value;
+  for (i = 0; i < n; i++) {
+    fht->entries[ph_position(&fht->ph, hashes[i])] = entries[i];
+  }
+
+  // The entries now belong to the frozen table; their expiry is dropped
+  list_free(ht->occupied_buckets);
+  free(ht->expiry);
+  free(ht->ordered_index);
+  slots_free(ht->entries, ht->entries_mapped);
+  slots_free(ht->spare_slots, ht->spare_mapped);
+  free(ht);
+
+  free(entries);
+  free(hashes);
+
+  return fht;
+}
+
+ht_entry *fht_search(frozen_hash_table *fht, const char *key) {
+  if (fht->ph.n == 0) {
+    return NULL;
+  }
+
+  ht_entry *r = fht->entries[ph_position(&fht->ph, h_hash_64(key))];
+
+  return strcmp(r->key, key) == 0 ? r : NULL;
+}
+
+void *fht_get(frozen_hash_table *fht, const char *key) {
+  ht_entry *r = fht_search(fht, key);
+  return r ? r->value : NULL;
+}
+
+size_t fht_count(frozen_hash_table *fht) { return fht->ph.n; }
+
+void fht_delete_table(frozen_hash_table *fht) {
+  for (size_t i = 0; i < fht->ph.n; i++) {
+    ht_delete_entry(fht->entries[i], fht->free_value);
+  }
+
+  ph_free(&fht->ph);
+  free(fht->entries);
+  free(fht);
+}
+
+hash_table *ht_init_ttl(size_t base_capacity, free_fn *free_value,
+                        ht_clock_fn *clock) {
+  hash_table *ht = ht_init(base_capacity, free_value);
+
+  ht->expiry = malloc(sizeof(ht_expiry));
+  ht->expiry->clock = clock ? clock : tw_clock_ms;
+  tw_init(&ht->expiry->wheel, ht->expiry->clock());
+
+  return ht;
+}
+
+void ht_insert_ttl(hash_table *ht, const char *key, void *value,
+                   uint64_t ttl) {
+  ht_entry *r = __ht_insert(ht, key, value);
+
+  if (r != NULL && ht->expiry != NULL && ttl > 0) {
+    tw_schedule(&ht->expiry->wheel, ht_entry_timer(r),
+                ht->expiry->clock() + ttl);
+  }
+}
+
+unsigned int ht_expire_step(hash_table *ht, unsigned int budget) {
+  if (ht->expiry == NULL) {
+    return 0;
+  }
+
+  const uint64_t now = ht->expiry->clock();
+  unsigned int expired = 0;
+
+  tw_timer *timer;
+  while ((timer = tw_next_expired(&ht->expiry->wheel, now, &budget)) !=
+         NULL) {
+    ht_ttl_entry *r =
+        (ht_ttl_entry *)((char *)timer - offsetof(ht_ttl_entry, timer));
+    __ht_delete(ht, r->entry.key);
+    expired++;
+  }
+
+  return expired;
+}
+
+void ht_set_resize_threads(hash_table *ht, unsigned int num_threads) {
+  ht->resize_threads = num_threads;
+}
+
+void ht_set_hash_mode(hash_table *ht, ht_hash_mode mode) {
+  ht->hash_mode = mode;
+  if (mode == HT_HASH_SEEDED) {
+    h_random_seed(ht->seed);
+  }
+
+  // Rebuild the slot array at the same capacity, under the new hash. The
+  // small layout hashes nothing but tags, which don't depend on the mode.
+  if (!ht_is_small(ht)) {
+    ht_resize(ht, ht->base_capacity);
+    ht->generation++;
+  }
+  ht->inserts_since_rehash = 0;
+}
+
+void ht_set_memory_policy(hash_table *ht, unsigned int flags, int numa_node) {
+  ht->mem_flags = flags;
+  ht->numa_node = numa_node;
+
+  // The spare was allocated under the previous policy
+  slots_free(ht->spare_slots, ht->spare_mapped);
+  ht->spare_slots = NULL;
+  ht->spare_mapped = 0;
+
+  // The small layout's few slots stay on the heap; the policy takes effect
+  // once the table moves to the hashed layout
+  if (ht_is_small(ht)) {
+    return;
+  }
+
+  // The capacity is unchanged, so every entry keeps its slot
+  const size_t size = sizeof(ht_entry *) * ht_num_slots(ht);
+  size_t mapped;
+  ht_entry **entries = slots_alloc(size, flags, numa_node, &mapped);
+  STATS_ALLOC(ht->counters, size);
+  memcpy(entries, ht->entries, size);
+
+  slots_free(ht->entries, ht->entries_mapped);
+  ht->entries = entries;
+  ht->entries_mapped = mapped;
+}
+
+void ht_get_stats(hash_table *ht, ht_stats *stats) {
+  stats_begin(stats, ht->capacity, ht->count, &ht->counters);
+
+  if (ht_is_small(ht)) {
+    // Every key is found by the first comparison of tags; the gaps below
+    // the last filled slot are what deletions have left behind
+    for (unsigned int i = 0; i < ht->small_used; i++) {
+      if (ht->entries[i] == NULL) {
+        stats->tombstones++;
+      } else {
+        stats_add_displacement(stats, 0);
+      }
+    }
+
+    stats_end(stats);
+    return;
+  }
+
+  if (ht_is_ordered(ht)) {
+    const size_t deleted = ht_ordered_deleted(ht);
+
+    for (size_t i = 0; i < ht->capacity; i++) {
+      const size_t pos = ht_index_get(ht, i);
+
+      if (pos == deleted) {
+        stats->tombstones++;
+      } else if (pos != 0) {
+        const char *key = ht->entries[pos - 1]->key;
+        stats_add_key(stats, ht_probe(ht, key, ht->capacity), i);
+      }
+    }
+
+    stats_end(stats);
+    return;
+  }
+
+  for (size_t i = 0; i < ht->capacity; i++) {
+    ht_entry *r = ht->entries[i];
+
+    if (r == &HT_SENTINEL_ENTRY) {
+      stats->tombstones++;
+    } else if (r != NULL) {
+      stats_add_key(stats, ht_probe(ht, r->key, ht->capacity), i);
+    }
+  }
+
+  stats_end(stats);
+}
+
 void ht_delete_table(hash_table *ht) { __ht_delete_table(ht); }
 
 int ht_delete(hash_table *ht, const char *key) { return __ht_delete(ht, key); }
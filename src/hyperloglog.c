@@ -0,0 +1,547 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "libhash.h"
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+
+/**
+ * Precision of the sparse representation. Sparse entries index 2^25
+ * registers, far more than any dense sketch, so small cardinalities are
+ * estimated with almost no error.
+ */
+#define HLL_SPARSE_PRECISION 25
+
+/**
+ * Number of sparse entries buffered, unsorted, before they are merged into
+ * the sorted list
+ */
+#define HLL_SPARSE_BUFFER 256
+
+#define HLL_MAGIC "HLL1"
+#define HLL_HEADER_SIZE 10
+
+typedef enum {
+  HLL_SPARSE,
+  HLL_DENSE,
+} hll_encoding;
+
+struct hyperloglog {
+  unsigned int precision;
+  hll_encoding encoding;
+
+  /**
+   * One register per 2^precision, holding the highest rank seen (HLL_DENSE)
+   */
+  uint8_t *registers;
+
+  /**
+   * Sparse entries - a sparse register index in the high bits and its rank
+   * in the low 6 - sorted by index with one entry per index (HLL_SPARSE)
+   */
+  uint32_t *sparse;
+  unsigned int num_sparse;
+
+  /**
+   * Entries not yet merged into `sparse`
+   */
+  uint32_t buffer[HLL_SPARSE_BUFFER];
+  unsigned int num_buffered;
+};
+
+/**
+ * Rank of the bits following a register index: the position of their first
+ * set bit, counting from 1
+ *
+ * @param bits The bits, left-aligned
+ * @param width Number of meaningful bits
+ * @return unsigned int
+ */
+static unsigned int hll_rank(uint64_t bits, unsigned int width) {
+  unsigned int rank = 1;
+  while (rank <= width && !(bits & (1ULL << 63))) {
+    bits <<= 1;
+    rank++;
+  }
+
+  return rank;
+}
+
+static uint32_t hll_sparse_entry(uint64_t hash) {
+  const uint32_t idx = (uint32_t)(hash >> (64 - HLL_SPARSE_PRECISION));
+  const unsigned int rank = hll_rank(hash << HLL_SPARSE_PRECISION,
+                                     64 - HLL_SPARSE_PRECISION);
+
+  return idx << 6 | rank;
+}
+
+/**
+ * Fold a sparse entry into a dense register array. The register index is the
+ * top `precision` bits of the sparse index; if the remaining bits of the
+ * sparse index are all zero, the rank continues into the bits beyond it.
+ *
+ * @param hll
+ * @param entry
+ */
+static void hll_dense_apply(hyperloglog *hll, uint32_t entry) {
+  const unsigned int extra = HLL_SPARSE_PRECISION - hll->precision;
+  const uint32_t sparse_idx = entry >> 6;
+  const uint32_t low = sparse_idx & ((1U << extra) - 1);
+
+  unsigned int rank;
+  if (low != 0) {
+    rank = hll_rank((uint64_t)low << (64 - extra), extra);
+  } else {
+    rank = extra + (entry & 0x3f);
+  }
+
+  uint8_t *r = &hll->registers[sparse_idx >> extra];
+  if (rank > *r) {
+    *r = (uint8_t)rank;
+  }
+}
+
+static int hll_compare_entries(const void *a, const void *b) {
+  const uint32_t x = *(const uint32_t *)a;
+  const uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * Merge sorted entries into the sparse list, keeping the highest rank of
+ * each index
+ *
+ * @param hll
+ * @param entries
+ * @param n
+ */
+static void hll_sparse_merge(hyperloglog *hll, const uint32_t *entries,
+                             unsigned int n) {
+  uint32_t *merged = malloc(sizeof(uint32_t) * (hll->num_sparse + n + 1));
+  unsigned int size = 0;
+
+  unsigned int i = 0;
+  unsigned int j = 0;
+  while (i < hll->num_sparse || j < n) {
+    uint32_t next;
+    if (j == n || (i < hll->num_sparse && hll->sparse[i] < entries[j])) {
+      next = hll->sparse[i++];
+    } else {
+      next = entries[j++];
+    }
+
+    // Entries are ordered by index, then rank, so a later entry of the same
+    // index has the higher rank
+    if (size > 0 && merged[size - 1] >> 6 == next >> 6) {
+      merged[size - 1] = next;
+    } else {
+      merged[size++] = next;
+    }
+  }
+
+  free(hll->sparse);
+  hll->sparse = merged;
+  hll->num_sparse = size;
+}
+
+/**
+ * Convert a sparse sketch to the dense representation
+ *
+ * @param hll
+ */
+static void hll_densify(hyperloglog *hll) {
+  hll->registers = calloc((size_t)1 << hll->precision, 1);
+  hll->encoding = HLL_DENSE;
+
+  for (unsigned int i = 0; i < hll->num_sparse; i++) {
+    hll_dense_apply(hll, hll->sparse[i]);
+  }
+  for (unsigned int i = 0; i < hll->num_buffered; i++) {
+    hll_dense_apply(hll, hll->buffer[i]);
+  }
+
+  free(hll->sparse);
+  hll->sparse = NULL;
+  hll->num_sparse = 0;
+  hll->num_buffered = 0;
+}
+
+/**
+ * Merge buffered entries into the sparse list, switching to the dense
+ * representation once the list takes up more memory than it would
+ *
+ * @param hll
+ */
+static void hll_flush(hyperloglog *hll) {
+  if (hll->encoding != HLL_SPARSE || hll->num_buffered == 0) {
+    return;
+  }
+
+  qsort(hll->buffer, hll->num_buffered, sizeof(uint32_t),
+        hll_compare_entries);
+  hll_sparse_merge(hll, hll->buffer, hll->num_buffered);
+  hll->num_buffered = 0;
+
+  if (hll->num_sparse * sizeof(uint32_t) > (size_t)1 << hll->precision) {
+    hll_densify(hll);
+  }
+}
+
+/**
+ * Ertl's sigma function; see `hll_estimate_dense`
+ *
+ * @param x
+ * @return double
+ */
+static double hll_sigma(double x) {
+  if (x == 1) {
+    return INFINITY;
+  }
+
+  double y = 1;
+  double z = x;
+  double prev;
+  do {
+    x *= x;
+    prev = z;
+    z += x * y;
+    y += y;
+  } while (z != prev);
+
+  return z;
+}
+
+/**
+ * Ertl's tau function; see `hll_estimate_dense`
+ *
+ * @param x
+ * @return double
+ */
+static double hll_tau(double x) {
+  if (x == 0 || x == 1) {
+    return 0;
+  }
+
+  double y = 1;
+  double z = 1 - x;
+  double prev;
+  do {
+    x = sqrt(x);
+    prev = z;
+    y *= 0.5;
+    z -= (1 - x) * (1 - x) * y;
+  } while (z != prev);
+
+  return z / 3;
+}
+
+/**
+ * Estimate the cardinality of a dense sketch with Ertl's improved estimator,
+ * which works from the histogram of register values and corrects for both
+ * small and large cardinalities without the empirical bias tables of
+ * HyperLogLog++.
+ *
+ * @param hll
+ * @return double
+ */
+static double hll_estimate_dense(hyperloglog *hll) {
+  const unsigned int q = 64 - hll->precision;
+  const double m = (double)(1U << hll->precision);
+
+  unsigned int histogram[64 + 2] = {0};
+  for (unsigned int i = 0; i < 1U << hll->precision; i++) {
+    histogram[hll->registers[i]]++;
+  }
+
+  if (histogram[0] == m) {
+    return 0;
+  }
+
+  double z = m * hll_tau(1 - histogram[q + 1] / m);
+  for (unsigned int k = q; k >= 1; k--) {
+    z = 0.5 * (z + histogram[k]);
+  }
+  z += m * hll_sigma(histogram[0] / m);
+
+  return 0.5 / log(2) * m * m / z;
+}
+
+hyperloglog *hll_init(unsigned int precision) {
+  if (precision < HLL_MIN_PRECISION) {
+    precision = HLL_MIN_PRECISION;
+  } else if (precision > HLL_MAX_PRECISION) {
+    precision = HLL_MAX_PRECISION;
+  }
+
+  hyperloglog *hll = malloc(sizeof(hyperloglog));
+  hll->precision = precision;
+  hll->encoding = HLL_SPARSE;
+  hll->registers = NULL;
+  hll->sparse = NULL;
+  hll->num_sparse = 0;
+  hll->num_buffered = 0;
+
+  return hll;
+}
+
+void hll_add(hyperloglog *hll, const char *key) {
+  // Every add is recorded at the sparse precision; a dense sketch folds the
+  // entry into its coarser register right away
+  const uint32_t entry = hll_sparse_entry(h_hash_64(key));
+
+  if (hll->encoding == HLL_DENSE) {
+    hll_dense_apply(hll, entry);
+    return;
+  }
+
+  hll->buffer[hll->num_buffered++] = entry;
+  if (hll->num_buffered == HLL_SPARSE_BUFFER) {
+    hll_flush(hll);
+  }
+}
+
+uint64_t hll_count(hyperloglog *hll) {
+  hll_flush(hll);
+
+  if (hll->encoding == HLL_DENSE) {
+    return (uint64_t)llround(hll_estimate_dense(hll));
+  }
+
+  // Linear counting over the 2^25 sparse registers
+  const double m = (double)(1U << HLL_SPARSE_PRECISION);
+
+  return (uint64_t)llround(m * log(m / (m - hll->num_sparse)));
+}
+
+int hll_merge(hyperloglog *dst, hyperloglog *src) {
+  if (dst->precision != src->precision) {
+    return 0;
+  }
+
+  if (dst == src) {
+    return 1;
+  }
+
+  hll_flush(src);
+
+  if (src->encoding == HLL_SPARSE && dst->encoding == HLL_SPARSE) {
+    hll_flush(dst);
+    hll_sparse_merge(dst, src->sparse, src->num_sparse);
+
+    if (dst->num_sparse * sizeof(uint32_t) > (size_t)1 << dst->precision) {
+      hll_densify(dst);
+    }
+
+    return 1;
+  }
+
+  if (dst->encoding == HLL_SPARSE) {
+    hll_densify(dst);
+  }
+
+  if (src->encoding == HLL_SPARSE) {
+    for (unsigned int i = 0; i < src->num_sparse; i++) {
+      hll_dense_apply(dst, src->sparse[i]);
+    }
+  } else {
+    for (unsigned int i = 0; i < 1U << dst->precision; i++) {
+      if (src->registers[i] > dst->registers[i]) {
+        dst->registers[i] = src->registers[i];
+      }
+    }
+  }
+
+  return 1;
+}
+
+static void hll_put_u32(unsigned char *p, uint32_t v) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32_t hll_get_u32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+size_t hll_serialize(hyperloglog *hll, void *buf, size_t size) {
+  hll_flush(hll);
+
+  const size_t payload = hll->encoding == HLL_DENSE
+                             ? (size_t)1 << hll->precision
+                             : sizeof(uint32_t) * hll->num_sparse;
+  const size_t needed = HLL_HEADER_SIZE + payload;
+
+  if (buf == NULL || size < needed) {
+    return needed;
+  }
+
+  // Header: magic, precision, encoding, then the number of sparse entries;
+  // every integer is little-endian
+  unsigned char *p = buf;
+  memcpy(p, HLL_MAGIC, 4);
+  p[4] = (unsigned char)hll->precision;
+  p[5] = (unsigned char)hll->encoding;
+  hll_put_u32(p + 6, hll->num_sparse);
+  p += HLL_HEADER_SIZE;
+
+  if (hll->encoding == HLL_DENSE) {
+    memcpy(p, hll->registers, payload);
+  } else {
+    for (unsigned int i = 0; i < hll->num_sparse; i++) {
+      hll_put_u32(p + 4 * i, hll->sparse[i]);
+    }
+  }
+
+  return needed;
+}
+
+hyperloglog *hll_deserialize(const void *buf, size_t size) {
+  const unsigned char *p = buf;
+
+  if (size < HLL_HEADER_SIZE || memcmp(p, HLL_MAGIC, 4) != 0 ||
+      p[4] < HLL_MIN_PRECISION || p[4] > HLL_MAX_PRECISION ||
+      (p[5] != HLL_SPARSE && p[5] != HLL_DENSE)) {
+    return NULL;
+  }
+
+  hyperloglog *hll = hll_init(p[4]);
+  const hll_encoding encoding = p[5];
+  const uint32_t num_sparse = hll_get_u32(p + 6);
+  const size_t payload = encoding == HLL_DENSE
+                             ? (size_t)1 << hll->precision
+                             : sizeof(uint32_t) * num_sparse;
+  // A sparse list holds at most one entry per index
+  if (size - HLL_HEADER_SIZE < payload ||
+      (encoding == HLL_DENSE && num_sparse != 0) ||
+      num_sparse > 1U << HLL_SPARSE_PRECISION) {
+    hll_delete(hll);
+    return NULL;
+  }
+  p += HLL_HEADER_SIZE;
+
+  if (encoding == HLL_DENSE) {
+    hll->encoding = HLL_DENSE;
+    hll->registers = malloc(payload);
+    memcpy(hll->registers, p, payload);
+
+    // Ranks beyond the hash's width would index past the histogram
+    for (size_t i = 0; i < payload; i++) {
+      if (hll->registers[i] > 64 - hll->precision + 1) {
+        hll_delete(hll);
+        return NULL;
+      }
+    }
+
+    return hll;
+  }
+
+  uint32_t *entries = malloc(sizeof(uint32_t) * (num_sparse ? num_sparse : 1));
+  for (uint32_t i = 0; i < num_sparse; i++) {
+    entries[i] = hll_get_u32(p + 4 * i);
+
+    const unsigned int rank = entries[i] & 0x3f;
+    if (entries[i] >> 6 >= 1U << HLL_SPARSE_PRECISION || rank == 0 ||
+        rank > 64 - HLL_SPARSE_PRECISION + 1 ||
+        (i > 0 && entries[i] >> 6 <= entries[i - 1] >> 6)) {
+      free(entries);
+      hll_delete(hll);
+      return NULL;
+    }
+  }
+
+  hll->sparse = entries;
+  hll->num_sparse = num_sparse;
+
+  // A list longer than `hll_flush` would keep is stored densely, as the
+  // serializing sketch would have
+  if (hll->num_sparse * sizeof(uint32_t) > (size_t)1 << hll->precision) {
+    hll_densify(hll);
+  }
+
+  return hll;
+}
+
+void hll_delete(hyperloglog *hll) {
+  free(hll->registers);
+  free(hll->sparse);
+  free(hll);
+}
+
+struct distinct_counter {
+  /**
+   * Number of distinct keys above which the counter switches to a sketch
+   */
+  unsigned int threshold;
+
+  unsigned int precision;
+
+  /**
+   * The exact set of keys seen; NULL once the counter has switched
+   */
+  hash_set *hs;
+
+  /**
+   * The sketch; NULL until the counter switches
+   */
+  hyperloglog *hll;
+};
+
+distinct_counter *dc_init(unsigned int threshold, unsigned int precision) {
+  distinct_counter *dc = malloc(sizeof(distinct_counter));
+  dc->threshold = threshold;
+  dc->precision = precision;
+  dc->hs = hs_init(0);
+  dc->hll = NULL;
+
+  return dc;
+}
+
+void dc_add(distinct_counter *dc, const char *key) {
+  if (dc->hll != NULL) {
+    hll_add(dc->hll, key);
+    return;
+  }
+
+  hs_insert(dc->hs, key);
+  if (dc->hs->count <= dc->threshold) {
+    return;
+  }
+
+  // Replay every key seen into a sketch, then drop the set
+  dc->hll = hll_init(dc->precision);
+
+  hs_cursor cursor;
+  hs_cursor_init(dc->hs, &cursor);
+
+  const char *r;
+  while ((r = hs_cursor_next(dc->hs, &cursor)) != NULL) {
+    hll_add(dc->hll, r);
+  }
+
+  hs_delete_set(dc->hs);
+  dc->hs = NULL;
+}
+
+uint64_t dc_count(distinct_counter *dc) {
+  return dc->hll != NULL ? hll_count(dc->hll) : dc->hs->count;
+}
+
+int dc_is_exact(distinct_counter *dc) { return dc->hll == NULL; }
+
+void dc_delete(distinct_counter *dc) {
+  if (dc->hll != NULL) {
+    hll_delete(dc->hll);
+  } else {
+    hs_delete_set(dc->hs);
+  }
+
+  free(dc);
+}
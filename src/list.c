@@ -9,13 +9,13 @@ node_t *list_create_sentinel_node(void) { return &LIST_SENTINEL_NODE; }
 
 bool list_is_sentinel_node(node_t *node) { return node == &LIST_SENTINEL_NODE; }
 
-node_t *list_node_create(const int value) {
+node_t *list_node_create(const size_t value) {
   node_t *n = (node_t *)malloc(sizeof(node_t));
   n->value = value;
   return n;
 }
 
-void list_prepend(node_t **head, int value) {
+void list_prepend(node_t **head, size_t value) {
   // TODO: xmalloc
   node_t *new_node = (node_t *)malloc(sizeof(node_t));
   new_node->value = value;
@@ -25,7 +25,7 @@ void list_prepend(node_t **head, int value) {
   new_node->next = tmp;
 }
 
-void list_remove(node_t **head, int value) {
+void list_remove(node_t **head, size_t value) {
   node_t *current = *head;
   node_t *prev = NULL;
 
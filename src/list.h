@@ -6,15 +6,15 @@
 
 typedef struct node node_t;
 struct node {
-  int value;
+  size_t value;
   node_t *next;
 };
 
 node_t *list_create_sentinel_node(void);
 bool list_is_sentinel_node(node_t *node);
-node_t *list_node_create(const int value);
-void list_prepend(node_t **head, int value);
-void list_remove(node_t **head, int value);
+node_t *list_node_create(const size_t value);
+void list_prepend(node_t **head, size_t value);
+void list_remove(node_t **head, size_t value);
 void list_free(node_t *head);
 
 #endif /* LIBHASH_LIST_H */
@@ -0,0 +1,76 @@
+#define _DEFAULT_SOURCE
+
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+  parallel_fn *fn;
+  void *arg;
+  unsigned int worker;
+} parallel_task;
+
+static void *parallel_trampoline(void *task) {
+  parallel_task *t = task;
+  t->fn(t->arg, t->worker);
+
+  return NULL;
+}
+
+/**
+ * Resolve the number of workers to use for a parallel operation. A request of
+ * 0 means one worker per online CPU.
+ *
+ * @param requested
+ * @return unsigned int
+ */
+unsigned int parallel_num_workers(unsigned int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+
+  const long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 ? (unsigned int)online : 1;
+}
+
+/**
+ * Invoke `fn` once per worker, each on its own thread, and wait for all of
+ * them to finish. Worker 0 runs on the calling thread. If a thread cannot be
+ * spawned, its share of the work is run on the calling thread instead.
+ *
+ * @param num_workers
+ * @param fn
+ * @param arg Shared with every worker
+ */
+void parallel_run(unsigned int num_workers, parallel_fn *fn, void *arg) {
+  if (num_workers <= 1) {
+    fn(arg, 0);
+    return;
+  }
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * num_workers);
+  parallel_task *tasks = malloc(sizeof(parallel_task) * num_workers);
+  int *spawned = calloc(num_workers, sizeof(int));
+
+  for (unsigned int i = 1; i < num_workers; i++) {
+    tasks[i] = (parallel_task){.fn = fn, .arg = arg, .worker = i};
+    spawned[i] =
+        pthread_create(&threads[i], NULL, parallel_trampoline, &tasks[i]) == 0;
+  }
+
+  fn(arg, 0);
+
+  for (unsigned int i = 1; i < num_workers; i++) {
+    if (spawned[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      fn(arg, i);
+    }
+  }
+
+  free(spawned);
+  free(tasks);
+  free(threads);
+}
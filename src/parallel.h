@@ -0,0 +1,9 @@
+#ifndef LIBHASH_PARALLEL_H
+#define LIBHASH_PARALLEL_H
+
+typedef void parallel_fn(void *arg, unsigned int worker);
+
+unsigned int parallel_num_workers(unsigned int requested);
+void parallel_run(unsigned int num_workers, parallel_fn *fn, void *arg);
+
+#endif /* LIBHASH_PARALLEL_H */
@@ -0,0 +1,234 @@
+#include "perfect_hash.h"
+
+#include <stdlib.h>
+
+#include "hash.h"
+
+/**
+ * Average number of keys per bucket. Larger buckets mean fewer pilots - and
+ * so fewer bits per key - at the cost of a longer search for each pilot.
+ */
+#define PH_BUCKET_SIZE 4
+
+/**
+ * Percentage of slots left over when placing keys. Filling every slot would
+ * leave the last buckets searching a nearly full table for a free slot;
+ * instead keys are placed into a table ~1% larger than needed, and the few
+ * which land beyond the first `n` slots are remapped into the holes left
+ * behind.
+ */
+#define PH_SLACK 1
+
+/**
+ * Odd 64-bit constant (the golden ratio) which spreads consecutive pilots
+ * across the whole word before they are mixed into a key's hash
+ */
+#define PH_PILOT_MULT 0x9e3779b97f4a7c15ULL
+
+/**
+ * Resolve the bucket of the given hash. Multiply-shift maps the high bits
+ * onto [0, num_buckets) without a division, while the bucket count fits in 32
+ * bits; beyond that, the hash is reduced with one.
+ *
+ * @param ph
+ * @param hash
+ * @return size_t
+ */
+static size_t ph_bucket(const perfect_hash *ph, uint64_t hash) {
+  if (ph->num_buckets <= UINT32_MAX) {
+    return (size_t)(((hash >> 32) * ph->num_buckets) >> 32);
+  }
+
+  return (size_t)(hash % ph->num_buckets);
+}
+
+/**
+ * Resolve the slot in [0, n) to which the given pilot sends a hash
+ *
+ * @param hash
+ * @param pilot
+ * @param n
+ * @return size_t
+ */
+static size_t ph_slot(uint64_t hash, uint64_t pilot, size_t n) {
+  return (size_t)(h_mix_64(hash ^ (pilot * PH_PILOT_MULT)) % n);
+}
+
+/**
+ * Search for the first pilot which sends every hash in a bucket to a distinct
+ * free slot, and mark those slots as taken.
+ *
+ * @param bucket The bucket's hashes
+ * @param size Number of hashes in the bucket
+ * @param n
+ * @param taken Bitmap of taken slots
+ * @param slots Scratch space for `size` slots
+ * @param pilot Receives the pilot
+ * @return 1 on success, 0 if no pilot exists i.e. two hashes are equal
+ */
+static int ph_place_bucket(const uint64_t *bucket, size_t size, size_t n,
+                           uint64_t *taken, size_t *slots, uint32_t *pilot) {
+  // No pilot can separate equal hashes
+  for (size_t i = 0; i < size; i++) {
+    for (size_t j = 0; j < i; j++) {
+      if (bucket[i] == bucket[j]) {
+        return 0;
+      }
+    }
+  }
+
+  for (uint64_t p = 0; p <= UINT32_MAX; p++) {
+    size_t j = 0;
+    for (; j < size; j++) {
+      const size_t s = ph_slot(bucket[j], p, n);
+      if ((taken[s / 64] >> (s % 64)) & 1) {
+        break;
+      }
+
+      taken[s / 64] |= 1ULL << (s % 64);
+      slots[j] = s;
+    }
+
+    if (j == size) {
+      *pilot = (uint32_t)p;
+      return 1;
+    }
+
+    // Release the slots claimed by this attempt
+    while (j > 0) {
+      j--;
+      taken[slots[j] / 64] &= ~(1ULL << (slots[j] % 64));
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Build a minimal perfect hash function over `n` distinct 64-bit hashes, in
+ * the style of PTHash: hashes are split into small buckets, and each bucket
+ * is assigned a "pilot" - the first value which, mixed into each of the
+ * bucket's hashes, sends them all to slots no other bucket has taken. Buckets
+ * are placed largest first, while most slots are still free. A lookup is then
+ * a bucket computation, one pilot load and a mix (plus a remap load for ~1%
+ * of keys), and the slots of the `n` hashes are exactly [0, n).
+ *
+ * @param ph
+ * @param hashes
+ * @param n
+ * @return 1 on success, 0 if two of the hashes are equal
+ */
+int ph_build(perfect_hash *ph, const uint64_t *hashes, size_t n) {
+  ph->n = n;
+  ph->table_size = n + n / 100 * PH_SLACK + 1;
+  ph->num_buckets = n / PH_BUCKET_SIZE + 1;
+  ph->pilots = calloc(ph->num_buckets, sizeof(uint32_t));
+  ph->remap = malloc(sizeof(size_t) * (ph->table_size - n));
+
+  // Group the hashes by bucket with a counting sort
+  size_t *offsets = calloc(ph->num_buckets + 1, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    offsets[ph_bucket(ph, hashes[i]) + 1]++;
+  }
+
+  size_t max_size = 0;
+  for (size_t b = 0; b < ph->num_buckets; b++) {
+    if (offsets[b + 1] > max_size) {
+      max_size = offsets[b + 1];
+    }
+    offsets[b + 1] += offsets[b];
+  }
+
+  size_t *fill = malloc(sizeof(size_t) * ph->num_buckets);
+  for (size_t b = 0; b < ph->num_buckets; b++) {
+    fill[b] = offsets[b];
+  }
+
+  uint64_t *grouped = malloc(sizeof(uint64_t) * (n ? n : 1));
+  for (size_t i = 0; i < n; i++) {
+    grouped[fill[ph_bucket(ph, hashes[i])]++] = hashes[i];
+  }
+
+  // Order the buckets by descending size, again with a counting sort
+  size_t *size_offsets = calloc(max_size + 2, sizeof(size_t));
+  for (size_t b = 0; b < ph->num_buckets; b++) {
+    size_offsets[max_size - (offsets[b + 1] - offsets[b]) + 1]++;
+  }
+  for (size_t s = 0; s <= max_size; s++) {
+    size_offsets[s + 1] += size_offsets[s];
+  }
+
+  size_t *order = fill;
+  for (size_t b = 0; b < ph->num_buckets; b++) {
+    order[size_offsets[max_size - (offsets[b + 1] - offsets[b])]++] = b;
+  }
+
+  const size_t m = ph->table_size;
+  uint64_t *taken = calloc((m + 63) / 64, sizeof(uint64_t));
+  size_t *slots = malloc(sizeof(size_t) * (max_size + 1));
+
+  int ok = 1;
+  for (size_t k = 0; ok && k < ph->num_buckets; k++) {
+    const size_t b = order[k];
+    const size_t size = offsets[b + 1] - offsets[b];
+
+    // Buckets are ordered by size, so the rest are empty too
+    if (size == 0) {
+      break;
+    }
+
+    ok = ph_place_bucket(grouped + offsets[b], size, m, taken, slots,
+                         &ph->pilots[b]);
+  }
+
+  // Pair each key placed beyond the first `n` slots with a hole inside them;
+  // there are exactly as many of one as of the other
+  size_t hole = 0;
+  for (size_t s = n; ok && s < m; s++) {
+    if (!((taken[s / 64] >> (s % 64)) & 1)) {
+      continue;
+    }
+
+    while ((taken[hole / 64] >> (hole % 64)) & 1) {
+      hole++;
+    }
+
+    ph->remap[s - n] = hole++;
+  }
+
+  free(slots);
+  free(taken);
+  free(size_offsets);
+  free(grouped);
+  free(fill);
+  free(offsets);
+
+  if (!ok) {
+    ph_free(ph);
+  }
+
+  return ok;
+}
+
+/**
+ * Resolve the slot of a hash which was passed to `ph_build`. Hashes which
+ * were not are sent to an arbitrary slot, so callers must verify the key
+ * stored there.
+ *
+ * @param ph
+ * @param hash
+ * @return size_t
+ */
+size_t ph_position(const perfect_hash *ph, uint64_t hash) {
+  const size_t s =
+      ph_slot(hash, ph->pilots[ph_bucket(ph, hash)], ph->table_size);
+
+  return s < ph->n ? s : ph->remap[s - ph->n];
+}
+
+void ph_free(perfect_hash *ph) {
+  free(ph->pilots);
+  free(ph->remap);
+  ph->pilots = NULL;
+  ph->remap = NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef LIBHASH_PERFECT_HASH_H
+#define LIBHASH_PERFECT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  /**
+   * Pilot of each bucket; see `ph_build`
+   */
+  uint32_t *pilots;
+
+  size_t num_buckets;
+
+  /**
+   * Number of keys, and so the size of the range keys are mapped onto
+   */
+  size_t n;
+
+  /**
+   * Number of slots pilots place keys into; slightly more than `n`
+   */
+  size_t table_size;
+
+  /**
+   * Slot in [0, n) of each key placed at or beyond `n`
+   */
+  size_t *remap;
+} perfect_hash;
+
+int ph_build(perfect_hash *ph, const uint64_t *hashes, size_t n);
+size_t ph_position(const perfect_hash *ph, uint64_t hash);
+void ph_free(perfect_hash *ph);
+
+#endif /* LIBHASH_PERFECT_HASH_H */
@@ -8,7 +8,7 @@
  * @param x
  * @return int
  */
-int is_prime(const int x) {
+int is_prime(const size_t x) {
   if (x < 2) {
     return 0;
   }
@@ -18,7 +18,8 @@ int is_prime(const int x) {
   if ((x % 2) == 0) {
     return 0;
   }
-  for (unsigned int i = 3; i <= floor(sqrt((double)x)); i += 2) {
+  const size_t limit = (size_t)floor(sqrt((double)x));
+  for (size_t i = 3; i <= limit; i += 2) {
     if ((x % i) == 0) {
       return 0;
     }
@@ -31,9 +32,9 @@ int is_prime(const int x) {
  * or `x` if `x` is prime. Successive, brute-force resolution.
  *
  * @param x
- * @return int
+ * @return size_t
  */
-int next_prime(int x) {
+size_t next_prime(size_t x) {
   while (!is_prime(x)) {
     x++;
   }
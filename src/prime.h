@@ -1,7 +1,9 @@
 #ifndef LIBHASH_PRIME_H
 #define LIBHASH_PRIME_H
 
-int is_prime(const int x);
-int next_prime(int x);
+#include <stddef.h>
+
+int is_prime(const size_t x);
+size_t next_prime(size_t x);
 
 #endif /* LIBHASH_PRIME_H */
@@ -0,0 +1,280 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "hash.h"
+#include "libhash.h"
+#include "parallel.h"
+
+/**
+ * Shards are padded out to a cache line so that threads working on adjacent
+ * shards don't contend on the same line when taking their locks.
+ */
+#define SHT_CACHE_LINE 64
+
+typedef struct {
+  _Alignas(SHT_CACHE_LINE) pthread_rwlock_t lock;
+  hash_table *ht;
+} sht_shard;
+
+struct sharded_hash_table {
+  /**
+   * Number of shards; always a power of two
+   */
+  unsigned int num_shards;
+
+  /**
+   * log2(num_shards) i.e. the number of high hash bits used for routing
+   */
+  unsigned int shard_bits;
+
+  sht_shard *shards;
+};
+
+typedef struct {
+  sharded_hash_table *sht;
+  ht_visit_fn *visit;
+  void *ctx;
+  atomic_uint next_shard;
+} sht_for_each_task;
+
+/**
+ * Resolve the shard which owns the given key
+ *
+ * @param sht
+ * @param key
+ * @return unsigned int
+ */
+static unsigned int sht_shard_of(sharded_hash_table *sht, const char *key) {
+  if (sht->shard_bits == 0) {
+    return 0;
+  }
+
+  return (unsigned int)(h_hash_64(key) >> (64 - sht->shard_bits));
+}
+
+/**
+ * Stable counting sort of the indices [0, n) by the shard which owns each
+ * key. Afterwards, the indices of the keys owned by shard `s` are
+ * `order[offsets[s]]` through `order[offsets[s + 1] - 1]`.
+ *
+ * @param sht
+ * @param keys
+ * @param n
+ * @param order Output array with room for `n` indices
+ * @param offsets Output array with room for `num_shards + 1` offsets
+ */
+static void sht_group_by_shard(sharded_hash_table *sht, const char **keys,
+                               unsigned int n, unsigned int *order,
+                               unsigned int *offsets) {
+  unsigned int *shard_of = malloc(sizeof(unsigned int) * (n ? n : 1));
+
+  for (unsigned int s = 0; s <= sht->num_shards; s++) {
+    offsets[s] = 0;
+  }
+
+  for (unsigned int i = 0; i < n; i++) {
+    shard_of[i] = sht_shard_of(sht, keys[i]);
+    offsets[shard_of[i] + 1]++;
+  }
+
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    offsets[s + 1] += offsets[s];
+  }
+
+  // Use the first `num_shards` offsets as write cursors, then shift them back
+  for (unsigned int i = 0; i < n; i++) {
+    order[offsets[shard_of[i]]++] = i;
+  }
+
+  for (unsigned int s = sht->num_shards; s > 0; s--) {
+    offsets[s] = offsets[s - 1];
+  }
+  offsets[0] = 0;
+
+  free(shard_of);
+}
+
+/**
+ * Worker which claims shards one at a time until none remain
+ *
+ * @param arg
+ * @param worker
+ */
+static void sht_for_each_worker(void *arg, unsigned int worker) {
+  sht_for_each_task *task = arg;
+
+  for (;;) {
+    const unsigned int s = atomic_fetch_add(&task->next_shard, 1);
+    if (s >= task->sht->num_shards) {
+      return;
+    }
+
+    sht_shard *shard = &task->sht->shards[s];
+    pthread_rwlock_rdlock(&shard->lock);
+
+    HT_ITER_START(shard->ht)
+    task->visit(entry, task->ctx);
+    HT_ITER_END
+
+    pthread_rwlock_unlock(&shard->lock);
+  }
+}
+
+sharded_hash_table *sht_init(unsigned int num_shards, size_t base_capacity,
+                             free_fn *free_value) {
+  unsigned int shard_bits = 0;
+  while ((1U << shard_bits) < num_shards) {
+    shard_bits++;
+  }
+
+  sharded_hash_table *sht = malloc(sizeof(sharded_hash_table));
+  sht->shard_bits = shard_bits;
+  sht->num_shards = 1U << shard_bits;
+  sht->shards = aligned_alloc(SHT_CACHE_LINE,
+                              sizeof(sht_shard) * (size_t)sht->num_shards);
+
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    pthread_rwlock_init(&sht->shards[s].lock, NULL);
+    sht->shards[s].ht = ht_init(base_capacity, free_value);
+  }
+
+  return sht;
+}
+
+void sht_insert(sharded_hash_table *sht, const char *key, void *value) {
+  sht_shard *shard = &sht->shards[sht_shard_of(sht, key)];
+
+  pthread_rwlock_wrlock(&shard->lock);
+  ht_insert(shard->ht, key, value);
+  pthread_rwlock_unlock(&shard->lock);
+}
+
+void *sht_get(sharded_hash_table *sht, const char *key) {
+  sht_shard *shard = &sht->shards[sht_shard_of(sht, key)];
+
+  pthread_rwlock_rdlock(&shard->lock);
+  void *value = ht_get(shard->ht, key);
+  pthread_rwlock_unlock(&shard->lock);
+
+  return value;
+}
+
+int sht_delete(sharded_hash_table *sht, const char *key) {
+  sht_shard *shard = &sht->shards[sht_shard_of(sht, key)];
+
+  pthread_rwlock_wrlock(&shard->lock);
+  const int deleted = ht_delete(shard->ht, key);
+  pthread_rwlock_unlock(&shard->lock);
+
+  return deleted;
+}
+
+void sht_insert_batch(sharded_hash_table *sht, const char **keys,
+                      void **values, unsigned int n) {
+  unsigned int *order = malloc(sizeof(unsigned int) * (n ? n : 1));
+  unsigned int *offsets = malloc(sizeof(unsigned int) * (sht->num_shards + 1));
+  sht_group_by_shard(sht, keys, n, order, offsets);
+
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    if (offsets[s] == offsets[s + 1]) {
+      continue;
+    }
+
+    sht_shard *shard = &sht->shards[s];
+    pthread_rwlock_wrlock(&shard->lock);
+    for (unsigned int j = offsets[s]; j < offsets[s + 1]; j++) {
+      ht_insert(shard->ht, keys[order[j]], values[order[j]]);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+
+  free(offsets);
+  free(order);
+}
+
+void sht_get_batch(sharded_hash_table *sht, const char **keys, void **values,
+                   unsigned int n) {
+  unsigned int *order = malloc(sizeof(unsigned int) * (n ? n : 1));
+  unsigned int *offsets = malloc(sizeof(unsigned int) * (sht->num_shards + 1));
+  sht_group_by_shard(sht, keys, n, order, offsets);
+
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    if (offsets[s] == offsets[s + 1]) {
+      continue;
+    }
+
+    sht_shard *shard = &sht->shards[s];
+    pthread_rwlock_rdlock(&shard->lock);
+    for (unsigned int j = offsets[s]; j < offsets[s + 1]; j++) {
+      values[order[j]] = ht_get(shard->ht, keys[order[j]]);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+
+  free(offsets);
+  free(order);
+}
+
+unsigned int sht_delete_batch(sharded_hash_table *sht, const char **keys,
+                              unsigned int n) {
+  unsigned int *order = malloc(sizeof(unsigned int) * (n ? n : 1));
+  unsigned int *offsets = malloc(sizeof(unsigned int) * (sht->num_shards + 1));
+  sht_group_by_shard(sht, keys, n, order, offsets);
+
+  unsigned int deleted = 0;
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    if (offsets[s] == offsets[s + 1]) {
+      continue;
+    }
+
+    sht_shard *shard = &sht->shards[s];
+    pthread_rwlock_wrlock(&shard->lock);
+    for (unsigned int j = offsets[s]; j < offsets[s + 1]; j++) {
+      deleted += ht_delete(shard->ht, keys[order[j]]);
+    }
+    pthread_rwlock_unlock(&shard->lock);
+  }
+
+  free(offsets);
+  free(order);
+
+  return deleted;
+}
+
+void sht_parallel_for_each(sharded_hash_table *sht, ht_visit_fn *visit,
+                           void *ctx, unsigned int num_threads) {
+  sht_for_each_task task = {.sht = sht, .visit = visit, .ctx = ctx};
+  atomic_init(&task.next_shard, 0);
+
+  num_threads = parallel_num_workers(num_threads);
+  if (num_threads > sht->num_shards) {
+    num_threads = sht->num_shards;
+  }
+
+  parallel_run(num_threads, sht_for_each_worker, &task);
+}
+
+size_t sht_count(sharded_hash_table *sht) {
+  size_t count = 0;
+
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    pthread_rwlock_rdlock(&sht->shards[s].lock);
+    count += sht->shards[s].ht->count;
+    pthread_rwlock_unlock(&sht->shards[s].lock);
+  }
+
+  return count;
+}
+
+void sht_delete_table(sharded_hash_table *sht) {
+  for (unsigned int s = 0; s < sht->num_shards; s++) {
+    ht_delete_table(sht->shards[s].ht);
+    pthread_rwlock_destroy(&sht->shards[s].lock);
+  }
+
+  free(sht->shards);
+  free(sht);
+}
@@ -0,0 +1,255 @@
+#define _DEFAULT_SOURCE
+
+#include "slots.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Size of a huge page on every architecture we map them on
+ */
+#define SLOTS_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/**
+ * Number of NUMA nodes a policy can name
+ */
+#define SLOTS_MAX_NODES 64
+
+/**
+ * Size from which slot arrays are mapped even without flags. A fresh mapping
+ * is zeroed on demand as its pages are first touched, where a heap block of
+ * this size may have to be cleared up front by `calloc`.
+ */
+#define SLOTS_MAP_MIN ((size_t)1 << 20)
+
+static size_t slots_round_up(size_t size, size_t align) {
+  return (size + align - 1) / align * align;
+}
+
+/**
+ * Apply the NUMA policy of the given flags to a mapping which has not been
+ * touched yet. The policy is a hint: one the system cannot honour, e.g. for
+ * want of a node, is ignored.
+ *
+ * @param addr
+ * @param len
+ * @param flags
+ * @param numa_node
+ */
+static void slots_bind(void *addr, size_t len, unsigned int flags,
+                       int numa_node) {
+  unsigned long nodes = 0;
+  int mode = MPOL_DEFAULT;
+
+  if (flags & HT_MEM_INTERLEAVE) {
+    // The kernel narrows the mask down to the nodes which have memory
+    nodes = ~0UL;
+    mode = MPOL_INTERLEAVE;
+  } else if ((flags & HT_MEM_BIND) && numa_node >= 0 &&
+             numa_node < SLOTS_MAX_NODES) {
+    nodes = 1UL << numa_node;
+    mode = MPOL_BIND;
+  } else {
+    return;
+  }
+
+  syscall(SYS_mbind, addr, len, mode, &nodes, SLOTS_MAX_NODES + 1, 0);
+}
+
+/**
+ * Map zeroed memory whose start is aligned to a huge page, so that
+ * transparent huge pages can back all of it
+ *
+ * @param len A multiple of the huge page size
+ * @return void* The mapping, or MAP_FAILED
+ */
+static void *slots_map_aligned(size_t len) {
+  const size_t padded = len + SLOTS_HUGE_PAGE_SIZE;
+  char *p = mmap(NULL, padded, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+
+  // Trim the unaligned head and the remaining tail
+  char *aligned = (char *)slots_round_up((uintptr_t)p, SLOTS_HUGE_PAGE_SIZE);
+  if (aligned > p) {
+    munmap(p, (size_t)(aligned - p));
+  }
+  const size_t tail = (size_t)(p + padded - (aligned + len));
+  if (tail > 0) {
+    munmap(aligned + len, tail);
+  }
+
+  return aligned;
+}
+#endif
+
+/**
+ * Allocate a zeroed slot array backed as the given `ht_mem_flags` ask. With
+ * no flags, or where the system offers no way to honour them, the array is
+ * allocated from the heap.
+ *
+ * @param size Size of the array in bytes
+ * @param flags See `ht_mem_flags`
+ * @param numa_node Node to bind to with HT_MEM_BIND
+ * @param mapped Set to the length of the mapping backing the array, or 0 if
+ * it came from the heap; to be passed back to `slots_free`
+ * @return void*
+ */
+void *slots_alloc(size_t size, unsigned int flags, int numa_node,
+                  size_t *mapped) {
+  *mapped = 0;
+
+#ifdef __linux__
+  if ((flags != HT_MEM_DEFAULT && size > 0) || size >= SLOTS_MAP_MIN) {
+    void *p = MAP_FAILED;
+    size_t len = 0;
+
+    if (flags & HT_MEM_HUGETLB) {
+      len = slots_round_up(size, SLOTS_HUGE_PAGE_SIZE);
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    // Fall back to transparent huge pages, e.g. when the hugetlb pool is
+    // empty
+    if (p == MAP_FAILED &&
+        (flags & (HT_MEM_HUGETLB | HT_MEM_HUGEPAGES)) &&
+        size >= SLOTS_HUGE_PAGE_SIZE) {
+      len = slots_round_up(size, SLOTS_HUGE_PAGE_SIZE);
+      p = slots_map_aligned(len);
+      if (p != MAP_FAILED) {
+        madvise(p, len, MADV_HUGEPAGE);
+      }
+    }
+
+    if (p == MAP_FAILED) {
+      len = slots_round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+               -1, 0);
+    }
+
+    if (p != MAP_FAILED) {
+      slots_bind(p, len, flags, numa_node);
+      *mapped = len;
+      return p;
+    }
+  }
+#else
+  (void)flags;
+  (void)numa_node;
+#endif
+
+  return calloc(size ? size : 1, 1);
+}
+
+/**
+ * Take the spare slot array kept by `slots_release`, if it is large enough to
+ * hold an array of the given size. Its pages have been returned to the
+ * system, so it reads as zeroed.
+ *
+ * @param spare
+ * @param spare_mapped
+ * @param size Size of the array in bytes
+ * @param mapped Set to the length of the spare's mapping if it is taken
+ * @return void* The spare, or NULL if there is none large enough
+ */
+void *slots_take_spare(void **spare, size_t *spare_mapped, size_t size,
+                       size_t *mapped) {
+  if (*spare == NULL || *spare_mapped < size) {
+    return NULL;
+  }
+
+  void *slots = *spare;
+  *mapped = *spare_mapped;
+  *spare = NULL;
+  *spare_mapped = 0;
+
+  return slots;
+}
+
+/**
+ * Release a slot array allocated by `slots_alloc` which is no longer in use.
+ * A mapped array is kept as the spare, replacing any previous one, once its
+ * pages have been returned to the system; it then costs address space alone.
+ *
+ * @param spare
+ * @param spare_mapped
+ * @param slots
+ * @param mapped
+ */
+void slots_release(void **spare, size_t *spare_mapped, void *slots,
+                   size_t mapped) {
+#ifdef __linux__
+  if (mapped > 0 && madvise(slots, mapped, MADV_DONTNEED) == 0) {
+    slots_free(*spare, *spare_mapped);
+    *spare = slots;
+    *spare_mapped = mapped;
+    return;
+  }
+#endif
+
+  slots_free(slots, mapped);
+}
+
+/**
+ * Return the pages of a mapped slot array past its first `size` bytes to the
+ * system, e.g. once the array has been shrunk in place. The bytes past `size`
+ * read as zeroed afterwards.
+ *
+ * @param slots
+ * @param size
+ * @param mapped
+ */
+void slots_trim(void *slots, size_t size, size_t mapped) {
+#ifdef __linux__
+  if (mapped == 0) {
+    return;
+  }
+
+  const size_t end = slots_round_up(size, (size_t)sysconf(_SC_PAGESIZE));
+  if (end >= mapped) {
+    memset((char *)slots + size, 0, mapped - size);
+    return;
+  }
+
+  memset((char *)slots + size, 0, end - size);
+  if (madvise((char *)slots + end, mapped - end, MADV_DONTNEED) != 0) {
+    // Huge page mappings may only be trimmed on huge page boundaries
+    memset((char *)slots + end, 0, mapped - end);
+  }
+#else
+  (void)slots;
+  (void)size;
+  (void)mapped;
+#endif
+}
+
+/**
+ * Free a slot array allocated by `slots_alloc`
+ *
+ * @param slots
+ * @param mapped
+ */
+void slots_free(void *slots, size_t mapped) {
+#ifdef __linux__
+  if (mapped > 0) {
+    munmap(slots, mapped);
+    return;
+  }
+#else
+  (void)mapped;
+#endif
+
+  free(slots);
+}
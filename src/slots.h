@@ -0,0 +1,15 @@
+#ifndef LIBHASH_SLOTS_H
+#define LIBHASH_SLOTS_H
+
+#include <stddef.h>
+
+void *slots_alloc(size_t size, unsigned int flags, int numa_node,
+                  size_t *mapped);
+void *slots_take_spare(void **spare, size_t *spare_mapped, size_t size,
+                       size_t *mapped);
+void slots_release(void **spare, size_t *spare_mapped, void *slots,
+                   size_t mapped);
+void slots_trim(void *slots, size_t size, size_t mapped);
+void slots_free(void *slots, size_t mapped);
+
+#endif /* LIBHASH_SLOTS_H */
@@ -0,0 +1,60 @@
+#include "small.h"
+
+#include "hash.h"
+
+/**
+ * Every byte set to 1, and every byte's low 7 bits set
+ */
+#define SMALL_ONES 0x0101010101010101ULL
+#define SMALL_LOW_BITS 0x7f7f7f7f7f7f7f7fULL
+
+/**
+ * Multiplier which gathers bit 0 of each byte into the top byte, byte `i`'s
+ * landing in bit `56 + i`
+ */
+#define SMALL_GATHER 0x0102040810204080ULL
+
+/**
+ * Compute the tag of a key in the small layout: a byte of its hash, never 0,
+ * which marks an empty slot
+ *
+ * @param key
+ * @return uint8_t
+ */
+uint8_t small_tag(const char *key) {
+  return (uint8_t)(h_crc32c(key) % 255 + 1);
+}
+
+/**
+ * Find the slots whose tag equals the given one, comparing all eight at once
+ * within a single word
+ *
+ * @param tags A tag per slot, slot `i` in byte `i`
+ * @param tag
+ * @return unsigned int A mask with bit `i` set if slot `i` matches
+ */
+unsigned int small_match(uint64_t tags, uint8_t tag) {
+  // Bytes holding the tag become zero...
+  const uint64_t x = tags ^ (SMALL_ONES * tag);
+
+  // ...and each zero byte, and only those, gets its high bit set. The low 7
+  // bits of a byte sum to at most 0xfe, so no carry crosses into the next.
+  const uint64_t zero =
+      ~(((x & SMALL_LOW_BITS) + SMALL_LOW_BITS) | x | SMALL_LOW_BITS);
+
+  return (unsigned int)(((zero >> 7) * SMALL_GATHER) >> 56);
+}
+
+/**
+ * Replace the tag of the given slot
+ *
+ * @param tags
+ * @param slot
+ * @param tag The new tag, or 0 to mark the slot empty
+ * @return uint64_t The updated tags
+ */
+uint64_t small_set_tag(uint64_t tags, unsigned int slot, uint8_t tag) {
+  const unsigned int shift = slot * 8;
+
+  return (tags & ~(0xffULL << shift)) | ((uint64_t)tag << shift);
+}
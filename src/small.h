@@ -0,0 +1,10 @@
+#ifndef LIBHASH_SMALL_H
+#define LIBHASH_SMALL_H
+
+#include <stdint.h>
+
+uint8_t small_tag(const char *key);
+unsigned int small_match(uint64_t tags, uint8_t tag);
+uint64_t small_set_tag(uint64_t tags, unsigned int slot, uint8_t tag);
+
+#endif /* LIBHASH_SMALL_H */
@@ -0,0 +1,390 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "build.h"
+#include "hash.h"
+#include "libhash.h"
+#include "prime.h"
+
+#define SNAPSHOT_MAGIC "LIBHASH"
+
+/**
+ * Version 2 slot arrays are laid out with probe sequences computed in 64-bit
+ * arithmetic; version 1 sequences wrapped at 2^32, so those files are
+ * rejected rather than probed in the wrong slots
+ */
+#define SNAPSHOT_VERSION 2
+
+/**
+ * Identifies the probe sequence the slot array was laid out with, i.e.
+ * `h_compute_hash`
+ */
+#define SNAPSHOT_HASH_DOUBLE 1
+
+/**
+ * Alignment of every record and value in the file. The mapping itself is
+ * page-aligned, so values may be read in place as any type up to 8 bytes.
+ */
+#define SNAPSHOT_ALIGN 8
+
+/**
+ * The file header. A snapshot is laid out as the header, followed by the slot
+ * array - one 64-bit file offset per slot, 0 for an empty slot - followed by
+ * the records the slots point at. Offsets rather than pointers make the image
+ * position-independent, so it may be mapped anywhere and used as-is.
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint32_t hash;
+  uint32_t reserved;
+
+  /**
+   * Seed the keys were hashed with
+   */
+  uint64_t seed;
+
+  /**
+   * Number of slots in the slot array
+   */
+  uint64_t capacity;
+
+  /**
+   * Number of records
+   */
+  uint64_t count;
+
+  /**
+   * Size in bytes of the whole file; guards against truncation
+   */
+  uint64_t size;
+} snapshot_header;
+
+/**
+ * A record, followed by the NUL-terminated key and then the value, each
+ * padded out to SNAPSHOT_ALIGN.
+ */
+typedef struct {
+  uint64_t value_size;
+  uint32_t key_size;
+  uint32_t has_value;
+} snapshot_record;
+
+typedef struct {
+  const unsigned char *base;
+  size_t size;
+  const snapshot_header *header;
+  const uint64_t *slots;
+} snapshot_map;
+
+struct ht_mmap {
+  snapshot_map map;
+};
+
+struct hs_mmap {
+  snapshot_map map;
+};
+
+static const unsigned char SNAPSHOT_PADDING[SNAPSHOT_ALIGN] = {0};
+
+/**
+ * Round `n` up to a multiple of SNAPSHOT_ALIGN
+ *
+ * @param n
+ * @return uint64_t
+ */
+static uint64_t snapshot_pad(uint64_t n) {
+  return (n + SNAPSHOT_ALIGN - 1) & ~(uint64_t)(SNAPSHOT_ALIGN - 1);
+}
+
+/**
+ * Write `size` bytes followed by enough zero bytes to realign the file
+ *
+ * @param f
+ * @param data
+ * @param size
+ * @return 1 on success, 0 on failure
+ */
+static int snapshot_write_padded(FILE *f, const void *data, size_t size) {
+  const size_t padding = snapshot_pad(size) - size;
+
+  return fwrite(data, 1, size, f) == size &&
+         fwrite(SNAPSHOT_PADDING, 1, padding, f) == padding;
+}
+
+int snapshot_write(const char *path, snapshot_kind kind, const char **keys,
+                   const void **values, const size_t *value_sizes, size_t n) {
+  size_t base_capacity = build_capacity(n);
+  if (base_capacity < HT_DEFAULT_CAPACITY) {
+    base_capacity = HT_DEFAULT_CAPACITY;
+  }
+  const size_t capacity = next_prime(base_capacity);
+
+  // Lay the keys out afresh; the saved table's deleted slots are dropped, so
+  // probe sequences in the image are as short as they can be
+  size_t *slots = malloc(sizeof(size_t) * capacity);
+  for (size_t idx = 0; idx < capacity; idx++) {
+    slots[idx] = SIZE_MAX;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    const h_probe probe = h_probe_init(keys[i], capacity);
+
+    size_t attempt = 0;
+    size_t idx = h_probe_at(probe, capacity, attempt);
+    while (slots[idx] != SIZE_MAX) {
+      idx = h_probe_at(probe, capacity, ++attempt);
+    }
+
+    slots[idx] = i;
+  }
+
+  // Records are written in slot order, so neighbouring slots' records share
+  // pages in the mapping
+  uint64_t *offsets = calloc(capacity, sizeof(uint64_t));
+  uint64_t pos = sizeof(snapshot_header) + sizeof(uint64_t) * capacity;
+  for (size_t idx = 0; idx < capacity; idx++) {
+    const size_t i = slots[idx];
+    if (i == SIZE_MAX) {
+      continue;
+    }
+
+    offsets[idx] = pos;
+    pos += sizeof(snapshot_record) + snapshot_pad(strlen(keys[i]) + 1) +
+           snapshot_pad(value_sizes ? value_sizes[i] : 0);
+  }
+
+  snapshot_header header = {
+      .magic = SNAPSHOT_MAGIC,
+      .version = SNAPSHOT_VERSION,
+      .kind = kind,
+      .hash = SNAPSHOT_HASH_DOUBLE,
+      .seed = 0,
+      .capacity = capacity,
+      .count = n,
+      .size = pos,
+  };
+
+  // Write to a temporary file and rename it into place, so that processes
+  // which have the previous snapshot mapped are never exposed to a partial one
+  const size_t path_len = strlen(path);
+  char *tmp_path = malloc(path_len + sizeof(".tmp"));
+  memcpy(tmp_path, path, path_len);
+  memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+
+  FILE *f = fopen(tmp_path, "wb");
+  int ok = f != NULL;
+
+  ok = ok && fwrite(&header, sizeof(header), 1, f) == 1;
+  ok = ok && fwrite(offsets, sizeof(uint64_t), capacity, f) == capacity;
+
+  for (size_t idx = 0; ok && idx < capacity; idx++) {
+    const size_t i = slots[idx];
+    if (i == SIZE_MAX) {
+      continue;
+    }
+
+    const size_t key_size = strlen(keys[i]);
+    const void *value = values ? values[i] : NULL;
+    snapshot_record record = {
+        .value_size = value ? value_sizes[i] : 0,
+        .key_size = (uint32_t)key_size,
+        .has_value = value != NULL,
+    };
+
+    ok = fwrite(&record, sizeof(record), 1, f) == 1 &&
+         snapshot_write_padded(f, keys[i], key_size + 1) &&
+         snapshot_write_padded(f, value, record.value_size);
+  }
+
+  if (f != NULL && fclose(f) != 0) {
+    ok = 0;
+  }
+
+  if (ok) {
+    ok = rename(tmp_path, path) == 0;
+  }
+
+  if (!ok && f != NULL) {
+    remove(tmp_path);
+  }
+
+  free(tmp_path);
+  free(offsets);
+  free(slots);
+
+  return ok;
+}
+
+/**
+ * Map a snapshot file read-only and validate its header
+ *
+ * @param map
+ * @param path
+ * @param kind The kind of snapshot expected
+ * @return 1 on success, 0 if the file could not be mapped or is not a valid
+ * snapshot of the expected kind
+ */
+static int snapshot_map_open(snapshot_map *map, const char *path,
+                             snapshot_kind kind) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(snapshot_header)) {
+    close(fd);
+    return 0;
+  }
+
+  const size_t size = (size_t)st.st_size;
+  void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping holds its own reference to the file
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    return 0;
+  }
+
+  const snapshot_header *header = base;
+  const int valid =
+      memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+      header->version == SNAPSHOT_VERSION && header->kind == kind &&
+      header->hash == SNAPSHOT_HASH_DOUBLE && header->size == size &&
+      header->capacity > 0 &&
+      header->capacity <=
+          (size - sizeof(snapshot_header)) / sizeof(uint64_t) &&
+      header->count < header->capacity;
+
+  if (!valid) {
+    munmap(base, size);
+    return 0;
+  }
+
+  map->base = base;
+  map->size = size;
+  map->header = header;
+  map->slots = (const uint64_t *)(header + 1);
+
+  return 1;
+}
+
+/**
+ * Find the record for the given key. Records are bounds-checked as they are
+ * probed, so a corrupt file yields a miss rather than a fault.
+ *
+ * @param map
+ * @param key
+ * @return const snapshot_record* The record, or NULL if there is none
+ */
+static const snapshot_record *snapshot_map_find(const snapshot_map *map,
+                                                const char *key) {
+  const size_t capacity = (size_t)map->header->capacity;
+  const size_t key_size = strlen(key);
+  const h_probe probe = h_probe_init(key, capacity);
+
+  for (size_t i = 0; i < capacity; i++) {
+    const uint64_t offset = map->slots[h_probe_at(probe, capacity, i)];
+    if (offset == 0) {
+      return NULL;
+    }
+
+    if (offset > map->size - sizeof(snapshot_record)) {
+      return NULL;
+    }
+
+    const snapshot_record *record =
+        (const snapshot_record *)(map->base + offset);
+    if (record->key_size != key_size) {
+      continue;
+    }
+
+    if (key_size + 1 > map->size - offset - sizeof(snapshot_record)) {
+      return NULL;
+    }
+
+    if (memcmp(record + 1, key, key_size + 1) == 0) {
+      return record;
+    }
+  }
+
+  return NULL;
+}
+
+static void snapshot_map_close(snapshot_map *map) {
+  munmap((void *)map->base, map->size);
+}
+
+ht_mmap *ht_open_mmap(const char *path) {
+  ht_mmap *htm = malloc(sizeof(ht_mmap));
+
+  if (!snapshot_map_open(&htm->map, path, SNAPSHOT_TABLE)) {
+    free(htm);
+    return NULL;
+  }
+
+  return htm;
+}
+
+const void *ht_mmap_get(ht_mmap *htm, const char *key, size_t *size) {
+  const snapshot_record *record = snapshot_map_find(&htm->map, key);
+
+  if (record == NULL || !record->has_value) {
+    return NULL;
+  }
+
+  const uint64_t offset = (uint64_t)((const unsigned char *)record -
+                                     htm->map.base) +
+                          sizeof(snapshot_record) +
+                          snapshot_pad(record->key_size + 1);
+  if (offset > htm->map.size || record->value_size > htm->map.size - offset) {
+    return NULL;
+  }
+
+  if (size != NULL) {
+    *size = record->value_size;
+  }
+
+  return htm->map.base + offset;
+}
+
+size_t ht_mmap_count(ht_mmap *htm) { return (size_t)htm->map.header->count; }
+
+void ht_close_mmap(ht_mmap *htm) {
+  snapshot_map_close(&htm->map);
+  free(htm);
+}
+
+hs_mmap *hs_open_mmap(const char *path) {
+  hs_mmap *hsm = malloc(sizeof(hs_mmap));
+
+  if (!snapshot_map_open(&hsm->map, path, SNAPSHOT_SET)) {
+    free(hsm);
+    return NULL;
+  }
+
+  return hsm;
+}
+
+int hs_mmap_contains(hs_mmap *hsm, const char *key) {
+  return snapshot_map_find(&hsm->map, key) != NULL;
+}
+
+size_t hs_mmap_count(hs_mmap *hsm) { return (size_t)hsm->map.header->count; }
+
+void hs_close_mmap(hs_mmap *hsm) {
+  snapshot_map_close(&hsm->map);
+  free(hsm);
+}
@@ -0,0 +1,14 @@
+#ifndef LIBHASH_SNAPSHOT_H
+#define LIBHASH_SNAPSHOT_H
+
+#include <stddef.h>
+
+typedef enum {
+  SNAPSHOT_TABLE = 1,
+  SNAPSHOT_SET = 2,
+} snapshot_kind;
+
+int snapshot_write(const char *path, snapshot_kind kind, const char **keys,
+                   const void **values, const size_t *value_sizes, size_t n);
+
+#endif /* LIBHASH_SNAPSHOT_H */
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include <string.h>
+#include <time.h>
+
+/**
+ * Read a monotonic clock
+ *
+ * @return uint64_t Nanoseconds elapsed since an arbitrary point
+ */
+uint64_t stats_clock_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * Start collecting the stats of a table or set. Keys are then fed in one at a
+ * time with `stats_add_key`, and the summary computed by `stats_end`.
+ *
+ * @param stats
+ * @param capacity
+ * @param count
+ * @param counters
+ */
+void stats_begin(ht_stats *stats, size_t capacity, size_t count,
+                 const ht_counters *counters) {
+  memset(stats, 0, sizeof(ht_stats));
+  stats->capacity = capacity;
+  stats->count = count;
+  stats->load_factor = capacity ? (double)count / capacity : 0;
+  stats->counters = *counters;
+}
+
+/**
+ * Record the displacement of a key, i.e. the number of probes which passed
+ * over other slots before reaching the one it is stored in
+ *
+ * @param stats
+ * @param probe The key's probe sequence
+ * @param slot
+ */
+void stats_add_key(ht_stats *stats, h_probe probe, size_t slot) {
+  size_t displacement = 0;
+  while (displacement < stats->capacity &&
+         h_probe_at(probe, stats->capacity, displacement) != slot) {
+    displacement++;
+  }
+
+  stats_add_displacement(stats, displacement);
+}
+
+/**
+ * Record a key found after passing over the given number of other slots
+ *
+ * @param stats
+ * @param displacement
+ */
+void stats_add_displacement(ht_stats *stats, size_t displacement) {
+  const size_t bucket = displacement < HT_STATS_PROBE_BUCKETS
+                            ? displacement
+                            : HT_STATS_PROBE_BUCKETS - 1;
+  stats->probe_lengths[bucket]++;
+  stats->mean_displacement += displacement;
+
+  if (displacement > stats->max_displacement) {
+    stats->max_displacement = displacement;
+  }
+}
+
+void stats_end(ht_stats *stats) {
+  size_t num_keys = 0;
+  for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+    num_keys += stats->probe_lengths[i];
+  }
+
+  // Until now the mean holds the sum of displacements
+  stats->mean_displacement =
+      num_keys ? stats->mean_displacement / num_keys : 0;
+}
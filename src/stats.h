@@ -0,0 +1,32 @@
+#ifndef LIBHASH_STATS_H
+#define LIBHASH_STATS_H
+
+#include <stdint.h>
+
+#include "hash.h"
+#include "libhash.h"
+
+/**
+ * Running counters are only maintained when the library is built with
+ * LIBHASH_STATS; otherwise these compile away to nothing
+ */
+#ifdef LIBHASH_STATS
+#define STATS_NOW() stats_clock_ns()
+#define STATS_ALLOC(counters, bytes) \
+  ((counters).allocations++, (counters).allocated_bytes += (bytes))
+#define STATS_RESIZED(counters, started) \
+  ((counters).resizes++, (counters).resize_ns += stats_clock_ns() - (started))
+#else
+#define STATS_NOW() 0
+#define STATS_ALLOC(counters, bytes) ((void)0)
+#define STATS_RESIZED(counters, started) ((void)(started))
+#endif
+
+uint64_t stats_clock_ns(void);
+void stats_begin(ht_stats *stats, size_t capacity, size_t count,
+                 const ht_counters *counters);
+void stats_add_key(ht_stats *stats, h_probe probe, size_t slot);
+void stats_add_displacement(ht_stats *stats, size_t displacement);
+void stats_end(ht_stats *stats);
+
+#endif /* LIBHASH_STATS_H */
@@ -0,0 +1,233 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "timer_wheel.h"
+
+#include <stddef.h>
+#include <time.h>
+
+/**
+ * Pseudo-level of timers due beyond the span of the top level
+ */
+#define TW_OVERFLOW TW_LEVELS
+
+/**
+ * Number of ticks spanned by the wheel's levels together
+ */
+#define TW_SPAN_BITS (TW_SLOT_BITS * TW_LEVELS)
+
+static tw_timer **tw_head(timer_wheel *tw, unsigned int level,
+                          unsigned int slot) {
+  return level == TW_OVERFLOW ? &tw->overflow[slot] : &tw->slots[level][slot];
+}
+
+/**
+ * Insert a timer into the slot covering its expiry. A timer goes into the
+ * lowest level whose slots are coarse enough to tell its expiry apart from the
+ * current tick, i.e. the level holding the highest bit in which the two
+ * differ; timers are then cascaded down a level each time the wheel reaches
+ * their slot, until they reach level 0 and expire.
+ *
+ * @param tw
+ * @param timer
+ */
+static void tw_place(timer_wheel *tw, tw_timer *timer) {
+  const uint64_t expires = timer->expires < tw->now ? tw->now : timer->expires;
+  const uint64_t diff = expires ^ tw->now;
+
+  unsigned int level = 0;
+  unsigned int slot = 0;
+  if (diff >> TW_SPAN_BITS) {
+    level = TW_OVERFLOW;
+    slot = tw->overflow_index;
+  } else {
+    while (diff >> (TW_SLOT_BITS * (level + 1))) {
+      level++;
+    }
+    slot = (expires >> (TW_SLOT_BITS * level)) & (TW_SLOTS - 1);
+    tw->occupied[level] |= 1ULL << slot;
+  }
+
+  tw_timer **head = tw_head(tw, level, slot);
+  timer->level = (unsigned char)level;
+  timer->slot = (unsigned char)slot;
+  timer->prev = NULL;
+  timer->next = *head;
+  if (*head != NULL) {
+    (*head)->prev = timer;
+  }
+  *head = timer;
+}
+
+static void tw_unlink(timer_wheel *tw, tw_timer *timer) {
+  tw_timer **head = tw_head(tw, timer->level, timer->slot);
+
+  if (timer->prev != NULL) {
+    timer->prev->next = timer->next;
+  } else {
+    *head = timer->next;
+  }
+
+  if (timer->next != NULL) {
+    timer->next->prev = timer->prev;
+  }
+
+  if (*head == NULL && timer->level != TW_OVERFLOW) {
+    tw->occupied[timer->level] &= ~(1ULL << timer->slot);
+  }
+}
+
+/**
+ * Index of the lowest set bit of a non-zero word
+ *
+ * @param word
+ * @return unsigned int
+ */
+static unsigned int tw_lowest_bit(uint64_t word) {
+  unsigned int bit = 0;
+  while (!(word & 1)) {
+    word >>= 1;
+    bit++;
+  }
+
+  return bit;
+}
+
+void tw_init(timer_wheel *tw, uint64_t now) {
+  tw->now = now;
+  tw->overflow[0] = NULL;
+  tw->overflow[1] = NULL;
+  tw->overflow_index = 0;
+
+  for (unsigned int level = 0; level < TW_LEVELS; level++) {
+    tw->occupied[level] = 0;
+    for (unsigned int slot = 0; slot < TW_SLOTS; slot++) {
+      tw->slots[level][slot] = NULL;
+    }
+  }
+}
+
+/**
+ * Schedule (or reschedule) a timer to expire at the given tick
+ *
+ * @param tw
+ * @param timer
+ * @param expires Must be non-zero
+ */
+void tw_schedule(timer_wheel *tw, tw_timer *timer, uint64_t expires) {
+  tw_cancel(tw, timer);
+
+  timer->expires = expires;
+  tw_place(tw, timer);
+}
+
+void tw_cancel(timer_wheel *tw, tw_timer *timer) {
+  if (timer->expires == 0) {
+    return;
+  }
+
+  tw_unlink(tw, timer);
+  timer->expires = 0;
+}
+
+/**
+ * Advance the wheel towards tick `now`, and remove and return the next timer
+ * which is due by then. Each timer expired or cascaded to a lower level costs
+ * one unit of `budget`; the wheel stops short of `now` if the budget runs
+ * out, and picks up where it left off on the next call. Stretches of ticks
+ * with no timers are skipped outright, so the work done is proportional to
+ * the number of timers handled rather than the time elapsed.
+ *
+ * @param tw
+ * @param now
+ * @param budget
+ * @return tw_timer* The expired timer, now unscheduled, or NULL if no timer is
+ * due or the budget ran out
+ */
+tw_timer *tw_next_expired(timer_wheel *tw, uint64_t now,
+                          unsigned int *budget) {
+  while (*budget > 0) {
+    // Find the earliest slot due for handling; on a tie, the higher level
+    // goes first, as it may cascade timers into the lower one
+    uint64_t next = UINT64_MAX;
+    unsigned int next_level = 0;
+    unsigned int next_slot = 0;
+
+    for (unsigned int level = 0; level < TW_LEVELS; level++) {
+      const unsigned int shift = TW_SLOT_BITS * level;
+      const unsigned int idx = (tw->now >> shift) & (TW_SLOTS - 1);
+      const uint64_t pending = tw->occupied[level] & (~0ULL << idx);
+      if (!pending) {
+        continue;
+      }
+
+      const unsigned int slot = tw_lowest_bit(pending);
+      const uint64_t span = (1ULL << (shift + TW_SLOT_BITS)) - 1;
+      uint64_t tick = (tw->now & ~span) | ((uint64_t)slot << shift);
+      if (tick < tw->now) {
+        tick = tw->now;
+      }
+
+      if (tick <= next) {
+        next = tick;
+        next_level = level;
+        next_slot = slot;
+      }
+    }
+
+    // Timers handed over from the overflow list are cascaded before anything
+    // else in the current span
+    const unsigned int cascading = tw->overflow_index ^ 1;
+    if (tw->overflow[cascading] != NULL) {
+      next = tw->now;
+      next_level = TW_OVERFLOW;
+      next_slot = cascading;
+    } else if (tw->overflow[tw->overflow_index] != NULL) {
+      const uint64_t tick = ((tw->now >> TW_SPAN_BITS) + 1) << TW_SPAN_BITS;
+      if (tick <= next && tick <= now) {
+        // Hand the list over, and cascade it from the start of the new span
+        tw->now = tick;
+        tw->overflow_index = (unsigned char)cascading;
+        continue;
+      }
+
+      if (tick < next) {
+        next = tick;
+      }
+    }
+
+    if (next > now) {
+      // Nothing is due before `now`, so no slot is skipped over
+      if (now > tw->now) {
+        tw->now = now;
+      }
+
+      return NULL;
+    }
+
+    tw->now = next;
+    tw_timer *timer = *tw_head(tw, next_level, next_slot);
+    tw_unlink(tw, timer);
+    (*budget)--;
+
+    if (next_level == 0) {
+      timer->expires = 0;
+      return timer;
+    }
+
+    tw_place(tw, timer);
+  }
+
+  return NULL;
+}
+
+/**
+ * Read a monotonic clock
+ *
+ * @return uint64_t Milliseconds elapsed since an arbitrary point
+ */
+uint64_t tw_clock_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
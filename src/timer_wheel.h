@@ -0,0 +1,65 @@
+#ifndef LIBHASH_TIMER_WHEEL_H
+#define LIBHASH_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+/**
+ * Number of slots in each level of the wheel, and so the factor by which each
+ * level's granularity exceeds the one below
+ */
+#define TW_SLOTS 64
+#define TW_SLOT_BITS 6
+#define TW_LEVELS 6
+
+typedef struct tw_timer tw_timer;
+
+/**
+ * A timer, embedded in whatever it times
+ */
+struct tw_timer {
+  /**
+   * Tick at which the timer is due; 0 while the timer is not scheduled
+   */
+  uint64_t expires;
+
+  tw_timer *prev;
+  tw_timer *next;
+
+  unsigned char level;
+  unsigned char slot;
+};
+
+typedef struct {
+  /**
+   * The tick up to which the wheel has advanced
+   */
+  uint64_t now;
+
+  tw_timer *slots[TW_LEVELS][TW_SLOTS];
+
+  /**
+   * Timers due beyond the span of the top level. Each time the wheel reaches
+   * the start of a new span, the list collecting such timers is handed over
+   * to be cascaded, and the other list takes its place.
+   */
+  tw_timer *overflow[2];
+
+  /**
+   * Index of the list collecting timers due beyond the span of the top level
+   */
+  unsigned char overflow_index;
+
+  /**
+   * Bitmap of non-empty slots of each level
+   */
+  uint64_t occupied[TW_LEVELS];
+} timer_wheel;
+
+void tw_init(timer_wheel *tw, uint64_t now);
+void tw_schedule(timer_wheel *tw, tw_timer *timer, uint64_t expires);
+void tw_cancel(timer_wheel *tw, tw_timer *timer);
+tw_timer *tw_next_expired(timer_wheel *tw, uint64_t now,
+                          unsigned int *budget);
+uint64_t tw_clock_ms(void);
+
+#endif /* LIBHASH_TIMER_WHEEL_H */
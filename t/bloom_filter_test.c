@@ -0,0 +1,66 @@
+#include <stdio.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+static void test_no_false_negatives(void) {
+  const unsigned int n = 10000;
+  bloom_filter *bf = bf_init(n, 0.01);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    bf_insert(bf, buf);
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += bf_contains(bf, buf);
+  }
+  ok(found == n, "contains every inserted key");
+
+  unsigned int false_positives = 0;
+  for (unsigned int i = n; i < n * 11; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    false_positives += bf_contains(bf, buf);
+  }
+  ok(false_positives < n * 10 / 50, "keeps false positives near the target");
+
+  bf_delete_filter(bf);
+}
+
+static void test_fpr_tuning(void) {
+  bloom_filter *loose = bf_init(10000, 0.05);
+  bloom_filter *tight = bf_init(10000, 0.0001);
+
+  ok(bf_size(tight) > bf_size(loose), "sizes the filter to the target rate");
+  ok(bf_size(loose) % 64 == 0, "allocates whole cache lines");
+
+  bf_delete_filter(loose);
+  bf_delete_filter(tight);
+}
+
+static void test_from_set(void) {
+  hash_set *hs = hs_init(0);
+  hs_insert(hs, "k1");
+  hs_insert(hs, "k2");
+  hs_insert(hs, "k3");
+
+  bloom_filter *bf = bf_from_set(hs, 0.01);
+  ok(bf_contains(bf, "k1") && bf_contains(bf, "k2") && bf_contains(bf, "k3"),
+     "contains every key of the set");
+
+  bf_delete_filter(bf);
+  hs_delete_set(hs);
+
+  bf = bf_init(0, 0.01);
+  ok(bf_contains(bf, "k1") == 0, "an empty filter contains nothing");
+  bf_delete_filter(bf);
+}
+
+void run_bloom_filter_tests(void) {
+  test_no_false_negatives();
+  test_fpr_tuning();
+  test_from_set();
+}
@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+#define STRESS_THREADS 4
+#define STRESS_KEYS 20000
+
+typedef struct {
+  concurrent_hash_set *chs;
+  char (*keys)[16];
+  atomic_uint *wins;
+  atomic_uchar *done;
+  unsigned int offset;
+  unsigned int violations;
+} stress_ctx;
+
+static void *stress_writer(void *arg) {
+  stress_ctx *ctx = arg;
+
+  for (unsigned int n = 0; n < STRESS_KEYS; n++) {
+    // Every writer walks the keys from a different starting point so that
+    // the same key is contended at different moments
+    const unsigned int i = (n + ctx->offset) % STRESS_KEYS;
+
+    if (chs_insert(ctx->chs, ctx->keys[i])) {
+      atomic_fetch_add(&ctx->wins[i], 1);
+    }
+    atomic_store(&ctx->done[i], 1);
+  }
+
+  return NULL;
+}
+
+static void *stress_reader(void *arg) {
+  stress_ctx *ctx = arg;
+
+  for (unsigned int n = 0; n < STRESS_KEYS * 2; n++) {
+    const unsigned int i = (n * 7919) % STRESS_KEYS;
+
+    // An insert which has already returned must be visible to every lookup
+    // which starts after it
+    const unsigned char was_done = atomic_load(&ctx->done[i]);
+    if (was_done && !chs_contains(ctx->chs, ctx->keys[i])) {
+      ctx->violations++;
+    }
+  }
+
+  return NULL;
+}
+
+static void test_chs_insert(void) {
+  concurrent_hash_set *chs = chs_init(10);
+
+  ok(chs_insert(chs, "k1") == 1, "returns 1 when the key is new");
+  ok(chs_insert(chs, "k2") == 1, "returns 1 when another key is new");
+  ok(chs_count(chs) == 2, "increments the count when a key is inserted");
+
+  ok(chs_insert(chs, "k1") == 0, "returns 0 when the key already exists");
+  ok(chs_count(chs) == 2, "maintains the count on a duplicate insert");
+
+  chs_delete_set(chs);
+}
+
+static void test_chs_contains(void) {
+  concurrent_hash_set *chs = chs_init(10);
+
+  chs_insert(chs, "k1");
+  chs_insert(chs, "k2");
+
+  ok(chs_contains(chs, "k1") == 1, "contains the inserted key");
+  ok(chs_contains(chs, "k2") == 1, "contains the inserted key");
+  ok(chs_contains(chs, "k3") == 0, "returns 0 if the key was never inserted");
+
+  chs_delete_set(chs);
+}
+
+static void test_chs_resize(void) {
+  concurrent_hash_set *chs = chs_init(1);
+  char buf[16];
+
+  for (unsigned int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    chs_insert(chs, buf);
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += chs_contains(chs, buf);
+  }
+
+  ok(chs_count(chs) == 5000, "maintains the count across resizes");
+  ok(found == 5000, "retains every key across resizes");
+
+  lives({ chs_delete_set(chs); }, "frees the concurrent hash set heap memory");
+}
+
+static void test_chs_stress(void) {
+  concurrent_hash_set *chs = chs_init(1);
+  static char keys[STRESS_KEYS][16];
+  static atomic_uint wins[STRESS_KEYS];
+  static atomic_uchar done[STRESS_KEYS];
+
+  for (unsigned int i = 0; i < STRESS_KEYS; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "key-%u", i);
+    atomic_init(&wins[i], 0);
+    atomic_init(&done[i], 0);
+  }
+
+  pthread_t threads[STRESS_THREADS + 1];
+  stress_ctx ctxs[STRESS_THREADS + 1];
+
+  for (unsigned int t = 0; t <= STRESS_THREADS; t++) {
+    ctxs[t] = (stress_ctx){.chs = chs,
+                           .keys = keys,
+                           .wins = wins,
+                           .done = done,
+                           .offset = t * (STRESS_KEYS / STRESS_THREADS),
+                           .violations = 0};
+    pthread_create(&threads[t], NULL,
+                   t < STRESS_THREADS ? stress_writer : stress_reader,
+                   &ctxs[t]);
+  }
+
+  for (unsigned int t = 0; t <= STRESS_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  unsigned int single_winner = 0;
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < STRESS_KEYS; i++) {
+    single_winner += atomic_load(&wins[i]) == 1;
+    found += chs_contains(chs, keys[i]);
+  }
+
+  ok(single_winner == STRESS_KEYS,
+     "exactly one concurrent insert observes each key as new");
+  ok(chs_count(chs) == STRESS_KEYS, "counts each contended key once");
+  ok(found == STRESS_KEYS, "contains every key after concurrent inserts");
+  ok(ctxs[STRESS_THREADS].violations == 0,
+     "completed inserts are visible to subsequent lookups");
+
+  chs_delete_set(chs);
+}
+
+void run_concurrent_hash_set_tests(void) {
+  test_chs_insert();
+  test_chs_contains();
+  test_chs_resize();
+  test_chs_stress();
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+static void test_cms_estimate(void) {
+  const unsigned int n = 20000;
+  count_min_sketch *cms = cms_init(0.001, 0.01, 0);
+  hash_counter *exact = hcnt_init(0);
+
+  char buf[16];
+  uint64_t total = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    // A skewed stream: key j appears about n / (j + 1) times
+    snprintf(buf, sizeof(buf), "k%u", i % (i % 97 + 1));
+    cms_add(cms, buf, 1);
+    hcnt_add(exact, buf, 1);
+    total++;
+  }
+
+  unsigned int under = 0;
+  unsigned int over_bound = 0;
+  for (unsigned int j = 0; j < 97; j++) {
+    snprintf(buf, sizeof(buf), "k%u", j);
+    const uint64_t estimate = cms_estimate(cms, buf);
+    const uint64_t count = hcnt_get(exact, buf);
+
+    under += estimate < count;
+    over_bound += estimate > count + total / 1000;
+  }
+
+  ok(under == 0, "never undercounts");
+  ok(over_bound == 0, "overcounts by at most epsilon times the total");
+  ok(cms_estimate(cms, "absent") <= total / 1000,
+     "estimates an absent key within the bound");
+
+  hcnt_delete_counter(exact);
+  cms_delete_sketch(cms);
+}
+
+static void test_cms_top_k(void) {
+  count_min_sketch *cms = cms_init(0.001, 0.01, 3);
+
+  char buf[16];
+  for (unsigned int i = 0; i < 30000; i++) {
+    // Three heavy hitters amid a long tail of keys seen once
+    if (i % 10 == 0) {
+      cms_add(cms, "heavy-a", 3);
+    } else if (i % 10 == 1) {
+      cms_add(cms, "heavy-b", 2);
+    } else if (i % 10 == 2) {
+      cms_add(cms, "heavy-c", 1);
+    } else {
+      snprintf(buf, sizeof(buf), "tail-%u", i);
+      cms_add(cms, buf, 1);
+    }
+  }
+
+  hcnt_item top[3];
+  ok(cms_top_k(cms, top) == 3, "tracks k heavy hitters");
+  is(top[0].key, "heavy-a", "ranks the heaviest hitter first");
+  is(top[1].key, "heavy-b", "ranks the second heaviest hitter second");
+  is(top[2].key, "heavy-c", "ranks the third heaviest hitter third");
+  ok(top[0].count >= 9000, "reports the heavy hitters' estimates");
+
+  cms_delete_sketch(cms);
+}
+
+void run_count_min_sketch_tests(void) {
+  test_cms_estimate();
+  test_cms_top_k();
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+static unsigned int freed;
+
+static void count_free(void *value) {
+  freed++;
+  free(value);
+}
+
+static void test_lru(void) {
+  hash_cache *hc = hc_init(3, HC_LRU, NULL);
+
+  hc_put(hc, "k1", "v1");
+  hc_put(hc, "k2", "v2");
+  hc_put(hc, "k3", "v3");
+  is(hc_get(hc, "k1"), "v1", "retrieves the value");
+
+  // k2 is now the least recently used
+  hc_put(hc, "k4", "v4");
+  ok(hc_get(hc, "k2") == NULL, "evicts the least recently used entry");
+  ok(hc_get(hc, "k1") && hc_get(hc, "k3") && hc_get(hc, "k4"),
+     "retains the rest");
+  ok(hc_count(hc) == 3, "never exceeds the capacity");
+
+  hc_put(hc, "k3", "v3b");
+  is(hc_get(hc, "k3"), "v3b", "replaces the value of a cached key");
+  ok(hc_count(hc) == 3, "does not count a replaced entry twice");
+
+  ok(hc_delete(hc, "k1") == 1, "deletes an entry");
+  ok(hc_delete(hc, "k1") == 0, "cannot delete the same entry twice");
+  hc_put(hc, "k5", "v5");
+  ok(hc_get(hc, "k3") && hc_get(hc, "k4") && hc_get(hc, "k5"),
+     "reuses a deleted entry without evicting");
+
+  hc_delete_cache(hc);
+}
+
+static void test_clock(void) {
+  hash_cache *hc = hc_init(3, HC_CLOCK, NULL);
+
+  hc_put(hc, "k1", "v1");
+  hc_put(hc, "k2", "v2");
+  hc_put(hc, "k3", "v3");
+  hc_get(hc, "k1");
+  hc_get(hc, "k3");
+
+  // Only k2 has not been referenced
+  hc_put(hc, "k4", "v4");
+  ok(hc_get(hc, "k2") == NULL, "evicts an unreferenced entry");
+  ok(hc_get(hc, "k1") && hc_get(hc, "k3") && hc_get(hc, "k4"),
+     "gives referenced entries a second chance");
+
+  hc_delete_cache(hc);
+}
+
+static void test_free_value(void) {
+  freed = 0;
+  hash_cache *hc = hc_init(2, HC_LRU, count_free);
+
+  hc_put(hc, "k1", strdup("v1"));
+  hc_put(hc, "k2", strdup("v2"));
+  hc_put(hc, "k3", strdup("v3"));
+  ok(freed == 1, "frees the value of an evicted entry");
+
+  hc_put(hc, "k3", strdup("v3b"));
+  ok(freed == 2, "frees a replaced value");
+
+  hc_delete(hc, "k2");
+  ok(freed == 3, "frees the value of a deleted entry");
+
+  hc_delete_cache(hc);
+  ok(freed == 4, "frees the remaining values on delete");
+}
+
+static void test_churn(void) {
+  const unsigned int capacity = 100;
+  hash_cache *hc = hc_init(capacity, HC_LRU, NULL);
+
+  char buf[16];
+  for (unsigned int i = 0; i < capacity * 50; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hc_put(hc, buf, "x");
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = capacity * 49; i < capacity * 50; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += hc_get(hc, buf) != NULL;
+  }
+
+  ok(hc_count(hc) == capacity, "stays full under churn");
+  ok(found == capacity, "retains the most recent entries under churn");
+
+  hc_delete_cache(hc);
+}
+
+void run_hash_cache_tests(void) {
+  test_lru();
+  test_clock();
+  test_free_value();
+  test_churn();
+}
@@ -0,0 +1,167 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+#define STRESS_THREADS 4
+#define STRESS_KEYS 1000
+#define STRESS_ROUNDS 20
+
+static void test_hcnt_add(void) {
+  hash_counter *hcnt = hcnt_init(0);
+
+  ok(hcnt_add(hcnt, "a", 1) == 1, "starts a new key's count from 0");
+  ok(hcnt_add(hcnt, "a", 2) == 3, "adds to an existing key's count");
+  hcnt_add(hcnt, "b", 5);
+  ok(hcnt_get(hcnt, "a") == 3, "retrieves a key's count");
+  ok(hcnt_get(hcnt, "c") == 0, "retrieves 0 for a key which is not counted");
+  ok(hcnt_count(hcnt) == 2, "counts the distinct keys");
+  ok(hcnt_total(hcnt) == 8, "sums the counts of every key");
+
+  ok(hcnt_remove(hcnt, "a") == 3, "returns the count of a removed key");
+  ok(hcnt_remove(hcnt, "a") == 0, "returns 0 when removing an absent key");
+  ok(hcnt_get(hcnt, "a") == 0, "forgets a removed key");
+  ok(hcnt_count(hcnt) == 1 && hcnt_total(hcnt) == 5,
+     "excludes a removed key from the count and total");
+
+  hcnt_delete_counter(hcnt);
+}
+
+static void test_hcnt_resize(void) {
+  const unsigned int n = 20000;
+  hash_counter *hcnt = hcnt_init(0);
+
+  char buf[16];
+  for (unsigned int round = 0; round < 3; round++) {
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(buf, sizeof(buf), "k%u", i);
+      hcnt_add(hcnt, buf, i);
+    }
+  }
+
+  // Churn through removals and re-insertions, leaving deleted slots behind
+  for (unsigned int i = 0; i < n; i += 2) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hcnt_remove(hcnt, buf);
+    hcnt_add(hcnt, buf, 1);
+  }
+
+  unsigned int wrong = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    wrong += hcnt_get(hcnt, buf) != (i % 2 ? 3 * (uint64_t)i : 1);
+  }
+  ok(wrong == 0, "retains every count across resizes");
+  ok(hcnt_count(hcnt) == n, "retains every key across resizes");
+
+  hcnt_delete_counter(hcnt);
+}
+
+static void test_hcnt_top_k(void) {
+  const unsigned int n = 5000;
+  hash_counter *hcnt = hcnt_init(0);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    // Counts rise and fall, and repeat, so that ties occur
+    hcnt_add(hcnt, buf, (i * 7919) % 1000);
+  }
+
+  hcnt_item top[10];
+  ok(hcnt_top_k(hcnt, 10, top) == 10, "returns k items");
+
+  unsigned int sorted = 1;
+  for (unsigned int i = 1; i < 10; i++) {
+    sorted &= top[i - 1].count >= top[i].count;
+  }
+  ok(sorted, "returns the items highest count first");
+  ok(top[0].count == 999 && top[4].count == 999 && top[9].count == 998,
+     "returns the items with the highest counts");
+
+  hcnt_item all[3];
+  hash_counter *small = hcnt_init(0);
+  hcnt_add(small, "x", 1);
+  hcnt_add(small, "y", 2);
+  ok(hcnt_top_k(small, 3, all) == 2, "returns every item if there are few");
+  is(all[0].key, "y", "ranks the highest count first");
+  ok(hcnt_top_k(small, 0, all) == 0, "returns nothing if k is 0");
+
+  hcnt_delete_counter(small);
+  hcnt_delete_counter(hcnt);
+}
+
+typedef struct {
+  concurrent_hash_counter *chcnt;
+  char (*keys)[16];
+} stress_ctx;
+
+static void *stress_counter(void *arg) {
+  stress_ctx *ctx = arg;
+
+  for (unsigned int round = 0; round < STRESS_ROUNDS; round++) {
+    for (unsigned int i = 0; i < STRESS_KEYS; i++) {
+      chcnt_add(ctx->chcnt, ctx->keys[i], 1);
+    }
+  }
+
+  return NULL;
+}
+
+static void test_chcnt_add(void) {
+  concurrent_hash_counter *chcnt = chcnt_init(2);
+
+  ok(chcnt_add(chcnt, "a", 2) == 1, "counts a new key");
+  ok(chcnt_add(chcnt, "a", 3) == 1, "counts an existing key");
+  ok(chcnt_get(chcnt, "a") == 5, "retrieves a key's count");
+  ok(chcnt_add(chcnt, "b", 1) == 1, "counts keys up to the max");
+  ok(chcnt_add(chcnt, "c", 1) == 0, "refuses a new key once full");
+  ok(chcnt_add(chcnt, "b", 1) == 1, "counts existing keys once full");
+  ok(chcnt_count(chcnt) == 2, "counts the distinct keys");
+  ok(chcnt_get(chcnt, "c") == 0, "retrieves 0 for a key which is not counted");
+
+  chcnt_delete_counter(chcnt);
+}
+
+static void test_chcnt_stress(void) {
+  concurrent_hash_counter *chcnt = chcnt_init(STRESS_KEYS);
+  char(*keys)[16] = malloc(sizeof(*keys) * STRESS_KEYS);
+  for (unsigned int i = 0; i < STRESS_KEYS; i++) {
+    snprintf(keys[i], sizeof(keys[i]), "k%u", i);
+  }
+
+  stress_ctx ctx = {.chcnt = chcnt, .keys = keys};
+  pthread_t threads[STRESS_THREADS];
+  for (unsigned int t = 0; t < STRESS_THREADS; t++) {
+    pthread_create(&threads[t], NULL, stress_counter, &ctx);
+  }
+  for (unsigned int t = 0; t < STRESS_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  unsigned int wrong = 0;
+  for (unsigned int i = 0; i < STRESS_KEYS; i++) {
+    wrong += chcnt_get(chcnt, keys[i]) != STRESS_THREADS * STRESS_ROUNDS;
+  }
+  ok(chcnt_count(chcnt) == STRESS_KEYS, "claims one slot per key");
+  ok(wrong == 0, "loses no concurrent increment");
+
+  hcnt_item top[3];
+  ok(chcnt_top_k(chcnt, 3, top) == 3 &&
+         top[0].count == STRESS_THREADS * STRESS_ROUNDS,
+     "returns the keys with the highest counts");
+
+  free(keys);
+  chcnt_delete_counter(chcnt);
+}
+
+void run_hash_counter_tests(void) {
+  test_hcnt_add();
+  test_hcnt_resize();
+  test_hcnt_top_k();
+  test_chcnt_add();
+  test_chcnt_stress();
+}
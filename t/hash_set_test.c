@@ -1,5 +1,6 @@
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "libhash.h"
 #include "prime.h"
@@ -12,7 +13,7 @@ static void test_initialization(void) {
   hash_set *hs = hs_init(capacity);
 
   ok(hs != NULL, "hash set is not NULL");
-  ok(hs->base_capacity == capacity, "given base capacity has been set");
+  ok(hs->base_capacity == (size_t)capacity, "given base capacity has been set");
 
   ok(hs->capacity == next_prime(capacity), "given base capacity has been set");
 
@@ -35,7 +36,7 @@ static void test_insert(void) {
   ok(hs_contains(hs, k1) == 1, "contains the originally inserted key");
   ok(hs_contains(hs, k2) == 1, "contains the inserted key");
 
-  hs_insert(hs, k1);
+  ok(hs_insert(hs, k1) == 0, "returns 0 when the key already exists");
   ok(hs->count == 2,
      "maintains the count, as the preceding insert was an update operation");
   ok(hs_contains(hs, k1) == 1, "contains the re-inserted key");
@@ -43,7 +44,7 @@ static void test_insert(void) {
   hs_delete(hs, k1);
   ok(hs->count == 1, "count after deletion");
 
-  hs_insert(hs, k1);
+  ok(hs_insert(hs, k1) == 1, "returns 1 when the key is new");
   ok(hs->count == 2, "count after insertion");
   ok(hs_contains(hs, k1), "inserts the key clean after having been deleted");
 }
@@ -125,6 +126,413 @@ static void test_contains_miss(void) {
   ok(hs_contains(hs, "key2") == 0, "does not contain the key");
 }
 
+static void test_build(void) {
+  const char *keys[] = {"k1", "k2", "k3", "k1"};
+
+  hash_set *hs = hs_build(keys, 4, 2);
+  ok(hs->count == 3, "counts each distinct key once");
+  ok(hs_contains(hs, "k1") && hs_contains(hs, "k2") && hs_contains(hs, "k3"),
+     "contains every built key");
+  hs_delete_set(hs);
+
+  const unsigned int n = 40000;
+  char(*bufs)[16] = malloc(sizeof(*bufs) * n);
+  const char **many = malloc(sizeof(char *) * n);
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "k%u", i % (n / 2));
+    many[i] = bufs[i];
+  }
+
+  hs = hs_build(many, n, 4);
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n / 2; i++) {
+    found += hs_contains(hs, many[i]);
+  }
+
+  ok(hs->count == n / 2, "deduplicates keys across a parallel build");
+  ok(found == n / 2, "contains every key of a parallel build");
+  ok(hs_insert(hs, "extra") == 1, "accepts inserts after a build");
+
+  hs_delete_set(hs);
+  free(many);
+  free(bufs);
+}
+
+static void delete_visit(const char *key, void *ctx) {
+  hs_delete(ctx, key);
+}
+
+static void count_visit(const char *key, void *ctx) {
+  (void)key;
+  (*(unsigned int *)ctx)++;
+}
+
+static void test_delete_collisions(void) {
+  const unsigned int n = 30;
+  hash_set *hs = hs_init(0);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+  }
+
+  for (unsigned int i = 0; i < n; i += 2) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_delete(hs, buf);
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = 1; i < n; i += 2) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += hs_contains(hs, buf);
+  }
+  ok(found == n / 2, "finds keys which collided with a deleted key");
+
+  snprintf(buf, sizeof(buf), "k%u", 1);
+  ok(hs_insert(hs, buf) == 0, "does not reinsert a key past a deleted slot");
+  ok(hs->count == n / 2, "maintains the count across deletions");
+
+  hs_delete_set(hs);
+}
+
+static void test_churn(void) {
+  hash_set *hs = hs_init(0);
+  char buf[16];
+
+  // Keep about 100 keys live while many more pass through the set
+  bool bounded = true;
+  for (unsigned int i = 0; i < 20000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+
+    if (i >= 100) {
+      snprintf(buf, sizeof(buf), "k%u", i - 100);
+      hs_delete(hs, buf);
+    }
+
+    // The load is checked, rounded down, before each insertion, which may
+    // then take one more slot
+    if (hs->capacity != HT_SMALL_CAPACITY &&
+        (hs->count + hs->deleted - 1) * 100 >= hs->capacity * 71) {
+      bounded = false;
+    }
+  }
+  ok(bounded, "rehashes once deleted slots fill the array");
+  ok(hs->capacity < 1000, "does not grow when only deleted slots fill it");
+
+  hs_stats stats;
+  hs_get_stats(hs, &stats);
+  ok(stats.tombstones == hs->deleted, "counts the deleted slots");
+
+  hs_delete_set(hs);
+}
+
+static void test_cursor(void) {
+  const unsigned int n = 100;
+  hash_set *hs = hs_init(0);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+  }
+
+  unsigned char seen[100] = {0};
+  hs_cursor cursor;
+  hs_cursor_init(hs, &cursor);
+  for (unsigned int i = 0; i < n / 2; i++) {
+    seen[strtoul(hs_cursor_next(hs, &cursor) + 1, NULL, 10)] = 1;
+  }
+
+  // Grow the set several times over while the cursor is suspended
+  const unsigned int generation = hs->generation;
+  for (unsigned int i = n; i < n * 10; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+  }
+  ok(hs->generation != generation, "resizes the set mid-scan");
+
+  const char *key;
+  while ((key = hs_cursor_next(hs, &cursor)) != NULL) {
+    const unsigned long idx = strtoul(key + 1, NULL, 10);
+    if (idx < n) {
+      seen[idx] = 1;
+    }
+  }
+
+  unsigned int missing = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    missing += !seen[i];
+  }
+  ok(missing == 0, "returns every key present for the whole scan");
+
+  hs_cursor_init(hs, &cursor);
+  while (hs_scan(hs, &cursor, 16, delete_visit, hs)) {
+  }
+  ok(hs->count == 0, "may delete each visited key");
+
+  // Churn a few keys between calls, each step deleting one and inserting
+  // another, so that the set rehashes in place more often than the scan
+  // could visit every slot
+  for (unsigned int i = 0; i < 10; i++) {
+    snprintf(buf, sizeof(buf), "c%u", i);
+    hs_insert(hs, buf);
+  }
+
+  unsigned int visited = 0;
+  hs_cursor_init(hs, &cursor);
+  unsigned int steps = 0;
+  while (steps < 100000 && hs_scan(hs, &cursor, 1, count_visit, &visited)) {
+    snprintf(buf, sizeof(buf), "c%u", steps);
+    hs_delete(hs, buf);
+    snprintf(buf, sizeof(buf), "c%u", steps + 10);
+    hs_insert(hs, buf);
+    steps++;
+  }
+  ok(steps < 100000, "finishes a scan of a set under churn");
+
+  hs_delete_set(hs);
+}
+
+static void test_freeze(void) {
+  hash_set *hs = hs_init(0);
+  hs_insert(hs, "k1");
+  hs_insert(hs, "k2");
+  hs_insert(hs, "k3");
+  hs_delete(hs, "k2");
+
+  frozen_hash_set *fhs = hs_freeze(hs);
+  ok(fhs != NULL, "freezes a set");
+  ok(fhs_count(fhs) == 2, "maintains the count");
+  ok(fhs_contains(fhs, "k1") && fhs_contains(fhs, "k3"),
+     "contains every key");
+  ok(fhs_contains(fhs, "k2") == 0, "omits deleted keys");
+  ok(fhs_contains(fhs, "k4") == 0, "verifies the key in its slot");
+
+  fhs_delete_set(fhs);
+}
+
+/**
+ * Fill a set with the keys "k<i>" for each `i` in [0, n) divisible by `step`
+ */
+static hash_set *multiples_set(unsigned int n, unsigned int step) {
+  hash_set *hs = hs_init(0);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i += step) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+  }
+
+  return hs;
+}
+
+/**
+ * Count the keys "k<i>" for `i` in [0, n) whose membership in the set differs
+ * from `expected(i)`
+ */
+static unsigned int set_mismatches(hash_set *hs, unsigned int n,
+                                   int (*expected)(unsigned int)) {
+  unsigned int mismatches = 0;
+  unsigned int count = 0;
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    mismatches += hs_contains(hs, buf) != expected(i);
+    count += expected(i);
+  }
+
+  return mismatches + (hs->count != count);
+}
+
+static int in_union(unsigned int i) { return i % 2 == 0 || i % 3 == 0; }
+static int in_intersection(unsigned int i) { return i % 6 == 0; }
+static int in_difference(unsigned int i) { return i % 2 == 0 && i % 3 != 0; }
+static int in_reverse_difference(unsigned int i) {
+  return i % 3 == 0 && i % 2 != 0;
+}
+static int in_all_but_3(unsigned int i) { return i != 3; }
+
+static void test_set_algebra(void) {
+  const unsigned int sizes[] = {300, 50000};
+
+  for (unsigned int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    const unsigned int n = sizes[k];
+    hash_set *a = multiples_set(n, 2);
+    hash_set *b = multiples_set(n, 3);
+    // Leave deleted slots behind in `a`
+    hs_insert(a, "gone");
+    hs_delete(a, "gone");
+
+    hash_set *u = hs_union(a, b, 4);
+    ok(set_mismatches(u, n, in_union) == 0, "computes a union (%u)", n);
+
+    hash_set *i1 = hs_intersect(a, b, 4);
+    hash_set *i2 = hs_intersect(b, a, 1);
+    ok(set_mismatches(i1, n, in_intersection) == 0 &&
+           set_mismatches(i2, n, in_intersection) == 0,
+       "computes an intersection either way round (%u)", n);
+
+    hash_set *d1 = hs_difference(a, b, 4);
+    hash_set *d2 = hs_difference(b, a, 1);
+    ok(set_mismatches(d1, n, in_difference) == 0 &&
+           set_mismatches(d2, n, in_reverse_difference) == 0,
+       "computes a difference either way round (%u)", n);
+
+    ok(set_mismatches(a, n, in_difference) != 0 &&
+           set_mismatches(b, n, in_reverse_difference) != 0,
+       "leaves the operands unchanged (%u)", n);
+
+    hs_insert(i1, "new");
+    ok(hs_contains(i1, "new") && hs_contains(i1, "k0"),
+       "produces a set which remains usable (%u)", n);
+
+    hs_delete_set(u);
+    hs_delete_set(i1);
+    hs_delete_set(i2);
+    hs_delete_set(d1);
+    hs_delete_set(d2);
+    hs_delete_set(b);
+    hs_delete_set(a);
+  }
+}
+
+static void test_set_algebra_in_place(void) {
+  const unsigned int n = 3000;
+  hash_set *b = multiples_set(n, 3);
+
+  hash_set *a = multiples_set(n, 2);
+  hs_union_into(a, b);
+  ok(set_mismatches(a, n, in_union) == 0, "computes a union in place");
+  hs_delete_set(a);
+
+  // Both the smaller and the larger set may be the destination
+  a = multiples_set(n, 2);
+  hs_intersect_into(a, b, 1);
+  ok(set_mismatches(a, n, in_intersection) == 0,
+     "computes an intersection in place into the larger set");
+  hs_delete_set(a);
+
+  a = multiples_set(n, 2);
+  hash_set *c = multiples_set(n, 3);
+  hs_intersect_into(c, a, 1);
+  ok(set_mismatches(c, n, in_intersection) == 0,
+     "computes an intersection in place into the smaller set");
+  hs_delete_set(c);
+
+  hs_difference_into(a, b, 1);
+  ok(set_mismatches(a, n, in_difference) == 0,
+     "computes a difference in place from the larger set");
+  hs_delete_set(a);
+
+  a = multiples_set(n, 2);
+  c = multiples_set(n, 3);
+  hs_difference_into(c, a, 1);
+  ok(set_mismatches(c, n, in_reverse_difference) == 0,
+     "computes a difference in place from the smaller set");
+  hs_delete_set(c);
+
+  hs_difference_into(a, a, 1);
+  ok(a->count == 0 && !hs_contains(a, "k0"),
+     "empties a set when subtracting it from itself");
+  hs_union_into(a, a);
+  hs_intersect_into(a, a, 1);
+  ok(a->count == 0, "combines a set with itself");
+
+  hs_delete_set(a);
+  hs_delete_set(b);
+}
+
+static void test_stats(void) {
+  hash_set *hs = multiples_set(3000, 2);
+  hs_delete(hs, "k0");
+
+  hs_stats stats;
+  hs_get_stats(hs, &stats);
+
+  unsigned int histogram_total = 0;
+  for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+    histogram_total += stats.probe_lengths[i];
+  }
+  ok(stats.count == hs->count && stats.tombstones == 1 &&
+         histogram_total == hs->count,
+     "reports the shape of a set");
+
+#ifdef LIBHASH_STATS
+  ok(stats.counters.resizes > 0 &&
+         stats.counters.allocations > stats.counters.resizes,
+     "counts resizes and allocations");
+#else
+  ok(stats.counters.resizes == 0 && stats.counters.allocations == 0,
+     "keeps no counters unless enabled");
+#endif
+
+  hs_delete_set(hs);
+}
+
+static void test_small(void) {
+  hash_set *hs = hs_init(0);
+  char buf[16];
+
+  for (unsigned int i = 0; i < HT_SMALL_CAPACITY; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hs_insert(hs, buf);
+  }
+  ok(hs->capacity == HT_SMALL_CAPACITY && hs->count == HT_SMALL_CAPACITY &&
+         hs_insert(hs, "k0") == 0,
+     "holds up to %d keys in the small layout", HT_SMALL_CAPACITY);
+
+  hs_delete(hs, "k3");
+  ok(hs_insert(hs, "k8") == 1 && hs->capacity == HT_SMALL_CAPACITY,
+     "reuses the slots of deleted keys");
+
+  hs_insert(hs, "k9");
+  ok(hs->capacity == next_prime(HS_DEFAULT_CAPACITY),
+     "moves to the hashed layout once full");
+  ok(set_mismatches(hs, 10, in_all_but_3) == 0,
+     "keeps every key when it moves");
+  hs_delete_set(hs);
+
+  // Each operand may be small, whether as the source or the destination
+  hash_set *a = multiples_set(12, 2);
+  hash_set *b = multiples_set(12, 3);
+  hash_set *big = multiples_set(300, 3);
+  hash_set *u = hs_union(a, b, 1);
+  hash_set *i1 = hs_intersect(a, big, 1);
+  hash_set *d1 = hs_difference(a, b, 1);
+  hash_set *d2 = hs_difference(a, big, 1);
+  ok(set_mismatches(u, 12, in_union) == 0 &&
+         set_mismatches(i1, 12, in_intersection) == 0 &&
+         set_mismatches(d1, 12, in_difference) == 0 &&
+         set_mismatches(d2, 12, in_difference) == 0,
+     "combines sets in the small layout");
+
+  hs_intersect_into(b, a, 1);
+  hash_set *c = multiples_set(12, 2);
+  hs_intersect_into(c, b, 1);
+  hs_difference_into(a, b, 1);
+  ok(set_mismatches(b, 12, in_intersection) == 0 &&
+         set_mismatches(c, 12, in_intersection) == 0 &&
+         set_mismatches(a, 12, in_difference) == 0,
+     "combines sets in the small layout in place");
+  hs_delete_set(c);
+
+  hs_insert(d1, "new");
+  ok(hs_contains(d1, "new") && hs_contains(d1, "k2") && d1->count == 5,
+     "produces a small set which remains usable");
+
+  hs_delete_set(u);
+  hs_delete_set(i1);
+  hs_delete_set(d1);
+  hs_delete_set(d2);
+  hs_delete_set(big);
+  hs_delete_set(b);
+  hs_delete_set(a);
+}
+
 void run_hash_set_tests(void) {
   test_initialization();
   test_insert();
@@ -132,4 +540,13 @@ void run_hash_set_tests(void) {
   test_delete();
   test_capacity();
   test_contains_miss();
+  test_build();
+  test_delete_collisions();
+  test_churn();
+  test_cursor();
+  test_freeze();
+  test_set_algebra();
+  test_set_algebra_in_place();
+  test_stats();
+  test_small();
 }
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -170,6 +171,890 @@ static void test_ht_iterate(void) {
   HT_ITER_END
 }
 
+static void test_ht_parallel_resize(void) {
+  const unsigned int n = HT_PARALLEL_RESIZE_MIN * 3;
+  hash_table *ht = ht_init(0, NULL);
+  ht_set_resize_threads(ht, 4);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+
+  unsigned int iterated = 0;
+  HT_ITER_START(ht)
+  iterated += entry != NULL;
+  HT_ITER_END
+
+  ok(ht->count == n, "maintains the count across parallel resizes");
+  ok(found == n, "retains every entry across parallel resizes");
+  ok(iterated == n, "rebuilds the occupied buckets across parallel resizes");
+
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_delete(ht, buf);
+  }
+  ok(ht->count == 0, "shrinks back down in parallel");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_build(void) {
+  const char *keys[] = {"k1", "k2", "k3", "k1"};
+  void *values[] = {"v1", "v2", "v3", "v4"};
+
+  hash_table *ht = ht_build(keys, values, 4, NULL, 2);
+  ok(ht->count == 3, "counts each distinct key once");
+  is(ht_get(ht, "k1"), "v4", "applies duplicate keys in array order");
+  is(ht_get(ht, "k2"), "v2", "retrieves the built value");
+  ht_delete_table(ht);
+
+  const unsigned int n = 40000;
+  char(*bufs)[16] = malloc(sizeof(*bufs) * n);
+  const char **many = malloc(sizeof(char *) * n);
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(bufs[i], sizeof(bufs[i]), "k%u", i % (n / 2));
+    many[i] = bufs[i];
+  }
+
+  ht = ht_build(many, NULL, n, NULL, 4);
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n / 2; i++) {
+    found += ht_search(ht, many[i]) != NULL;
+  }
+
+  unsigned int iterated = 0;
+  HT_ITER_START(ht)
+  iterated += entry != NULL;
+  HT_ITER_END
+
+  ok(ht->count == n / 2, "deduplicates keys across a parallel build");
+  ok(found == n / 2, "retrieves every key of a parallel build");
+  ok(iterated == n / 2, "records the occupied buckets of a parallel build");
+
+  ht_insert(ht, "extra", "x");
+  is(ht_get(ht, "extra"), "x", "accepts inserts after a build");
+
+  ht_delete_table(ht);
+  free(many);
+  free(bufs);
+}
+
+typedef struct {
+  unsigned int count;
+  unsigned int max;
+} scan_stats;
+
+static void count_visit(ht_entry *entry, void *ctx) {
+  (void)entry;
+  atomic_fetch_add((atomic_uint *)ctx, 1);
+}
+
+static void stats_reduce(void *acc, ht_entry *entry, void *ctx) {
+  (void)ctx;
+  scan_stats *stats = acc;
+  const unsigned int n = (unsigned int)strtoul(entry->key + 1, NULL, 10);
+
+  stats->count++;
+  if (n > stats->max) {
+    stats->max = n;
+  }
+}
+
+static void stats_combine(void *acc, const void *other, void *ctx) {
+  (void)ctx;
+  scan_stats *stats = acc;
+  const scan_stats *other_stats = other;
+
+  stats->count += other_stats->count;
+  if (other_stats->max > stats->max) {
+    stats->max = other_stats->max;
+  }
+}
+
+static void test_ht_parallel_scan(void) {
+  const unsigned int n = 20000;
+  hash_table *ht = ht_init(0, NULL);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+  ht_delete(ht, "k0");
+
+  atomic_uint visited;
+  atomic_init(&visited, 0);
+  ht_parallel_for_each(ht, count_visit, &visited, 4);
+  ok(atomic_load(&visited) == n - 1, "visits every entry exactly once");
+
+  atomic_init(&visited, 0);
+  const unsigned int mid = ht->capacity / 2;
+  ht_for_each_range(ht, 0, mid, count_visit, &visited);
+  ht_for_each_range(ht, mid, UINT_MAX, count_visit, &visited);
+  ok(atomic_load(&visited) == n - 1, "slot ranges partition the entries");
+
+  scan_stats stats = {0, 0};
+  ht_reduce(ht, &stats, sizeof(stats), stats_reduce, stats_combine, NULL, 4);
+  ok(stats.count == n - 1, "reduces every entry exactly once");
+  ok(stats.max == n - 1, "combines the per-thread accumulators");
+
+  ht_delete_table(ht);
+}
+
+typedef struct {
+  hash_table *ht;
+  unsigned int visited;
+} sweep_ctx;
+
+static void delete_visit(ht_entry *entry, void *ctx) {
+  sweep_ctx *sweep = ctx;
+
+  sweep->visited++;
+  ht_delete(sweep->ht, entry->key);
+}
+
+static void test_ht_cursor(void) {
+  const unsigned int n = 100;
+  hash_table *ht = ht_init(0, NULL);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+
+  unsigned char seen[100] = {0};
+  ht_cursor cursor;
+  ht_cursor_init(ht, &cursor);
+  for (unsigned int i = 0; i < n / 2; i++) {
+    ht_entry *r = ht_cursor_next(ht, &cursor);
+    seen[strtoul(r->key + 1, NULL, 10)] = 1;
+  }
+
+  // Grow the table several times over while the cursor is suspended
+  const unsigned int generation = ht->generation;
+  for (unsigned int i = n; i < n * 10; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+  ok(ht->generation != generation, "resizes the table mid-scan");
+
+  ht_entry *r;
+  while ((r = ht_cursor_next(ht, &cursor)) != NULL) {
+    const unsigned long idx = strtoul(r->key + 1, NULL, 10);
+    if (idx < n) {
+      seen[idx] = 1;
+    }
+  }
+
+  unsigned int missing = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    missing += !seen[i];
+  }
+  ok(missing == 0, "returns every entry present for the whole scan");
+
+  for (unsigned int i = n * 10; i < n * 20; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+  ok(ht_cursor_next(ht, &cursor) == NULL,
+     "remains complete after subsequent resizes");
+
+  ht_delete_table(ht);
+
+  ht = init_test_ht();
+  unsigned int pairs = 0;
+  ht_cursor outer;
+  ht_cursor_init(ht, &outer);
+  while (ht_cursor_next(ht, &outer) != NULL) {
+    ht_cursor inner;
+    ht_cursor_init(ht, &inner);
+    while (ht_cursor_next(ht, &inner) != NULL) {
+      pairs++;
+    }
+  }
+  ok(pairs == 9, "supports nested cursors");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_scan(void) {
+  const unsigned int n = 1000;
+  hash_table *ht = ht_init(0, NULL);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+
+  sweep_ctx sweep = {ht, 0};
+  ht_cursor cursor;
+  ht_cursor_init(ht, &cursor);
+
+  unsigned int slices = 1;
+  while (ht_scan(ht, &cursor, 16, delete_visit, &sweep)) {
+    slices++;
+  }
+
+  ok(ht->count == 0, "may delete each visited entry");
+  ok(sweep.visited == n, "visits each entry until it is deleted");
+  ok(slices > ht->capacity / 16, "visits at most `budget` slots per call");
+
+  // Churn a few keys between calls, each step deleting one and inserting
+  // another
+  for (unsigned int i = 0; i < 10; i++) {
+    snprintf(buf, sizeof(buf), "c%u", i);
+    ht_insert(ht, buf, "x");
+  }
+
+  atomic_uint visited;
+  atomic_init(&visited, 0);
+  ht_cursor_init(ht, &cursor);
+  unsigned int steps = 0;
+  while (steps < 100000 && ht_scan(ht, &cursor, 16, count_visit, &visited)) {
+    snprintf(buf, sizeof(buf), "c%u", steps);
+    ht_delete(ht, buf);
+    snprintf(buf, sizeof(buf), "c%u", steps + 10);
+    ht_insert(ht, buf, "x");
+    steps++;
+  }
+  ok(steps < 100000, "finishes a scan of a table under churn");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_freeze(void) {
+  const unsigned int n = 1000;
+  hash_table *ht = ht_init(0, free);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, strdup(buf));
+  }
+  ht_delete(ht, "k0");
+
+  frozen_hash_table *fht = ht_freeze(ht);
+  ok(fht != NULL, "freezes a table");
+  ok(fht_count(fht) == n - 1, "maintains the count");
+
+  unsigned int matched = 0;
+  for (unsigned int i = 1; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    const char *value = fht_get(fht, buf);
+    matched += value != NULL && strcmp(value, buf) == 0;
+  }
+  ok(matched == n - 1, "retrieves every value");
+  ok(fht_search(fht, "k0") == NULL, "omits deleted entries");
+  ok(fht_search(fht, "missing") == NULL, "verifies the key in its slot");
+
+  fht_delete_table(fht);
+
+  fht = ht_freeze(ht_init(0, NULL));
+  ok(fht_search(fht, "k1") == NULL, "freezes an empty table");
+  fht_delete_table(fht);
+}
+
+static uint64_t fake_now;
+
+static uint64_t fake_clock(void) { return fake_now; }
+
+static void test_ht_ttl(void) {
+  fake_now = 1000;
+  hash_table *ht = ht_init_ttl(0, NULL, fake_clock);
+
+  ht_insert_ttl(ht, "short", "v1", 10);
+  ht_insert_ttl(ht, "long", "v2", 100000);
+  ht_insert(ht, "forever", "v3");
+  ht_insert_ttl(ht, "reset", "v4", 10);
+  ht_insert(ht, "reset", "v5");
+
+  fake_now += 9;
+  is(ht_get(ht, "short"), "v1", "retains an entry until it expires");
+
+  fake_now += 1;
+  ok(ht_get(ht, "short") == NULL, "expires an entry lazily on lookup");
+  ok(ht->count == 3, "removes a lazily expired entry");
+  is(ht_get(ht, "reset"), "v5", "clears the ttl of a replaced entry");
+
+  fake_now += 100000;
+  ok(ht_expire_step(ht, 1000) == 1, "expires due entries in a step");
+  ok(ht->count == 2, "removes entries expired in a step");
+  is(ht_get(ht, "forever"), "v3", "never expires an entry without a ttl");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_expire_step(void) {
+  const unsigned int n = 1000;
+  fake_now = 0;
+  hash_table *ht = ht_init_ttl(0, NULL, fake_clock);
+
+  // Spread expiries across every level of the wheel
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert_ttl(ht, buf, "x", 1 + (uint64_t)i * i * i);
+  }
+  ht_delete(ht, "k1");
+
+  fake_now = (uint64_t)(n / 2) * (n / 2) * (n / 2);
+  unsigned int expired = 0;
+  unsigned int steps = 0;
+  unsigned int r;
+  while ((r = ht_expire_step(ht, 8)) > 0 || steps == 0) {
+    expired += r;
+    steps++;
+  }
+  // The last steps may only cascade timers
+  while (ht->count > n / 2 && steps < n * 10) {
+    expired += ht_expire_step(ht, 8);
+    steps++;
+  }
+
+  ok(expired == n / 2 - 1, "expires exactly the due entries");
+  ok(steps > 1, "bounds the work done by each step");
+
+  unsigned int retained = 0;
+  for (unsigned int i = n / 2; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    retained += ht_get(ht, buf) != NULL;
+  }
+  ok(retained == n / 2, "retains the entries which are not due");
+
+  fake_now = UINT64_MAX / 2;
+  while (ht_expire_step(ht, 1000000) > 0) {
+  }
+  ok(ht->count == 0, "eventually expires every entry");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_stats(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[32];
+
+  const unsigned int n = 1000;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, NULL);
+  }
+  // Few enough deletions that the table does not shrink
+  for (unsigned int i = 0; i < 100; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_delete(ht, buf);
+  }
+
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+  ok(stats.capacity == ht->capacity && stats.count == n - 100,
+     "reports the capacity and count");
+  ok(stats.tombstones == 100, "counts the slots of deleted entries");
+  ok(fabs(stats.load_factor - (double)stats.count / stats.capacity) < 1e-9,
+     "reports the load factor");
+
+  unsigned int histogram_total = 0;
+  unsigned int last_bucket = 0;
+  for (unsigned int i = 0; i < HT_STATS_PROBE_BUCKETS; i++) {
+    histogram_total += stats.probe_lengths[i];
+    if (stats.probe_lengths[i] > 0) {
+      last_bucket = i;
+    }
+  }
+  ok(histogram_total == stats.count, "places every entry in the histogram");
+  ok(stats.probe_lengths[0] > 0 && stats.max_displacement >= last_bucket &&
+         stats.mean_displacement <= stats.max_displacement,
+     "reports the displacement of entries");
+
+#ifdef LIBHASH_STATS
+  ok(stats.counters.resizes > 0 && stats.counters.resize_ns > 0,
+     "counts resizes and the time spent on them");
+  ok(stats.counters.allocations >= n * 3 &&
+         stats.counters.allocated_bytes > n * sizeof(ht_entry),
+     "counts allocations");
+#else
+  ok(stats.counters.resizes == 0 && stats.counters.resize_ns == 0,
+     "keeps no resize counters unless enabled");
+  ok(stats.counters.allocations == 0 && stats.counters.allocated_bytes == 0,
+     "keeps no allocation counters unless enabled");
+#endif
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_hash_mode(void) {
+  hash_table *ht = init_test_ht();
+  char buf[32];
+
+  const unsigned int n = 500;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "v");
+  }
+
+  ht_set_hash_mode(ht, HT_HASH_SEEDED);
+  const uint64_t seed[2] = {ht->seed[0], ht->seed[1]};
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == n && ht->count == n, "rehashes every entry under a keyed hash");
+
+  ht_set_hash_mode(ht, HT_HASH_SEEDED);
+  ok(ht->seed[0] != seed[0] || ht->seed[1] != seed[1],
+     "draws a fresh seed each time");
+
+  ht_delete(ht, "k0");
+  ht_insert(ht, "k0", "w");
+  is("w", ht_get(ht, "k0"), "inserts and deletes under a keyed hash");
+
+  ht_set_hash_mode(ht, HT_HASH_CRC32C);
+  found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == n, "rehashes every entry under CRC32C");
+
+  ht_set_hash_mode(ht, HT_HASH_DEFAULT);
+  found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == n, "switches back to the default hash");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_probe_watchdog(void) {
+  // Churning keys through a table leaves deleted slots behind, which say
+  // nothing about the hash
+  hash_table *ht = ht_init(0, NULL);
+  char buf[32];
+
+  const unsigned int live = 30;
+  for (unsigned int i = 0; i < live; i++) {
+    snprintf(buf, sizeof(buf), "live%u", i);
+    ht_insert(ht, buf, "v");
+  }
+
+  for (unsigned int i = 0; i < 5000; i++) {
+    snprintf(buf, sizeof(buf), "churn%u", i);
+    ht_insert(ht, buf, "v");
+    ht_delete(ht, buf);
+  }
+  ok(ht->hash_mode == HT_HASH_DEFAULT, "is not tripped by deleted slots");
+
+  // Rehashing under the same hash would rebuild the same chains
+  ht_probe_watchdog(ht);
+  ok(ht->hash_mode == HT_HASH_SEEDED, "moves to a keyed hash at once");
+
+  // A seeded table only just rehashed puts another long sequence down to
+  // chance
+  const uint64_t seed[2] = {ht->seed[0], ht->seed[1]};
+  ht_insert(ht, "again", "v");
+  ht_probe_watchdog(ht);
+  ok(ht->seed[0] == seed[0] && ht->seed[1] == seed[1],
+     "re-seeds at most once per `count` insertions");
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < live; i++) {
+    snprintf(buf, sizeof(buf), "live%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == live && ht_get(ht, "again") != NULL,
+     "rehashes the table, keeping every entry");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_memory_policy(void) {
+  const unsigned int policies[] = {
+      HT_MEM_HUGEPAGES,
+      HT_MEM_HUGETLB,
+      HT_MEM_HUGEPAGES | HT_MEM_INTERLEAVE,
+      HT_MEM_BIND,
+  };
+  char buf[32];
+
+  for (unsigned int p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+    hash_table *ht = init_test_ht();
+    ht_set_memory_policy(ht, policies[p], 0);
+
+    // Grow well past a huge page's worth of slots
+    const unsigned int n = 300000;
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(buf, sizeof(buf), "key%u", i);
+      ht_insert(ht, buf, "v");
+    }
+
+    unsigned int found = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      snprintf(buf, sizeof(buf), "key%u", i);
+      found += ht_get(ht, buf) != NULL;
+    }
+    ok(found == n && strcmp(ht_get(ht, "k1"), "v1") == 0,
+       "keeps every entry under memory policy %u", policies[p]);
+
+#ifdef __linux__
+    ok(ht->entries_mapped >= sizeof(ht_entry *) * ht->capacity,
+       "maps the slot array under memory policy %u", policies[p]);
+#else
+    ok(ht->entries_mapped == 0, "falls back to the heap");
+#endif
+
+    ht_delete_table(ht);
+  }
+
+  hash_table *ht = init_test_ht();
+  ht_set_memory_policy(ht, HT_MEM_HUGEPAGES, -1);
+  ht_set_memory_policy(ht, HT_MEM_DEFAULT, -1);
+  ok(ht->entries_mapped == 0 && ht->count == 3 &&
+         strcmp(ht_get(ht, "k3"), "v3") == 0,
+     "moves the slots back to the heap");
+  ht_delete_table(ht);
+}
+
+static void test_ht_resize_mapped(void) {
+  // Any memory policy maps the slot array, however small
+  hash_table *ht = ht_init(10, NULL);
+  ht_set_memory_policy(ht, HT_MEM_INTERLEAVE, -1);
+  char buf[32];
+
+  const unsigned int n = 4000;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "key%u", i);
+    ht_insert(ht, buf, "v");
+  }
+
+  ht_entry **entries = ht->entries;
+  const unsigned int capacity = ht->capacity;
+  unsigned int deleted = 0;
+  while (ht->capacity == capacity) {
+    snprintf(buf, sizeof(buf), "key%u", deleted++);
+    ht_delete(ht, buf);
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = deleted; i < n; i++) {
+    snprintf(buf, sizeof(buf), "key%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == n - deleted && ht->count == n - deleted,
+     "keeps every entry when shrunk");
+#ifdef __linux__
+  ok(ht->entries == entries, "shrinks within its slot array");
+#else
+  ok(ht->entries_mapped == 0, "allocates slot arrays from the heap");
+#endif
+
+  for (unsigned int i = 0; i < deleted; i++) {
+    snprintf(buf, sizeof(buf), "key%u", i);
+    ht_insert(ht, buf, "v");
+  }
+
+#ifdef __linux__
+  ok(ht->entries != entries && ht->spare_slots == entries,
+     "keeps the released slot array for reuse");
+
+  // A rehash at the same capacity fits in the spare
+  void *spare = ht->spare_slots;
+  ht_set_hash_mode(ht, HT_HASH_SEEDED);
+  ok(ht->entries == spare, "reuses the spare slot array");
+#else
+  ok(ht->spare_slots == NULL, "keeps no spare slot array");
+  ht_set_hash_mode(ht, HT_HASH_SEEDED);
+  ok(ht->spare_slots == NULL, "keeps no spare slot array on rehash");
+#endif
+
+  found = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "key%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == n && ht->count == n, "keeps every entry when regrown");
+
+  ht_delete_table(ht);
+}
+
+static void test_ht_load(void) {
+  // `count * 100` exceeds 32 bits from ~43M entries on
+  hash_table ht = {.capacity = 71428573, .count = 50000000};
+  ok(ht_load(&ht) == 69, "computes the load of tens of millions of entries");
+
+  ht.capacity = 6000000000ULL;
+  ht.count = 4500000000ULL;
+  ok(ht_load(&ht) == 75, "computes the load beyond 2^32 entries");
+}
+
+static void test_ht_churn(void) {
+  hash_table *tables[] = {ht_init(0, NULL), ht_init_ordered(0, NULL)};
+  const char *layouts[] = {"hashed", "ordered"};
+  char buf[32];
+
+  for (unsigned int t = 0; t < 2; t++) {
+    hash_table *ht = tables[t];
+
+    // Keep about 100 keys live while many more pass through the table
+    bool bounded = true;
+    for (unsigned int i = 0; i < 20000; i++) {
+      snprintf(buf, sizeof(buf), "k%u", i);
+      ht_insert(ht, buf, "v");
+
+      if (i >= 100) {
+        snprintf(buf, sizeof(buf), "k%u", i - 100);
+        ht_delete(ht, buf);
+      }
+
+      // The load is checked, rounded down, before each insertion, which may
+      // then take one more slot
+      if (!ht_is_small(ht) &&
+          (ht->count + ht->deleted - 1) * 100 >= ht->capacity * 71) {
+        bounded = false;
+      }
+    }
+    ok(bounded && ht->capacity < 1000,
+       "rehashes in place once deleted slots fill the array (%s)",
+       layouts[t]);
+
+    ht_stats stats;
+    ht_get_stats(ht, &stats);
+    ok(stats.tombstones == ht->deleted,
+       "counts the deleted slots (%s)", layouts[t]);
+
+    ht_delete_table(ht);
+  }
+}
+
+/**
+ * Count the entries iterated in the given order, starting from the `skip`th
+ */
+static unsigned int iterated_in_order(hash_table *ht, const char **order,
+                                      unsigned int skip) {
+  unsigned int in_order = 0;
+  unsigned int i = 0;
+
+  HT_ITER_START(ht)
+  if (i >= skip) {
+    in_order += strcmp(entry->key, order[i - skip]) == 0;
+  }
+  i++;
+  HT_ITER_END
+
+  return in_order;
+}
+
+static void test_ht_small(void) {
+  hash_table *ht = ht_init(0, NULL);
+  char buf[16];
+
+  for (unsigned int i = 0; i < HT_SMALL_CAPACITY; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, "x");
+  }
+  ht_insert(ht, "k0", "y");
+  ok(ht->capacity == HT_SMALL_CAPACITY && ht->count == HT_SMALL_CAPACITY,
+     "holds up to %d entries in the small layout", HT_SMALL_CAPACITY);
+  is(ht_get(ht, "k0"), "y", "replaces an entry in the small layout");
+
+  // Deleting from the middle leaves gaps, which are closed when the next
+  // insertion finds the last slot taken
+  ht_delete(ht, "k2");
+  ht_delete(ht, "k5");
+  ht_insert(ht, "k8", "x");
+  ht_insert(ht, "k9", "x");
+  ok(ht->capacity == HT_SMALL_CAPACITY && ht->small_used == HT_SMALL_CAPACITY,
+     "reuses the slots of deleted entries");
+
+  const char *order[] = {"k9", "k8", "k7", "k6", "k4", "k3", "k1", "k0"};
+  ok(iterated_in_order(ht, order, 0) == HT_SMALL_CAPACITY,
+     "iterates the small layout most recent first");
+
+  ht_insert(ht, "k10", "x");
+  ok(ht->capacity == next_prime(HT_DEFAULT_CAPACITY),
+     "moves to the hashed layout once full");
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i <= 10; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == HT_SMALL_CAPACITY + 1 && ht->count == HT_SMALL_CAPACITY + 1,
+     "keeps every entry when it moves");
+
+  ok(iterated_in_order(ht, order, 1) == HT_SMALL_CAPACITY,
+     "keeps the iteration order when it moves");
+
+  ht_delete_table(ht);
+
+  ht = ht_init(HT_DEFAULT_CAPACITY + 1, NULL);
+  ok(ht->capacity == next_prime(HT_DEFAULT_CAPACITY + 1),
+     "starts hashed when asked for more than the default capacity");
+  ht_delete_table(ht);
+
+  ht = init_test_ht();
+  ht_delete(ht, "k2");
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+  ok(stats.capacity == HT_SMALL_CAPACITY && stats.count == 2 &&
+         stats.tombstones == 1 && stats.probe_lengths[0] == 2,
+     "reports the shape of the small layout");
+
+  ht_cursor cursor;
+  ht_cursor_init(ht, &cursor);
+  unsigned int count = 0;
+  while (ht_cursor_next(ht, &cursor) != NULL) {
+    count++;
+  }
+  ok(count == 2, "scans the small layout with a cursor");
+  ht_delete_table(ht);
+}
+
+/**
+ * Count the keys "k<i>" iterated in ascending order of `i`, as inserted
+ */
+static unsigned int iterated_ascending(hash_table *ht) {
+  unsigned int ascending = 0;
+  long last = -1;
+
+  HT_ITER_START(ht)
+  const long i = strtol(entry->key + 1, NULL, 10);
+  ascending += i > last;
+  last = i;
+  HT_ITER_END
+
+  return ascending;
+}
+
+static void test_ht_ordered(void) {
+  hash_table *ht = ht_init_ordered(0, free);
+  ok(ht->ordered_width == 1, "indexes a small table with single bytes");
+
+  const unsigned int n = 1000;
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, strdup(buf));
+  }
+  for (unsigned int i = 0; i < n; i += 3) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_delete(ht, buf);
+  }
+  ht_insert(ht, "k1", strdup("replaced"));
+
+  ok(ht->count == n - 334 && iterated_ascending(ht) == ht->count,
+     "iterates in insertion order across resizes and deletions");
+  is(ht_get(ht, "k1"), "replaced", "keeps a replaced entry's position");
+  ok(ht->ordered_width == 2, "widens the index as the table grows");
+
+  ht_cursor cursor;
+  ht_cursor_init(ht, &cursor);
+  unsigned int in_order = 0;
+  long last = -1;
+  ht_entry *r;
+  while ((r = ht_cursor_next(ht, &cursor)) != NULL) {
+    const long i = strtol(r->key + 1, NULL, 10);
+    in_order += i > last;
+    last = i;
+  }
+  ok(in_order == ht->count, "scans in insertion order with a cursor");
+
+  ht_stats stats;
+  ht_get_stats(ht, &stats);
+  ok(stats.capacity == ht->capacity && stats.count == ht->count &&
+         stats.probe_lengths[0] > 0,
+     "reports the shape of the hash index");
+  ht_delete_table(ht);
+
+  // Churn at a steady size, so the dense array fills with gaps and is
+  // repacked without growing
+  ht = ht_init_ordered(0, free);
+  for (unsigned int i = 0; i < 30; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_insert(ht, buf, strdup(buf));
+  }
+  const size_t capacity = ht->capacity;
+  for (unsigned int i = 0; i < 200; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_delete(ht, buf);
+    snprintf(buf, sizeof(buf), "k%u", i + 30);
+    ht_insert(ht, buf, strdup(buf));
+  }
+
+  unsigned int found = 0;
+  for (unsigned int i = 200; i < 230; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    found += ht_get(ht, buf) != NULL;
+  }
+  ok(found == 30 && ht->count == 30 && ht->capacity == capacity &&
+         iterated_ascending(ht) == 30,
+     "repacks the entries of deleted keys in order");
+  ht_delete_table(ht);
+}
+
+typedef struct {
+  uint64_t id;
+  double score;
+} session;
+
+static void test_ht_inline(void) {
+  hash_table *ht = ht_init_inline(0, sizeof(session));
+
+  session s = {.id = 1, .score = 0.5};
+  ht_insert(ht, "s1", &s);
+  s.id = 2;
+  const session *got = ht_get(ht, "s1");
+  ok(got != NULL && got->id == 1 && got->score == 0.5,
+     "copies a value in on insert");
+  ok((const char *)got > (const char *)ht_search(ht, "s1") &&
+         (uintptr_t)got % _Alignof(max_align_t) == 0,
+     "stores the value within its entry, suitably aligned");
+
+  ht_insert(ht, "s0", NULL);
+  got = ht_get(ht, "s0");
+  ok(got != NULL && got->id == 0 && got->score == 0, "zeroes a NULL value");
+
+  // Entries are not moved when the table resizes, and nor are their values
+  const session *first = ht_get(ht, "s1");
+  char buf[16];
+  for (unsigned int i = 2; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "s%u", i);
+    s.id = i;
+    ht_insert(ht, buf, &s);
+  }
+  unsigned int matches = 0;
+  for (unsigned int i = 2; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "s%u", i);
+    got = ht_get(ht, buf);
+    matches += got != NULL && got->id == i;
+  }
+  ok(matches == 998 && ht_get(ht, "s1") == first && first->id == 1,
+     "keeps values in place across resizes");
+
+  s.id = 42;
+  ht_insert(ht, "s1", &s);
+  got = ht_get(ht, "s1");
+  ok(got != NULL && got->id == 42, "replaces a value");
+
+  // The value is freed along with its entry, as a single allocation
+  ht_delete(ht, "s1");
+  ok(ht_get(ht, "s1") == NULL && ht->count == 999, "deletes a value");
+  ht_delete_table(ht);
+}
+
 static void test_hash_bugfix_1(void) {
   const char *s1 = "^([a-zA-Z_-][a-zA-Z0-9_-]*)=\"([^\"]*)\"(?<! )$";
   const char *s2 = "crontabs";
@@ -194,5 +1079,23 @@ void run_hash_table_tests(void) {
   test_ht_capacity();
   test_ht_delete_with_free();
   test_ht_iterate();
+  test_ht_parallel_resize();
+  test_ht_build();
+  test_ht_parallel_scan();
+  test_ht_cursor();
+  test_ht_scan();
+  test_ht_freeze();
+  test_ht_ttl();
+  test_ht_expire_step();
+  test_ht_stats();
+  test_ht_hash_mode();
+  test_ht_probe_watchdog();
+  test_ht_memory_policy();
+  test_ht_resize_mapped();
+  test_ht_load();
+  test_ht_churn();
+  test_ht_small();
+  test_ht_ordered();
+  test_ht_inline();
   test_hash_bugfix_1();
 }
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include "hash.h"
+
+#include "tests.h"
+
+static void test_crc32c(void) {
+  ok(h_crc32c_portable("123456789") == 0xe3069283,
+     "computes the CRC32C check value in software");
+  ok(h_crc32c("123456789") == 0xe3069283,
+     "computes the CRC32C check value with the dispatched implementation");
+  ok(h_crc32c("") == 0 && h_crc32c_portable("") == 0,
+     "computes the CRC32C of an empty key");
+
+  // Lengths on either side of the hardware path's 8-byte blocks
+  char buf[64];
+  unsigned int mismatches = 0;
+  for (unsigned int len = 1; len < sizeof(buf); len++) {
+    for (unsigned int i = 0; i < len; i++) {
+      buf[i] = (char)('a' + (i * 7 + len) % 26);
+    }
+    buf[len] = '\0';
+
+    mismatches += h_crc32c(buf) != h_crc32c_portable(buf);
+  }
+  ok(mismatches == 0, "agrees with the portable CRC32C at every length");
+}
+
+static void test_siphash(void) {
+  const uint64_t seed[2] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+
+  ok(h_siphash_13("", seed) == 0xabac0158050fc4dcULL,
+     "matches the SipHash-1-3 reference vector");
+
+  const uint64_t other[2] = {1, 2};
+  ok(h_siphash_13("key", seed) != h_siphash_13("key", other),
+     "depends on the seed");
+}
+
+static void test_probe_from_64(void) {
+  const int capacity = 53;
+  unsigned int bad_steps = 0;
+
+  for (uint64_t hash = 0; hash < 1000; hash++) {
+    const h_probe probe = h_probe_from_64(h_mix_64(hash), capacity);
+    bad_steps += probe.hash_a >= (unsigned int)capacity ||
+                 probe.hash_b == 0 || probe.hash_b >= (unsigned int)capacity;
+  }
+
+  ok(bad_steps == 0, "derives a home slot and a non-zero step in range");
+}
+
+static void test_probe_permutation(void) {
+  // Large enough that `attempt * hash_b` passes 2^32 long before the
+  // sequence completes
+  const size_t capacity = 1000003;
+  unsigned char *visited = calloc(capacity, 1);
+  unsigned int repeats = 0;
+
+  const h_probe probe = h_probe_init("snapshot", capacity);
+  for (size_t attempt = 0; attempt < capacity; attempt++) {
+    repeats += visited[h_probe_at(probe, capacity, attempt)]++ > 0;
+  }
+
+  ok(repeats == 0, "visits every slot once before repeating");
+  free(visited);
+}
+
+static void test_probe_wide(void) {
+  // The smallest prime above 2^33
+  const size_t capacity = 8589934609ULL;
+  const char *keys[] = {"a", "key", "snapshot", "widekey"};
+  unsigned int out_of_range = 0;
+  unsigned int above_32_bits = 0;
+
+  for (unsigned int k = 0; k < 4; k++) {
+    const h_probe probe = h_probe_init(keys[k], capacity);
+    for (size_t attempt = 0; attempt < 1000; attempt++) {
+      const size_t idx = h_probe_at(probe, capacity, attempt);
+      out_of_range += idx >= capacity;
+      above_32_bits += idx > UINT32_MAX;
+    }
+  }
+
+  ok(out_of_range == 0, "probes within a table of more than 2^32 slots");
+  ok(above_32_bits > 0, "reaches slots above 2^32");
+}
+
+void run_hash_tests(void) {
+  test_crc32c();
+  test_siphash();
+  test_probe_from_64();
+  test_probe_permutation();
+  test_probe_wide();
+}
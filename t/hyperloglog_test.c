@@ -0,0 +1,140 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+static hyperloglog *sketch_range(unsigned int precision, unsigned int begin,
+                                 unsigned int end) {
+  hyperloglog *hll = hll_init(precision);
+
+  char buf[16];
+  for (unsigned int i = begin; i < end; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    hll_add(hll, buf);
+    // Duplicates must not count
+    hll_add(hll, buf);
+  }
+
+  return hll;
+}
+
+static double relative_error(uint64_t estimate, unsigned int n) {
+  return fabs((double)estimate - n) / n;
+}
+
+static void test_hll_count(void) {
+  hyperloglog *hll = hll_init(14);
+  ok(hll_count(hll) == 0, "estimates 0 for an empty sketch");
+  hll_delete(hll);
+
+  hll = sketch_range(14, 0, 1000);
+  ok(relative_error(hll_count(hll), 1000) < 0.005,
+     "estimates small cardinalities almost exactly");
+  hll_delete(hll);
+
+  const unsigned int sizes[] = {20000, 200000, 1000000};
+  for (unsigned int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    hll = sketch_range(14, 0, sizes[k]);
+    // Well within four standard errors (0.8% each)
+    ok(relative_error(hll_count(hll), sizes[k]) < 0.032,
+       "estimates %u distinct keys", sizes[k]);
+    hll_delete(hll);
+  }
+}
+
+static void test_hll_merge(void) {
+  hyperloglog *sparse_a = sketch_range(14, 0, 1000);
+  hyperloglog *sparse_b = sketch_range(14, 500, 1500);
+  ok(hll_merge(sparse_a, sparse_b) == 1, "merges sketches");
+  ok(relative_error(hll_count(sparse_a), 1500) < 0.005,
+     "estimates the union of two sparse sketches");
+
+  hyperloglog *dense = sketch_range(14, 1000, 100000);
+  ok(hll_merge(sparse_a, dense) == 1 &&
+         relative_error(hll_count(sparse_a), 100000) < 0.032,
+     "estimates the union of a sparse and a dense sketch");
+
+  hyperloglog *other = hll_init(12);
+  ok(hll_merge(sparse_a, other) == 0, "refuses to merge differing precisions");
+
+  hll_delete(other);
+  hll_delete(dense);
+  hll_delete(sparse_b);
+  hll_delete(sparse_a);
+}
+
+static void test_hll_serialize(void) {
+  const unsigned int sizes[] = {300, 100000};
+
+  for (unsigned int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    hyperloglog *hll = sketch_range(12, 0, sizes[k]);
+
+    const size_t size = hll_serialize(hll, NULL, 0);
+    unsigned char *buf = malloc(size);
+    ok(hll_serialize(hll, buf, size) == size, "serializes a sketch (%u)",
+       sizes[k]);
+
+    hyperloglog *copy = hll_deserialize(buf, size);
+    ok(copy != NULL && hll_count(copy) == hll_count(hll),
+       "deserializes an identical sketch (%u)", sizes[k]);
+
+    ok(hll_deserialize(buf, size - 1) == NULL,
+       "rejects a truncated sketch (%u)", sizes[k]);
+
+    if (copy != NULL) {
+      hll_delete(copy);
+    }
+    free(buf);
+    hll_delete(hll);
+  }
+
+  ok(hll_deserialize("not a sketch", 12) == NULL, "rejects garbage");
+
+  // A sparse entry whose index lies beyond 2^25, so that densifying it would
+  // write past the registers
+  hyperloglog *hll = sketch_range(4, 0, 1);
+  const size_t size = hll_serialize(hll, NULL, 0);
+  unsigned char *buf = malloc(size);
+  hll_serialize(hll, buf, size);
+  const uint32_t forged = (0x3FFFFF8U << 6) | 1;
+  for (unsigned int i = 0; i < 4; i++) {
+    buf[size - 4 + i] = (unsigned char)(forged >> (8 * i));
+  }
+  ok(hll_deserialize(buf, size) == NULL,
+     "rejects a sparse entry beyond the index range");
+
+  free(buf);
+  hll_delete(hll);
+}
+
+static void test_dc(void) {
+  distinct_counter *dc = dc_init(1000, 14);
+
+  char buf[16];
+  for (unsigned int i = 0; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    dc_add(dc, buf);
+    dc_add(dc, buf);
+  }
+  ok(dc_is_exact(dc) && dc_count(dc) == 1000,
+     "counts exactly up to the threshold");
+
+  for (unsigned int i = 1000; i < 50000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    dc_add(dc, buf);
+  }
+  ok(!dc_is_exact(dc), "switches to a sketch above the threshold");
+  ok(relative_error(dc_count(dc), 50000) < 0.032,
+     "estimates the count once switched");
+
+  dc_delete(dc);
+}
+
+void run_hyperloglog_tests(void) {
+  test_hll_count();
+  test_hll_merge();
+  test_hll_serialize();
+  test_dc();
+}
@@ -2,12 +2,24 @@
 #include "tests.h"
 
 int main(void) {
-  plan(148);
+  plan(463);
 
   run_hash_set_tests();
   run_hash_table_tests();
   run_prime_tests();
+  run_hash_tests();
   run_list_tests();
+  run_concurrent_hash_set_tests();
+  run_sharded_hash_table_tests();
+  run_snapshot_tests();
+  run_perfect_hash_tests();
+  run_bloom_filter_tests();
+  run_hash_cache_tests();
+  run_timer_wheel_tests();
+  run_hash_counter_tests();
+  run_count_min_sketch_tests();
+  run_hyperloglog_tests();
+  run_small_tests();
 
   done_testing();
 }
@@ -0,0 +1,49 @@
+#include "perfect_hash.h"
+
+#include <stdlib.h>
+
+#include "hash.h"
+#include "tests.h"
+
+static void test_ph_build(void) {
+  const unsigned int sizes[] = {1, 2, 7, 1000, 50000};
+
+  for (unsigned int k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+    const unsigned int n = sizes[k];
+    uint64_t *hashes = malloc(sizeof(uint64_t) * n);
+    for (unsigned int i = 0; i < n; i++) {
+      hashes[i] = h_mix_64(i);
+    }
+
+    perfect_hash ph;
+    ok(ph_build(&ph, hashes, n) == 1, "builds over %u keys", n);
+
+    unsigned char *seen = calloc(n, 1);
+    unsigned int distinct = 0;
+    for (unsigned int i = 0; i < n; i++) {
+      const size_t pos = ph_position(&ph, hashes[i]);
+      if (pos < n && !seen[pos]) {
+        seen[pos] = 1;
+        distinct++;
+      }
+    }
+    ok(distinct == n, "maps %u keys one-to-one onto [0, n)", n);
+
+    free(seen);
+    ph_free(&ph);
+    free(hashes);
+  }
+}
+
+static void test_ph_build_collision(void) {
+  const uint64_t hashes[] = {1, 2, 3, 2};
+
+  perfect_hash ph;
+  ok(ph_build(&ph, hashes, 4) == 0, "fails when two hashes are equal");
+  ok(ph.pilots == NULL, "releases the pilots on failure");
+}
+
+void run_perfect_hash_tests(void) {
+  test_ph_build();
+  test_ph_build_collision();
+}
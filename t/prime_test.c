@@ -18,11 +18,18 @@ static void test_next_prime(void) {
   for (unsigned int i = 2; i < sizeof(prime_map) / sizeof(int); i++) {
     int prime = prime_map[i];
 
-    ok(next_prime(prime - 1) == prime_map[i], "expected next prime %d", prime);
+    ok(next_prime(prime - 1) == (size_t)prime_map[i], "expected next prime %d",
+       prime);
   }
 }
 
+static void test_next_prime_wide(void) {
+  ok(next_prime(4294967296ULL) == 4294967311ULL,
+     "finds the next prime above 2^32");
+}
+
 void run_prime_tests(void) {
   test_is_prime();
   test_next_prime();
+  test_next_prime_wide();
 }
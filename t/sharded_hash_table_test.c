@@ -0,0 +1,138 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "strdup/strdup.h"
+#include "tests.h"
+
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_KEYS 2000
+
+typedef struct {
+  sharded_hash_table *sht;
+  unsigned int thread;
+} writer_ctx;
+
+static void *concurrent_writer(void *arg) {
+  writer_ctx *ctx = arg;
+  char buf[32];
+
+  for (unsigned int i = 0; i < CONCURRENT_KEYS; i++) {
+    snprintf(buf, sizeof(buf), "t%u-k%u", ctx->thread, i);
+    sht_insert(ctx->sht, buf, "x");
+  }
+
+  return NULL;
+}
+
+static void count_entries(ht_entry *entry, void *ctx) {
+  (void)entry;
+  atomic_fetch_add((atomic_uint *)ctx, 1);
+}
+
+static void test_sht_initialization(void) {
+  sharded_hash_table *sht = sht_init(5, 10, NULL);
+
+  ok(sht != NULL, "sharded hash table is not NULL");
+  ok(sht_count(sht) == 0, "initial count is 0");
+
+  lives({ sht_delete_table(sht); },
+        "frees the sharded hash table heap memory");
+}
+
+static void test_sht_insert(void) {
+  sharded_hash_table *sht = sht_init(4, 10, NULL);
+
+  sht_insert(sht, "k1", "v1");
+  sht_insert(sht, "k2", "v2");
+  ok(sht_count(sht) == 2, "increments the count when entries are inserted");
+
+  is(sht_get(sht, "k1"), "v1", "retrieves the correct value");
+  is(sht_get(sht, "k2"), "v2", "retrieves the correct value");
+  is(sht_get(sht, "k3"), NULL, "returns NULL if the key does not exist");
+
+  sht_insert(sht, "k1", "v3");
+  ok(sht_count(sht) == 2, "maintains the count on update");
+  is(sht_get(sht, "k1"), "v3", "retrieves the updated value");
+
+  ok(sht_delete(sht, "k1") == 1, "returns 1 when entry deletion succeeded");
+  ok(sht_delete(sht, "k1") == 0, "cannot delete the same entry twice");
+  is(sht_get(sht, "k1"), NULL, "returns NULL for the deleted entry");
+
+  sht_delete_table(sht);
+}
+
+static void test_sht_batch(void) {
+  sharded_hash_table *sht = sht_init(8, 10, free);
+
+  const char *keys[] = {"a", "b", "c", "d", "a"};
+  void *values[] = {strdup("1"), strdup("2"), strdup("3"), strdup("4"),
+                    strdup("5")};
+  void *out[5];
+
+  sht_insert_batch(sht, keys, values, 5);
+  ok(sht_count(sht) == 4, "inserts every distinct key of the batch");
+
+  sht_get_batch(sht, keys, out, 5);
+  is(out[0], "5", "applies duplicate keys in array order");
+  is(out[1], "2", "retrieves the batch value");
+  is(out[3], "4", "retrieves the batch value");
+
+  const char *deletions[] = {"b", "c", "z"};
+  ok(sht_delete_batch(sht, deletions, 3) == 2,
+     "returns the number of entries deleted by the batch");
+  ok(sht_count(sht) == 2, "removes the deleted entries");
+
+  // The value replaced by the duplicate key is owned by the caller
+  free(values[0]);
+  sht_delete_table(sht);
+}
+
+static void test_sht_parallel_for_each(void) {
+  sharded_hash_table *sht = sht_init(16, 10, NULL);
+  char buf[16];
+
+  for (unsigned int i = 0; i < 1000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    sht_insert(sht, buf, "x");
+  }
+
+  atomic_uint visited;
+  atomic_init(&visited, 0);
+  sht_parallel_for_each(sht, count_entries, &visited, 4);
+
+  ok(atomic_load(&visited) == 1000, "visits every entry exactly once");
+
+  sht_delete_table(sht);
+}
+
+static void test_sht_concurrent_insert(void) {
+  sharded_hash_table *sht = sht_init(8, 10, NULL);
+  pthread_t threads[CONCURRENT_THREADS];
+  writer_ctx ctxs[CONCURRENT_THREADS];
+
+  for (unsigned int t = 0; t < CONCURRENT_THREADS; t++) {
+    ctxs[t] = (writer_ctx){.sht = sht, .thread = t};
+    pthread_create(&threads[t], NULL, concurrent_writer, &ctxs[t]);
+  }
+
+  for (unsigned int t = 0; t < CONCURRENT_THREADS; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  ok(sht_count(sht) == CONCURRENT_THREADS * CONCURRENT_KEYS,
+     "retains every entry inserted concurrently");
+  is(sht_get(sht, "t3-k1999"), "x", "retrieves a concurrently inserted value");
+
+  sht_delete_table(sht);
+}
+
+void run_sharded_hash_table_tests(void) {
+  test_sht_initialization();
+  test_sht_insert();
+  test_sht_batch();
+  test_sht_parallel_for_each();
+  test_sht_concurrent_insert();
+}
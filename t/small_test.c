@@ -0,0 +1,72 @@
+#include <stdio.h>
+
+#include "small.h"
+#include "tests.h"
+
+/**
+ * Match tags one byte at a time, as `small_match` does all at once
+ */
+static unsigned int naive_match(uint64_t tags, uint8_t tag) {
+  unsigned int matches = 0;
+
+  for (unsigned int i = 0; i < 8; i++) {
+    if ((uint8_t)(tags >> (i * 8)) == tag) {
+      matches |= 1u << i;
+    }
+  }
+
+  return matches;
+}
+
+static void test_small_tag(void) {
+  char buf[16];
+  unsigned int zeros = 0;
+
+  for (unsigned int i = 0; i < 10000; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    zeros += small_tag(buf) == 0;
+  }
+
+  ok(zeros == 0, "never tags a key as an empty slot");
+}
+
+static void test_small_match(void) {
+  // Bytes on either side of the high bit, and neighbouring values, are where
+  // a word-at-a-time comparison could carry or borrow into the wrong byte
+  const uint8_t values[] = {0x00, 0x01, 0x02, 0x7e, 0x7f,
+                            0x80, 0x81, 0xfe, 0xff};
+  const unsigned int num_values = sizeof(values) / sizeof(values[0]);
+
+  unsigned int mismatches = 0;
+  uint64_t state = 0x9e3779b97f4a7c15ULL;
+  for (unsigned int n = 0; n < 20000; n++) {
+    uint64_t tags = 0;
+    for (unsigned int i = 0; i < 8; i++) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      tags = small_set_tag(tags, i, values[(state >> 33) % num_values]);
+    }
+
+    for (unsigned int t = 1; t < 256; t++) {
+      mismatches += small_match(tags, (uint8_t)t) != naive_match(tags, t);
+    }
+  }
+
+  ok(mismatches == 0, "matches exactly the slots holding the tag");
+  ok(small_match(0, 0x80) == 0 && small_match(~0ULL, 0xff) == 0xff,
+     "matches no slot, or every slot");
+}
+
+static void test_small_set_tag(void) {
+  uint64_t tags = small_set_tag(0, 3, 0xab);
+  tags = small_set_tag(tags, 7, 0x01);
+  ok(tags == 0x01000000ab000000ULL, "places each tag in its slot's byte");
+
+  tags = small_set_tag(tags, 3, 0);
+  ok(tags == 0x0100000000000000ULL, "clears a slot without its neighbours");
+}
+
+void run_small_tests(void) {
+  test_small_tag();
+  test_small_match();
+  test_small_set_tag();
+}
@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libhash.h"
+#include "tests.h"
+
+#define SNAPSHOT_TABLE_PATH "snapshot_test_table.bin"
+#define SNAPSHOT_SET_PATH "snapshot_test_set.bin"
+
+static size_t u64_size(const void *value) {
+  (void)value;
+  return sizeof(uint64_t);
+}
+
+static void test_table_snapshot(void) {
+  const unsigned int n = 1000;
+  hash_table *ht = ht_init(0, NULL);
+  char(*vals)[16] = malloc(sizeof(*vals) * n);
+
+  char buf[16];
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    snprintf(vals[i], sizeof(vals[i]), "v%u", i);
+    ht_insert(ht, buf, vals[i]);
+  }
+
+  // Leave deleted slots behind
+  for (unsigned int i = 0; i < n; i += 10) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    ht_delete(ht, buf);
+  }
+  ht_insert(ht, "null", NULL);
+
+  ok(ht_save(ht, SNAPSHOT_TABLE_PATH, NULL) == 1, "saves a table");
+
+  ht_mmap *htm = ht_open_mmap(SNAPSHOT_TABLE_PATH);
+  ok(htm != NULL, "maps a table snapshot");
+  ok(ht_mmap_count(htm) == ht->count, "maintains the count");
+
+  unsigned int matched = 0;
+  unsigned int deleted = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "k%u", i);
+    size_t size = 0;
+    const char *value = ht_mmap_get(htm, buf, &size);
+
+    if (i % 10 == 0) {
+      deleted += value == NULL;
+    } else if (value != NULL && strcmp(value, vals[i]) == 0 &&
+               size == strlen(vals[i]) + 1) {
+      matched++;
+    }
+  }
+  ok(matched == n - n / 10, "serves every value from the mapping");
+  ok(deleted == n / 10, "omits deleted entries");
+  ok(ht_mmap_get(htm, "null", NULL) == NULL, "retains NULL values");
+  ok(ht_mmap_get(htm, "missing", NULL) == NULL, "misses absent keys");
+
+  ht_close_mmap(htm);
+  ht_delete_table(ht);
+  free(vals);
+
+  uint64_t nums[3] = {7, 0, UINT64_MAX};
+  ht = ht_init(0, NULL);
+  ht_insert(ht, "a", &nums[0]);
+  ht_insert(ht, "b", &nums[1]);
+  ht_insert(ht, "c", &nums[2]);
+  ht_save(ht, SNAPSHOT_TABLE_PATH, u64_size);
+  ht_delete_table(ht);
+
+  // The snapshot outlives the table it was saved from
+  htm = ht_open_mmap(SNAPSHOT_TABLE_PATH);
+  size_t size = 0;
+  const uint64_t *num = ht_mmap_get(htm, "c", &size);
+  ok(num != NULL && *num == UINT64_MAX && size == sizeof(uint64_t),
+     "copies sized values verbatim");
+  ht_close_mmap(htm);
+
+  ht = ht_init_inline(0, sizeof(uint64_t));
+  ht_insert(ht, "a", &nums[2]);
+  ht_save(ht, SNAPSHOT_TABLE_PATH, NULL);
+  ht_delete_table(ht);
+
+  htm = ht_open_mmap(SNAPSHOT_TABLE_PATH);
+  num = ht_mmap_get(htm, "a", &size);
+  ok(num != NULL && *num == UINT64_MAX && size == sizeof(uint64_t),
+     "saves inline values at their fixed size");
+  ht_close_mmap(htm);
+
+  remove(SNAPSHOT_TABLE_PATH);
+}
+
+static void test_set_snapshot(void) {
+  hash_set *hs = hs_init(0);
+  hs_insert(hs, "k1");
+  hs_insert(hs, "k2");
+  hs_insert(hs, "k3");
+  hs_delete(hs, "k2");
+
+  ok(hs_save(hs, SNAPSHOT_SET_PATH) == 1, "saves a set");
+  hs_delete_set(hs);
+
+  hs_mmap *hsm = hs_open_mmap(SNAPSHOT_SET_PATH);
+  ok(hsm != NULL, "maps a set snapshot");
+  ok(hs_mmap_count(hsm) == 2, "maintains the count");
+  ok(hs_mmap_contains(hsm, "k1") && hs_mmap_contains(hsm, "k3"),
+     "contains every saved key");
+  ok(hs_mmap_contains(hsm, "k2") == 0, "omits deleted keys");
+  hs_close_mmap(hsm);
+
+  ok(ht_open_mmap(SNAPSHOT_SET_PATH) == NULL,
+     "rejects a snapshot of the wrong kind");
+
+  remove(SNAPSHOT_SET_PATH);
+}
+
+static void test_invalid_snapshot(void) {
+  ok(hs_open_mmap("does_not_exist.bin") == NULL, "rejects a missing file");
+
+  hash_set *hs = hs_init(0);
+  hs_insert(hs, "k1");
+  hs_save(hs, SNAPSHOT_SET_PATH);
+  hs_delete_set(hs);
+
+  // Truncate the snapshot
+  FILE *f = fopen(SNAPSHOT_SET_PATH, "rb");
+  unsigned char buf[64];
+  const size_t size = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+
+  f = fopen(SNAPSHOT_SET_PATH, "wb");
+  fwrite(buf, 1, size, f);
+  fclose(f);
+
+  ok(hs_open_mmap(SNAPSHOT_SET_PATH) == NULL, "rejects a truncated file");
+
+  remove(SNAPSHOT_SET_PATH);
+}
+
+void run_snapshot_tests(void) {
+  test_table_snapshot();
+  test_set_snapshot();
+  test_invalid_snapshot();
+}
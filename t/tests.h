@@ -6,6 +6,18 @@
 void run_hash_set_tests(void);
 void run_hash_table_tests(void);
 void run_prime_tests(void);
+void run_hash_tests(void);
 void run_list_tests(void);
+void run_concurrent_hash_set_tests(void);
+void run_sharded_hash_table_tests(void);
+void run_snapshot_tests(void);
+void run_perfect_hash_tests(void);
+void run_bloom_filter_tests(void);
+void run_hash_cache_tests(void);
+void run_timer_wheel_tests(void);
+void run_hash_counter_tests(void);
+void run_count_min_sketch_tests(void);
+void run_hyperloglog_tests(void);
+void run_small_tests(void);
 
 #endif /* TESTS_H */
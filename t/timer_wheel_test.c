@@ -0,0 +1,86 @@
+#include "timer_wheel.h"
+
+#include <stdlib.h>
+
+#include "hash.h"
+#include "tests.h"
+
+static void test_tw_expiry_order(void) {
+  const unsigned int n = 5000;
+  timer_wheel tw;
+  tw_init(&tw, 1);
+
+  tw_timer *timers = calloc(n, sizeof(tw_timer));
+  uint64_t *due = malloc(sizeof(uint64_t) * n);
+  for (unsigned int i = 0; i < n; i++) {
+    // Mix short and long expiries, some beyond the span of the wheel
+    const uint64_t hash = h_mix_64(i + 1);
+    due[i] = 1 + (hash >> (hash % 64)) % (1ULL << (i % 40));
+    tw_schedule(&tw, &timers[i], 1 + due[i]);
+  }
+
+  // Cancel every tenth timer
+  for (unsigned int i = 0; i < n; i += 10) {
+    tw_cancel(&tw, &timers[i]);
+  }
+
+  unsigned int early = 0;
+  unsigned int fired = 0;
+  uint64_t now = 1;
+  uint64_t last = 0;
+  unsigned int out_of_order = 0;
+  while (fired < n - n / 10 && now < (1ULL << 42)) {
+    now += now / 3 + 1;
+
+    unsigned int budget = 1000;
+    tw_timer *timer;
+    while ((timer = tw_next_expired(&tw, now, &budget)) != NULL) {
+      const unsigned int i = (unsigned int)(timer - timers);
+      early += 1 + due[i] > now;
+      out_of_order += 1 + due[i] < last;
+      last = 1 + due[i];
+      fired++;
+    }
+  }
+
+  ok(fired == n - n / 10, "fires every scheduled timer");
+  ok(early == 0, "never fires a timer early");
+  ok(out_of_order == 0, "fires timers in order of expiry");
+
+  free(due);
+  free(timers);
+}
+
+static void test_tw_budget(void) {
+  timer_wheel tw;
+  tw_init(&tw, 1);
+
+  tw_timer timers[10] = {0};
+  for (unsigned int i = 0; i < 10; i++) {
+    tw_schedule(&tw, &timers[i], 5);
+  }
+
+  unsigned int budget = 4;
+  unsigned int fired = 0;
+  while (tw_next_expired(&tw, 100, &budget) != NULL) {
+    fired++;
+  }
+  ok(fired == 4 && budget == 0, "stops once the budget runs out");
+
+  budget = 100;
+  while (tw_next_expired(&tw, 100, &budget) != NULL) {
+    fired++;
+  }
+  ok(fired == 10, "resumes where the previous call stopped");
+
+  tw_schedule(&tw, &timers[0], 50);
+  budget = 100;
+  ok(tw_next_expired(&tw, 200, &budget) == &timers[0],
+     "fires a timer scheduled before the wheel's tick on the next step");
+  ok(timers[0].expires == 0, "unschedules an expired timer");
+}
+
+void run_timer_wheel_tests(void) {
+  test_tw_expiry_order();
+  test_tw_budget();
+}